@@ -11,8 +11,24 @@
 
 #include "SimplifiedMailbox.hpp"
 #include "WatchdogSettings.hpp"
-
+#include "DataMailboxTimerWheel.hpp"
+#include "DataMailboxOutbox.hpp"
+#include "DataMailboxCapture.hpp"
+#include "DataMailboxJournal.hpp"
+#include "DataMailboxTransport.hpp"
+#include "DataMailboxInlineString.hpp"
+#include "DataMailboxBacklog.hpp"
+#include "DataMailboxSizingAdvisor.hpp"
+#include "DataMailboxRealtime.hpp"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 
 class DataMailbox;
@@ -23,8 +39,11 @@ class KeypadMessage_wPassword;
 class KeypadMessage_wCommand;
 class RFIDMessage;
 class StringMessage;
+class RPCMessage;
+class DataMailboxAsyncLogger;
 
-/// Defines all the types of messages that can be sent and received with DataMailbox. Always the first byte of the raw (serialized) message.
+/// Defines all the built-in types of messages that can be sent and received with DataMailbox. Always the first byte of the raw (serialized) message. \n
+/// Applications add their own types through DataMailboxMessageRegistry.
 enum class MessageDataType : char
 {
 	NONE = 0,
@@ -35,12 +54,42 @@ enum class MessageDataType : char
 	RFIDMessage,
 	StringMessage,
 	WatchdogMessage,
-	COUNT // get number of message types
+	RPCMessage,
+	COUNT // get number of built-in message types
+};
+
+/// Set in the type byte of a frame which ends with a 4 byte CRC32C of the rest of the frame. \see DataMailbox::enableChecksums()
+static const unsigned char FRAME_CHECKSUM_FLAG = 0x80;
+
+/**
+ * @brief Frame of a message described as a short copied header followed by parts referenced in place. \see DataMailboxMessage::describeFrame()
+ *
+ * Lets DataMailbox send large fields (e.g. std::string storage) without serializing them first.
+*/
+struct GatherFrame
+{
+	static const size_t HEADER_CAPACITY = 32;
+	static const size_t MAX_PARTS = 4;
+
+	char m_header[HEADER_CAPACITY];
+	size_t m_headerSize = 0;
+
+	TransportBuffer m_parts[MAX_PARTS];
+	size_t m_partCount = 0;
+
+	/// Copies `size` bytes to the end of the header. Returns false if they do not fit.
+	bool appendHeader(const void* data, size_t size);
+
+	/// Adds a part referencing `size` bytes at `data`. Returns false if there are MAX_PARTS already.
+	bool appendPart(const char* data, size_t size);
 };
 
-/// Returns string name of the MessageDataType represented by `dataType` code. \see MessageDataType
+/// Returns string name of the MessageDataTyperepresented by `dataType` code, "INVALID" if out of range. \see MessageDataType
 const std::string getDataTypeName(MessageDataType dataType);
 
+/// Same as getDataTypeName() without allocating. The name stays valid as long as the type is registered.
+const char* getDataTypeNameCStr(MessageDataType dataType);
+
 /**
  * @brief Apstract base class for all the message classes that can be sent and received with DataMailbox.
 */
@@ -52,6 +101,10 @@ public:
 	/// Used by constructors of inherited classes
 	DataMailboxMessage(MessageDataType dataType);
 
+	/// Copies type and source only. Serialized data is never shared, the copy serializes itself again.
+	DataMailboxMessage(const DataMailboxMessage& other);
+	DataMailboxMessage& operator=(const DataMailboxMessage& other);
+
 	/// Deletes (frees) serialized data when called
 	virtual ~DataMailboxMessage();
 
@@ -162,20 +215,43 @@ public:
 
 	virtual void Deserialize() = 0; // TODO
 
+	/**
+	 * @brief Describes the frame `Serialize()` would produce as a header and parts referencing the message fields.
+	 *
+	 * Used by `DataMailbox::send()` to skip serialization. The described bytes must be exactly the serialized frame, \n
+	 * starting with `m_dataType`. Parts stay valid until the message is modified. \n
+	 * Returns false if the message cannot be described, then it is serialized. The default always returns false.
+	*/
+	virtual bool describeFrame(GatherFrame& frame);
+
 	/// Dumps raw serialized data into `filepath.dump` file which can be read by any hex editor. Serializes data if necessary
 	void DumpSerialData(const std::string filepath);
 
 	/// Returns the MessageDataType which identifies the message class/object. Used when deserializing and processing data.
 	MessageDataType getDataType() { return m_dataType; };
 
-	/// Decodes MessageDataType from the first byte of the serialized raw binary data
-	void decodeMessageDataType();
+	/// Decodes MessageDataType from the first byte of the serialized raw binary data. \n
+	/// Returns false and sets MessageDataType::NONE if the type is neither built-in nor registered in DataMailboxMessageRegistry. \n
+	/// Only the first unknown frame of the process is dumped to a file and reported with a warning.
+	bool decodeMessageDataType();
 
 	/// Function which returns string with log info of the current message object.
 	virtual std::string getInfo() = 0;
 
-	/// Set serialized data as `rawData` and size as `dataSize`. Used internally. TODO private?
-	void setSerializedData(char* rawData, size_t dataSize) { m_serialized = rawData; m_sizeOfSerializedData = dataSize; }
+	/**
+	 * @brief Writes log info of the current message object into `buffer`, truncated and always null terminated.
+	 *
+	 * Built-in messages override it without heap allocations. The default implementation formats `getInfo()`.
+	 *
+	 * @return Length of the written info without the terminating null
+	*/
+	virtual size_t formatInfo(char* buffer, size_t size);
+
+	/// Set serialized data as `rawData` and size as `dataSize`. Takes ownership of `rawData`. Used internally. TODO private?
+	void setSerializedData(char* rawData, size_t dataSize);
+
+	/// Set serialized data to a frame which lives forever (e.g. static sentinel). It is never freed or written to.
+	void setStaticSerializedData(const char* rawData, size_t dataSize);
 
 	/// Returns MailboxReference of source of this message (object)
 	MailboxReference& getSource() { return m_source; };
@@ -183,6 +259,12 @@ public:
 protected:
 	MessageDataType m_dataType;
 
+	/// False if `m_serialized` points to static data or to the inline buffer, which must not be freed
+	bool m_ownsSerializedData;
+
+	/// Allocated size of `m_serialized`, reused by `deleteAndReallocateSerializedData()` if large enough
+	uint32_t m_capacityOfSerializedData;
+
 	char* m_serialized;
 	size_t m_sizeOfSerializedData;
 
@@ -191,13 +273,22 @@ protected:
 	/// Checks validity of serialized data. Exits on failure.
 	void checkSerializedData();
 
-	/// Clears and frees current serialized data and allocates memory for new serialized data. Also sets the `m_sizeOfSerializedData` to `size`
+	/// Clears and frees current serialized data and allocates memory for new serialized data. Also sets the `m_sizeOfSerializedData` to `size`. \n
+	/// Keeps the current buffer if it is large enough, so serializing the same object again does not allocate.
 	void deleteAndReallocateSerializedData(size_t size);
 
 	/// Clears and frees current serialized data
 	void deleteSerializedData();
 
+	/// Frees current serialized data and takes over serialized data of `other`, leaving `other` empty. `other` must not use its inline buffer.
+	void takeSerializedData(DataMailboxMessage& other);
+
+	/// Buffer inside the message object `deleteAndReallocateSerializedData()` uses instead of the heap for frames up to `capacity` bytes. \n
+	/// nullptr if there is none. \see InlineDataMailboxMessage
+	virtual char* getInlineSerializedDataBuffer(size_t& capacity) { capacity = 0; return nullptr; }
+
 	friend class DataMailbox;
+	friend class RPCMessage;
 };
 
 /// Abstract virtual class used as a parent class for all other user-defined message classes.
@@ -225,18 +316,173 @@ protected:
 
 };
 
+/**
+ * @brief Parent class for messages whose serialized frame usually fits into `FRAME_CAPACITY` bytes.
+ *
+ * The frame is serialized into a buffer inside the message object instead of the heap. \n
+ * Larger frames still work, they are allocated as usual.
+*/
+template <size_t FRAME_CAPACITY>
+class InlineDataMailboxMessage : public ExtendedDataMailboxMessage
+{
+public:
+	static const size_t INLINE_FRAME_CAPACITY = FRAME_CAPACITY;
+
+	InlineDataMailboxMessage(MessageDataType dataType)
+		:	ExtendedDataMailboxMessage(dataType)
+	{
+
+	}
+
+	/// The frame is not copied, the copy serializes its own
+	InlineDataMailboxMessage(const InlineDataMailboxMessage& other)
+		:	ExtendedDataMailboxMessage(other)
+	{
+
+	}
+
+	InlineDataMailboxMessage& operator=(const InlineDataMailboxMessage& other)
+	{
+		ExtendedDataMailboxMessage::operator=(other);
+		return *this;
+	}
+
+	virtual ~InlineDataMailboxMessage() {}
+
+protected:
+	virtual char* getInlineSerializedDataBuffer(size_t& capacity)
+	{
+		capacity = FRAME_CAPACITY;
+		return m_inlineFrame;
+	}
+
+private:
+	char m_inlineFrame[FRAME_CAPACITY];
+};
+
+/// Longest RFID UUID, keypad password and watchdog slot name. Longer ones are truncated. \see DataMailboxInlineString
+static const size_t RFID_UUID_INLINE_CAPACITY = 24;
+static const size_t PASSWORD_INLINE_CAPACITY = 16;
+static const size_t SLOT_NAME_INLINE_CAPACITY = 16;
+
+/// Largest size of the messages with inline fields, two cache lines
+static const size_t INLINE_MESSAGE_MAX_SIZE = 128;
+
+/// Size of WatchdogMessage frame without the slot name: MessageDataType, MessageClass, SlotSettings, PID, enuActionOnFailure
+static const size_t WATCHDOG_MESSAGE_HEADER_SIZE = sizeof(MessageDataType) + sizeof(char) + sizeof(SlotSettings) + sizeof(unsigned int) + sizeof(enuActionOnFailure);
+
+class BasicDataMailboxMessage : public DataMailboxMessage
+{
+public:
+	BasicDataMailboxMessage();
+	BasicDataMailboxMessage(MessageDataType dataType, const MailboxReference& source);
+	virtual ~BasicDataMailboxMessage() = default;
+
+	/// Takes ownership of the serialized data of `other`. Copying is not allowed as both copies would free the same data.
+	BasicDataMailboxMessage(BasicDataMailboxMessage&& other);
+	BasicDataMailboxMessage& operator=(BasicDataMailboxMessage&& other);
+
+	virtual void Serialize();
+	virtual void Deserialize();
+
+	/// Returns pointer to `m_serialized` - serialized raw data
+	char* getRawDataPointer() const;
+
+	/// Returns size of serialized raw data in `m_serialized` in bytes
+	int getRawDataSize() const;
+
+	/**
+	* Relesases ownership of `m_serialized`. \n
+	* BE SURE TO RELEASE OWNERSHIP AFTER TAKING IT AS TO AVOID UNDEFINED BEHAVIOUR \n
+	* WHEN IT GETS FREED IN THE DESTRUCTOR OF THE BasicDataMailboxMessage. \n
+	* \n
+	* TODO: SMART POINTERS
+	*/
+	void releaseRawDataOwnership();
+
+	/// Sets the message source. Used internally.
+	void setSource(const MailboxReference& source) { m_source = source; };
+	virtual std::string getInfo();
+	virtual size_t formatInfo(char* buffer, size_t size);
+
+	/// Returns id of the DataMailbox timer which produced this MessageDataType::TimedOut message, 0 for any other message
+	DataMailboxTimerWheel::TimerId getTimerId() const { return m_timerId; }
+
+	/// Returns journal sequence of a durable message, 0 if the message is not journaled. \see DataMailbox::acknowledge()
+	DataMailboxJournal::Sequence getDeliveryId() const { return m_deliveryId; }
+
+private:
+	friend class DataMailbox;
+
+	DataMailboxJournal::Sequence m_deliveryId = 0;
+
+	/// Kept outside the frame, so the TimedOut message of a timer uses the static TimedOut frame
+	DataMailboxTimerWheel::TimerId m_timerId = 0;
+};
+
+
+/**
+ * @brief Describes which messages DataMailbox::receiveMatching() accepts. Fields left empty match anything.
+ *
+ * Example - wait for REGISTER_REPLY from the watchdog:
+ *
+ *		BasicDataMailboxMessage reply = mailbox.receiveMatching(WatchdogMessage::getFilter(WatchdogMessage::REGISTER_REPLY), enuReceiveOptions::TIMED);
+*/
+struct DataMailboxMessageFilter
+{
+	DataMailboxMessageFilter() = default;
+	DataMailboxMessageFilter(MessageDataType dataType, const std::string& source = "", std::function<bool(BasicDataMailboxMessage&)> predicate = nullptr);
+
+	/// Accepted MessageDataType. NONE matches any type.
+	MessageDataType m_dataType = MessageDataType::NONE;
+
+	/// Accepted source mailbox name. Empty string matches any source.
+	std::string m_source;
+
+	/// Optional check of the serialized message. Called only if type and source match.
+	std::function<bool(BasicDataMailboxMessage&)> m_predicate;
+
+	bool matches(BasicDataMailboxMessage& message) const;
+};
+
+/**
+ * @brief Sends and receives DataMailboxMessages through a DataMailboxTransport (POSIX queue by default).
+ *
+ * Threads: \n
+ * `send()`, `sendConnectionless()`, `sendBatch()`, `sendNonBlocking()`, `sendConflated()` and `flushOutbox()` \n
+ * may be called from any number of threads at once, also while another thread receives. Each sending thread \n
+ * serializes into its own scratch buffers, there is no lock in DataMailbox on the send path. A message object \n
+ * must not be sent by two threads at once, as it is serialized into itself. \n
+ * A synchronous ILogger is called under a lock (DataMailboxAsyncLogger is not). Neither DataMailboxMqTransport \n
+ * nor DataMailboxSocketTransport serializes sends - a full destination blocks only the threads sending to it. \n
+ * \n
+ * Everything else - receiving, timers, stash, conflation, durability and the enable/disable/set functions - \n
+ * belongs to one thread. Configure the mailbox (including `enableOutbox()`) before sharing it with sending threads. \n
+ * Receive with a per call timeout (`receive(const struct timespec&)`) instead of changing the RTO settings.
+*/
 class DataMailbox
 {
 public:
 	/**
 	 * @brief Creates new DataMailbox object
 	 * @param name Globally unique DataMailbox name.
-	 * @param pLogger Pointer to a ILogger* inherited class to log information.
+	 * @param pLogger Pointer to a ILogger* inherited class to log information. \n
+	 * With DataMailboxAsyncLogger, sends and receives are traced as binary records instead of formatted log lines.
 	 * @param mailboxAttributes DataMailbox attributes e.g. max message size and max message length. \see MailboxReference
 	*/
 	DataMailbox(const std::string name, ILogger* pLogger = NulLogger::getInstance(), const mq_attr& mailboxAttributes = MailboxReference::messageAttributes);
+
+	/**
+	 * @brief Creates new DataMailbox object which sends and receives through `pTransport`
+	 * @param pTransport Transport named by the globally unique DataMailbox name, e.g. DataMailboxSocketTransport. \see DataMailboxTransport
+	 * @param pLogger Pointer to a ILogger* inherited class to log information.
+	*/
+	DataMailbox(std::unique_ptr<DataMailboxTransport> pTransport, ILogger* pLogger = NulLogger::getInstance());
 	~DataMailbox();
 
+	/// Size of the buffer `formatInfo()` is called with when logging messages
+	static const size_t INFO_BUFFER_SIZE = 512;
+
 	// DataMailboxMessage* getReceivedMessagePointer() { return m_receivedMessage; }
 
 	/**
@@ -248,12 +494,244 @@ public:
 
 	void sendConnectionless(MailboxReference& destination, DataMailboxMessage* message);
 
+	/// Sends `messages` to `destination` in order, with as few system calls as the transport allows
+	void sendBatch(MailboxReference& destination, const std::vector<DataMailboxMessage*>& messages);
+
+	/**
+	 * @brief Creates the outbound buffer used by `sendNonBlocking()`.
+	 *
+	 * Every destination gets a flusher thread with its first buffered message, so a full destination queue \n
+	 * does not hold up the others. The flushers send through the same queue as `send()`. Do not mix `send()` and `sendNonBlocking()` \n
+	 * to the same destination if the order of messages matters.
+	 *
+	 * @param capacity Maximum number of buffered messages per destination
+	 * @param overflowPolicy What to do when the buffer of a destination is full
+	*/
+	void enableOutbox(size_t capacity, enuOutboxOverflowPolicy overflowPolicy = enuOutboxOverflowPolicy::DROP_OLDEST);
+
+	/**
+	 * @brief Serializes `message` into the outbound buffer of `destination` and returns without waiting for the queue.
+	 *
+	 * Blocks only with enuOutboxOverflowPolicy::BLOCK when the buffer is full. \n
+	 * Creates the outbox with default settings if `enableOutbox()` was not called.
+	*/
+	enuOutboxStatus sendNonBlocking(MailboxReference& destination, DataMailboxMessage* message);
+
+	/**
+	 * @brief Like `sendNonBlocking()`, but replaces a still buffered message of the same type with the same `key`.
+	 *
+	 * For state-style messages where only the latest version matters (status strings, watchdog settings). \n
+	 * The newer message takes the place of the older one in the buffer, so it is not delayed.
+	*/
+	enuOutboxStatus sendConflated(MailboxReference& destination, DataMailboxMessage* message, const std::string& key);
+
+	/// Waits until all messages buffered by `sendNonBlocking()` are sent
+	void flushOutbox();
+
+	/// Waits until the messages buffered for `destination` are sent
+	void flushOutbox(const MailboxReference& destination);
+
+	/// Returns outbound buffer counters for `destination`
+	OutboxStatistics getOutboxStatistics(const MailboxReference& destination);
+
+	/// Returns outbound buffer counters summed over all destinations
+	OutboxStatistics getOutboxStatistics();
+
+	/**
+	 * @brief Tracks the backlog of this mailbox - messages waiting in its queue plus stashed ones - against `watermarks`.
+	 *
+	 * The backlog is sampled while receiving. Above the high watermark received messages of the shed types \n
+	 * are dropped (not journaled, not returned), so a lagging consumer catches up on the traffic that matters. \n
+	 * Changes of state are logged and passed to the callback on the receiving thread.
+	 *
+	 * Example - drop status strings while more than 200 messages wait, keep watchdog traffic:
+	 *
+	 *		BacklogWatermarks watermarks;
+	 *		watermarks.m_high = 200;
+	 *		watermarks.m_low = 50;
+	 *		watermarks.m_shedTypes = { MessageDataType::StringMessage };
+	 *		mailbox.setBacklogWatermarks(watermarks);
+	 *
+	 * @param watermarks Watermarks and shedding policy, m_high 0 stops tracking
+	*/
+	void setBacklogWatermarks(const BacklogWatermarks& watermarks);
+
+	/**
+	 * @brief Tracks the outbound buffer of `destination` (\see sendNonBlocking()) against `watermarks`.
+	 *
+	 * The buffer depth is sampled by `sendNonBlocking()` and `sendConflated()`. Above the high watermark \n
+	 * messages of the shed types are not buffered and enuOutboxStatus::SHED is returned, so a slow consumer \n
+	 * fills its buffer with the traffic that matters instead of making every producer wait or drop. \n
+	 * Changes of state are logged and passed to the callback on the sending thread. \n
+	 * `send()` does not shed, it waits for the destination by design.
+	 *
+	 * @param watermarks Watermarks and shedding policy, m_high 0 stops tracking
+	*/
+	void setDestinationWatermarks(const MailboxReference& destination, const BacklogWatermarks& watermarks);
+
+	/// Returns number of messages waiting in the queue and the stash now. Asks the transport, which may take a system call.
+	size_t getBacklog();
+
+	/// Returns backlog counters of this mailbox (all zero if `setBacklogWatermarks()` was not called)
+	BacklogStatistics getBacklogStatistics() const;
+
+	/// Returns backlog counters of the outbound buffer of `destination` (all zero if it is not tracked)
+	BacklogStatistics getBacklogStatistics(const MailboxReference& destination) const;
+
+	/**
+	 * @brief Starts recording sizes of received frames and depths of the queue, \see getSizingRecommendation()
+	 *
+	 * Costs a histogram update per received frame and a queue depth sample (a system call with POSIX queues) \n
+	 * per SizingOptions::m_depthSampleInterval frames. Calling it again starts over.
+	*/
+	void enableSizingAdvisor(const SizingOptions& options = SizingOptions());
+
+	void disableSizingAdvisor();
+
+	/// Returns the smallest mq_attr for the traffic received since `enableSizingAdvisor()`, with the memory it saves
+	SizingRecommendation getSizingRecommendation();
+
+	/**
+	 * @brief Sets the recommended mq_attr through `setMQAttributes()` and logs the recommendation.
+	 *
+	 * Nothing is set if the recommendation is not valid yet. POSIX queues get mq_maxmsg and mq_msgsize when created, \n
+	 * pass m_recommended to the constructor when the transport does not apply them to an existing queue.
+	 *
+	 * @return The recommendation, applied if m_valid
+	*/
+	SizingRecommendation applySizingRecommendation();
+
 	/**
 	 * @brief Listens for messages until one is received.
 	 * @return BasicDataMailboxMessage object which holds the serialized message and the message dataType. Unpacks to more specific message class.
 	*/ // TODO
 	BasicDataMailboxMessage receive(enuReceiveOptions timed = enuReceiveOptions::NORMAL);
 
+	/// Like `receive(enuReceiveOptions::TIMED)`, but waits no longer than `timeout` instead of the RTO. The RTO settings are not changed.
+	BasicDataMailboxMessage receive(const struct timespec& timeout);
+
+	/**
+	 * @brief Receives the first message accepted by `filter`.
+	 *
+	 * Stashed messages are checked first. Messages received from the queue which do not match \n
+	 * are stashed (in order of arrival) and returned by later calls to `receive()` and `receiveMatching()`. \n
+	 * With enuReceiveOptions::TIMED the RTO is the deadline for the whole call, not for each received message. \n
+	 * With enuReceiveOptions::NONBLOCKING the queue is drained until a match is found or it is empty.
+	 *
+	 * @return Matching message, or TimedOut/EmptyQueue message as returned by `receive()`
+	*/
+	BasicDataMailboxMessage receiveMatching(const DataMailboxMessageFilter& filter, enuReceiveOptions options = enuReceiveOptions::NORMAL);
+
+	/// Like `receiveMatching(filter, enuReceiveOptions::TIMED)` with `timeout` as the deadline of the whole call instead of the RTO
+	BasicDataMailboxMessage receiveMatching(const DataMailboxMessageFilter& filter, const struct timespec& timeout);
+
+	/**
+	 * @brief Starts appending every sent and received frame to a memory-mapped capture log.
+	 *
+	 * Segments are written to `<directory>/<mailbox name>.<index>.capture` and read with DataMailboxCaptureReader. \n
+	 * Synthetic TimedOut/EmptyQueue messages are not captured. Enable before using `sendNonBlocking()`.
+	*/
+	void enableCapture(const std::string& directory, size_t segmentSize = DataMailboxCaptureWriter::DEFAULT_SEGMENT_SIZE);
+
+	/**
+	 * @brief Appends CRC32C checksum to every frame this DataMailbox sends.
+	 *
+	 * Received frames are verified whenever they carry a checksum, regardless of this setting. \n
+	 * Frames failing the check are dropped and counted by `getCorruptedCount()`. \n
+	 * Enable only if all receivers verify checksums, older ones reject such frames as unknown type.
+	*/
+	void enableChecksums();
+
+	void disableChecksums();
+
+	void disableCapture();
+
+	/**
+	 * @brief Journals received messages of durable types until the application acknowledges them.
+	 *
+	 * A durable message is written to a memory-mapped journal `<directory>/<mailbox name>.<index>.journal` \n
+	 * and synced to disk before `receive()` returns it. One sync is shared by up to `groupCommitSize` messages: \n
+	 * messages already waiting in the queue are journaled and stashed together with the returned one. \n
+	 * With `groupCommitSize` 0 the journal is never synced, it then survives a crash of the process but not of the system. \n
+	 * \n
+	 * Messages not acknowledged by `acknowledge()` are received again after a restart (at-least-once delivery). \n
+	 * KeypadMessage_wPassword and RFIDMessage are durable unless changed by `setDurable()`. \n
+	 * Messages still in the queue are not journaled yet, the queue itself does not survive a reboot.
+	*/
+	void enableDurability(const std::string& directory, size_t groupCommitSize = DataMailboxJournal::DEFAULT_GROUP_COMMIT_SIZE, size_t segmentSize = DataMailboxJournal::DEFAULT_SEGMENT_SIZE);
+
+	/// Selects whether received `dataType` messages are journaled. \see enableDurability()
+	void setDurable(MessageDataType dataType, bool durable = true);
+
+	/// Marks a durable message handled, so it is not received again after a restart. Returns false for messages which are not journaled.
+	bool acknowledge(const BasicDataMailboxMessage& message);
+
+	/// Returns number of durable messages received but not yet acknowledged
+	size_t getUnacknowledgedCount() const;
+
+	/// Returns number of received messages which are stashed waiting for `receive()` or `receiveMatching()`
+	size_t getStashedCount() const { return m_stashedCount; }
+
+	/// Returns conflation key of received message. Empty key means the message is never conflated.
+	typedef std::function<std::string(BasicDataMailboxMessage& message)> ConflationKeyFunction;
+
+	/**
+	 * @brief Enables receiver-side conflation of `dataType` messages.
+	 *
+	 * Before each `receive()` the queued messages are moved to the stash. A stashed message of `dataType` \n
+	 * is replaced by a newer one with the same key (the newer keeps the older's place in line), \n
+	 * so a lagging consumer only processes the latest version. \see WatchdogMessage::getConflationKey()
+	*/
+	void enableConflation(MessageDataType dataType, ConflationKeyFunction keyFunction);
+
+	void disableConflation(MessageDataType dataType);
+
+	/// Returns number of received messages dropped because a newer one with the same key arrived
+	unsigned long long getConflatedCount() const { return m_conflatedCount; }
+
+	/// Returns number of received messages dropped because their type is not registered in DataMailboxMessageRegistry
+	unsigned long long getUnknownTypeCount() const { return m_unknownTypeCount; }
+
+	/// Returns number of received frames dropped because of wrong checksum
+	unsigned long long getCorruptedCount() const { return m_corruptedCount; }
+
+	/**
+	 * @brief Schedules a timer which is delivered by `receive()` as a MessageDataType::TimedOut message
+	 *
+	 * Expired timers are returned before any queued message. The message carries the timer id, \n
+	 * \see BasicDataMailboxMessage::getTimerId(). Timers are independent of the RTO settings.
+	 *
+	 * @param delay Time until the timer expires
+	 * @return Timer id, used to cancel the timer
+	*/
+	DataMailboxTimerWheel::TimerId scheduleTimer(const struct timespec& delay);
+
+	/// Cancels the timer. Returns false if it already expired (even if not yet received) or was cancelled.
+	bool cancelTimer(DataMailboxTimerWheel::TimerId timerId);
+
+	/// Returns current time of the clock of receive deadlines and timers, virtual with DataMailboxMemoryTransport
+	DataMailboxTime::Clock::time_point getTime() { return m_pTransport->now(); }
+
+	/**
+	 * @brief Applies real-time settings to the calling thread, call it from the thread which receives from this mailbox
+	 *
+	 * Reserves the timer pool, then pins the thread to the CPUs, switches it to SCHED_FIFO, locks memory \n
+	 * and prefaults stack and heap, \see DataMailboxRealtime::applyToCurrentThread(). \n
+	 * What was applied is logged, every setting which failed is reported by Kernel::Warning. Failures are not fatal.
+	 *
+	 * Example:
+	 *
+	 *		RealtimeSettings settings;
+	 *		settings.m_cpus = { 2 };
+	 *		settings.m_priority = 80;
+	 *		settings.m_lockMemory = true;
+	 *		settings.m_prefaultStack = 256 * 1024;
+	 *		RealtimeReport report = mailbox.applyRealtimeSettings(settings);
+	 *
+	 * @return What was applied
+	*/
+	RealtimeReport applyRealtimeSettings(const RealtimeSettings& settings);
+
 	/**
 	 * @brief Set the RTO of current mailbox (in seconds)
 	 *
@@ -301,63 +779,152 @@ public:
 private:
 	ILogger* m_pLogger;
 
-	SimplifiedMailbox m_mailbox;
+	std::unique_ptr<DataMailboxTransport> m_pTransport;
 
-	// DataMailboxMessage* m_receivedMessage;
+	/// False for NulLogger. Log messages are not even formatted then, so send/receive do not allocate.
+	bool m_logging;
 
-	// void clearMessageBuffer();
-};
+	/// Set if m_pLogger is a DataMailboxAsyncLogger, m_logging is false then
+	DataMailboxAsyncLogger* m_pTracer;
+	uint16_t m_traceId;
 
+	/// Serializes calls of a synchronous m_pLogger made by sending threads
+	std::mutex m_logMutex;
 
-class BasicDataMailboxMessage : public DataMailboxMessage
-{
-public:
-	BasicDataMailboxMessage();
-	BasicDataMailboxMessage(MessageDataType dataType, const MailboxReference& source);
-	virtual ~BasicDataMailboxMessage() = default;
+	/// Writes `line` to m_pLogger, under m_logMutex if it is synchronous
+	void log(const std::string& line);
 
-	virtual void Serialize();
-	virtual void Deserialize();
+	/// Logs `message` info if logging is enabled
+	void logMessage(DataMailboxMessage* message);
 
-	/// Returns pointer to `m_serialized` - serialized raw data
-	char* getRawDataPointer() const;
+	struct StashedMessage
+	{
+		unsigned long long m_sequence;
+		BasicDataMailboxMessage m_message;
+		std::string m_conflationKey; // empty if not conflated
+	};
 
-	/// Returns size of serialized raw data in `m_serialized` in bytes
-	int getRawDataSize() const;
+	/// Messages set aside by `receiveMatching()`, indexed by MessageDataType. Empty lists are erased.
+	std::unordered_map<unsigned char, std::deque<StashedMessage>> m_stash;
+	unsigned long long m_stashSequence;
+	size_t m_stashedCount;
 
-	/**
-	* Relesases ownership of `m_serialized`. \n
-	* BE SURE TO RELEASE OWNERSHIP AFTER TAKING IT AS TO AVOID UNDEFINED BEHAVIOUR \n
-	* WHEN IT GETS FREED IN THE DESTRUCTOR OF THE BasicDataMailboxMessage. \n
-	* \n
-	* TODO: SMART POINTERS
-	*/
-	void releaseRawDataOwnership();
+	std::unordered_map<unsigned char, ConflationKeyFunction> m_conflationKeyFunctions;
 
-	/// Sets the message source. Used internally.
-	void setSource(const MailboxReference& source) { m_source = source; };
-	virtual std::string getInfo();
+	/// Sequence number of the stashed message for every conflation key (MessageDataType byte + key)
+	std::unordered_map<std::string, unsigned long long> m_conflationIndex;
+	unsigned long long m_conflatedCount;
 
-private:
+	unsigned long long m_unknownTypeCount;
+
+	bool m_checksums;
+	unsigned long long m_corruptedCount;
+
+	std::unique_ptr<DataMailboxJournal> m_pJournal;
+	size_t m_groupCommitSize;
+	std::unordered_set<unsigned char> m_durableTypes;
+
+	/// Appends `message` to the journal if its type is durable
+	void journalMessage(BasicDataMailboxMessage& message);
+
+	/// Syncs the journal before durable `message` is returned, together with up to m_groupCommitSize - 1 messages queued behind it
+	void commitJournal(const BasicDataMailboxMessage& message);
+
+	/// Serializes `message` and returns its frame, with checksum if enabled. Valid until the next call on the same thread.
+	char* prepareFrame(DataMailboxMessage* message, size_t& size);
+
+	/// Sends the frame described by `message` through `DataMailboxTransport::sendGather()`, with checksum if enabled. \n
+	/// Returns false without sending if the message does not describe its frame. Sets `size` to the size of the sent frame.
+	bool sendGathered(MailboxReference& destination, DataMailboxMessage* message, size_t& size);
+
+	/// Checks and strips checksum of a received frame. Returns false if the frame is corrupted.
+	bool verifyChecksum(BasicDataMailboxMessage& message);
+
+	DataMailboxTimerWheel m_timers;
+
+	std::unique_ptr<DataMailboxCaptureWriter> m_pCapture;
+
+	void captureFrame(enuCaptureDirection direction, const std::string& source, const std::string& destination, const char* frame, size_t size);
+
+	/// Declared after m_pTransport so the flusher threads are stopped before the transport it sends through
+	std::unique_ptr<DataMailboxOutbox> m_pOutbox;
+
+	/// Backlog of this mailbox, null if not tracked
+	std::unique_ptr<DataMailboxBacklogTracker> m_pBacklog;
+
+	/// Backlogs of outbound buffers by destination name. Not changed while sending threads run.
+	std::unordered_map<std::string, std::unique_ptr<DataMailboxBacklogTracker>> m_destinationBacklogs;
+
+	/// Creates tracker which logs changes of state before calling the callback of `watermarks`
+	std::unique_ptr<DataMailboxBacklogTracker> createBacklogTracker(const std::string& name, const BacklogWatermarks& watermarks);
+
+	/// Samples the backlog when due. Returns true if the received `message` is to be dropped.
+	bool shedReceived(BasicDataMailboxMessage& message);
+
+	/// Null unless `enableSizingAdvisor()` was called
+	std::unique_ptr<DataMailboxSizingAdvisor> m_pSizingAdvisor;
+
+	/// Expired timers not yet returned, from m_nextExpiredTimer on. A vector, so delivering timers reuses its memory.
+	std::vector<DataMailboxTimerWheel::TimerId> m_expiredTimers;
+	size_t m_nextExpiredTimer;
+
+	/// Returns deadline of a receive with `options` started now: the RTO for enuReceiveOptions::TIMED, otherwise none
+	DataMailboxTime::Clock::time_point getReceiveDeadline(enuReceiveOptions options);
+
+	/// `receive()` without committing the journal. `deadline` is used with enuReceiveOptions::TIMED.
+	BasicDataMailboxMessage receiveUncommitted(enuReceiveOptions options, DataMailboxTime::Clock::time_point deadline);
+
+	/// `receiveMatching()` without committing the journal. `deadline` is used with enuReceiveOptions::TIMED.
+	BasicDataMailboxMessage receiveMatchingUncommitted(const DataMailboxMessageFilter& filter, enuReceiveOptions options, DataMailboxTime::Clock::time_point deadline);
+
+	/// Receives message from the queue (ignores the stash). With enuReceiveOptions::TIMED waits until `deadline`.
+	BasicDataMailboxMessage receiveFromQueue(enuReceiveOptions options, DataMailboxTime::Clock::time_point deadline = DataMailboxTime::Clock::time_point::max());
+
+	/// Receives message from the queue, returns TimedOut message if none arrives before `deadline`
+	BasicDataMailboxMessage receiveFromQueueUntil(DataMailboxTime::Clock::time_point deadline);
+
+	/// Moves the wheel to the current time and builds TimedOut message for the first expired timer. Returns false if none expired.
+	bool takeExpiredTimer(BasicDataMailboxMessage& message);
+
+	/// Stashes `message`, or replaces the stashed message with the same conflation key
+	void stashMessage(BasicDataMailboxMessage& message);
+
+	/// Moves the messages currently in the queue to the stash, conflating them
+	void drainQueueToStash();
+
+	enuOutboxStatus bufferMessage(MailboxReference& destination, DataMailboxMessage* message, const std::string& conflationKey);
+
+	/// Moves the oldest stashed message accepted by `filter` to `message`. Returns false if there is none.
+	bool takeFromStash(const DataMailboxMessageFilter& filter, BasicDataMailboxMessage& message);
+
+	// DataMailboxMessage* m_receivedMessage;
+
+	// void clearMessageBuffer();
 };
 
 
-class KeypadMessage_wPassword : public ExtendedDataMailboxMessage
+class KeypadMessage_wPassword : public InlineDataMailboxMessage<sizeof(MessageDataType) + PASSWORD_INLINE_CAPACITY>
 {
 public:
+	typedef DataMailboxInlineString<PASSWORD_INLINE_CAPACITY> Password;
+
 	KeypadMessage_wPassword();
-	KeypadMessage_wPassword(const std::string& password);
+	KeypadMessage_wPassword(const Password& password);
 	virtual ~KeypadMessage_wPassword() {}
 
-	std::string getPassword() const { return m_password; };
+	std::string getPassword() const { return m_password.str(); };
+
+	/// Returns the password without copying it
+	const Password& getPasswordString() const { return m_password; }
 
 	virtual void Serialize();
 	virtual void Deserialize();
 	virtual std::string getInfo();
+	virtual size_t formatInfo(char* buffer, size_t size);
 
 
 private:
-	std::string m_password;
+	Password m_password;
 
 
 };
@@ -383,6 +950,7 @@ public:
 	virtual void Serialize();
 	virtual void Deserialize();
 	virtual std::string getInfo();
+	virtual size_t formatInfo(char* buffer, size_t size);
 
 private:
 
@@ -391,21 +959,27 @@ private:
 
 };
 
-class RFIDMessage : public ExtendedDataMailboxMessage
+class RFIDMessage : public InlineDataMailboxMessage<sizeof(MessageDataType) + RFID_UUID_INLINE_CAPACITY>
 {
 public:
+	typedef DataMailboxInlineString<RFID_UUID_INLINE_CAPACITY> UUID;
+
 	RFIDMessage();
-	RFIDMessage(const std::string& uuid);
+	RFIDMessage(const UUID& uuid);
 	virtual ~RFIDMessage() {}
 
-	std::string getUUID() const { return m_uuid; }
+	std::string getUUID() const { return m_uuid.str(); }
+
+	/// Returns the UUID without copying it
+	const UUID& getUUIDString() const { return m_uuid; }
 
 	virtual void Serialize();
 	virtual void Deserialize();
 	virtual std::string getInfo();
+	virtual size_t formatInfo(char* buffer, size_t size);
 
 private:
-	std::string m_uuid;
+	UUID m_uuid;
 
 };
 
@@ -419,7 +993,9 @@ public:
 
 	virtual void Serialize();
 	virtual void Deserialize();
+	virtual bool describeFrame(GatherFrame& frame);
 	virtual std::string getInfo();
+	virtual size_t formatInfo(char* buffer, size_t size);
 
 	std::string getMessage() const { return m_message; }
 
@@ -430,9 +1006,11 @@ private:
 
 
 
-class WatchdogMessage : public ExtendedDataMailboxMessage
+class WatchdogMessage : public InlineDataMailboxMessage<WATCHDOG_MESSAGE_HEADER_SIZE + SLOT_NAME_INLINE_CAPACITY>
 {
 public:
+	typedef DataMailboxInlineString<SLOT_NAME_INLINE_CAPACITY> SlotName;
+
 	typedef enum : char
 	{
 		REGISTER_REQUEST = 0,
@@ -451,24 +1029,30 @@ public:
 		NONE
 	} MessageClass;
 
+	static_assert(sizeof(MessageClass) == sizeof(char), "WATCHDOG_MESSAGE_HEADER_SIZE assumes one byte MessageClass");
+
 	virtual void Serialize();
 	virtual void Deserialize();
 	virtual std::string getInfo();
+	virtual size_t formatInfo(char* buffer, size_t size);
 
 	WatchdogMessage();
 
-	WatchdogMessage(const std::string& name,
+	WatchdogMessage(const SlotName& name,
 		const SlotSettings& settings,
 		unsigned int PID,
 		enuActionOnFailure onFailure = enuActionOnFailure::RESET_ONLY,
 		MessageClass type = NONE);
 
-	WatchdogMessage(const std::string& name,
+	WatchdogMessage(const SlotName& name,
 		MessageClass type = NONE);
 
 	WatchdogMessage(MessageClass type);
 
-	std::string getName() const { return m_name; }
+	std::string getName() const { return m_name.str(); }
+
+	/// Returns the slot name without copying it
+	const SlotName& getNameString() const { return m_name; }
 
 	MessageClass getMessageClass() const { return m_messageClass; }
 
@@ -478,19 +1062,33 @@ public:
 
 	enuActionOnFailure getActionOnFailure() const { return m_onFailure; }
 
+	/// Returns filter for DataMailbox::receiveMatching() which accepts only WatchdogMessages of `messageClass` (ANY accepts all)
+	static DataMailboxMessageFilter getFilter(MessageClass messageClass);
+
+	/// Conflation key for DataMailbox::enableConflation(): slot name for UPDATE_SETTINGS, empty (never conflated) for other classes
+	static std::string getConflationKey(BasicDataMailboxMessage& message);
+
 	static std::string getMessageClassName(MessageClass messageClass);
 	std::string getMessageClassName() const { return getMessageClassName(m_messageClass); }
 
+	/// Same as getMessageClassName() without allocating
+	static const char* getMessageClassNameCStr(MessageClass messageClass);
+
 private:
-	enuActionOnFailure m_onFailure;
+	// Ordered so the message has no padding holes and stays within INLINE_MESSAGE_MAX_SIZE
+	SlotName m_name;
 
-	std::string m_name;
+	enuActionOnFailure m_onFailure;
 
 	MessageClass m_messageClass;
 
-	SlotSettings m_settings;
-
 	unsigned int m_PID;
+
+	SlotSettings m_settings;
 };
 
+static_assert(sizeof(KeypadMessage_wPassword) <= INLINE_MESSAGE_MAX_SIZE, "KeypadMessage_wPassword is larger than two cache lines");
+static_assert(sizeof(RFIDMessage) <= INLINE_MESSAGE_MAX_SIZE, "RFIDMessage is larger than two cache lines");
+static_assert(sizeof(WatchdogMessage) <= INLINE_MESSAGE_MAX_SIZE, "WatchdogMessage is larger than two cache lines");
+
 #endif
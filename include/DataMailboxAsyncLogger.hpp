@@ -0,0 +1,183 @@
+/*****************************************************************//**
+ * \file   DataMailboxAsyncLogger.hpp
+ * \brief  ILogger which formats and writes log lines and binary trace records on a background thread.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_ASYNC_LOGGER_HPP
+#define DATA_MAILBOX_ASYNC_LOGGER_HPP
+
+#include "DataMailbox.hpp"
+#include "DataMailboxTime.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// What a trace record of DataMailboxAsyncLogger describes
+enum class enuTraceEvent : char
+{
+	TEXT = 0, // line passed to operator<<, continued in the following records if longer than TraceRecord::TEXT_CAPACITY
+	SENT,
+	SENT_CONNECTIONLESS,
+	SENT_BATCH, // one record per message of the batch
+	QUEUED, // buffered in the outbox
+	RECEIVED
+};
+
+/// One cache line of a per-thread ring of DataMailboxAsyncLogger
+struct TraceRecord
+{
+	static const size_t TEXT_CAPACITY = 48;
+
+	/// Nanoseconds of DataMailboxTime::Clock
+	uint64_t m_timestamp;
+
+	/// Frame size, or the whole text length of enuTraceEvent::TEXT
+	uint32_t m_size;
+
+	/// \see DataMailboxAsyncLogger::registerName()
+	uint16_t m_mailboxId;
+
+	enuTraceEvent m_event;
+	MessageDataType m_dataType;
+
+	/// Destination or source name (truncated, null terminated), or a chunk of the text (not terminated)
+	char m_text[TEXT_CAPACITY];
+};
+
+/**
+ * @brief ILogger which only queues records on the calling thread. A background thread formats and writes them to the target logger.
+ *
+ * Every thread that logs gets its own single-producer ring, so queueing takes no lock and does not allocate \n
+ * (after the first record of the thread). If a ring is full the record is dropped and counted. \n
+ * \n
+ * Passed to DataMailbox as its logger, the mailbox traces sends and receives as binary records instead of \n
+ * formatting log lines: the mailbox name ID, MessageDataType, frame size, peer name and timestamp. \n
+ * Records of all threads are written ordered by their timestamps, in batches, within about IDLE_WAIT_MS. \n
+ * \n
+ * Example:
+ *
+ *		DataMailboxAsyncLogger logger(&fileLogger);
+ *		DataMailbox mailbox("reader", &logger);
+ *
+ * Rings of exited threads are kept until the logger is destroyed, create the logger for long living threads.
+*/
+class DataMailboxAsyncLogger : public ILogger
+{
+public:
+	/// Records per thread, rounded up to a power of two
+	static const size_t DEFAULT_RING_CAPACITY = 4096;
+
+	/// How long the writer thread sleeps when all rings are empty
+	static const int IDLE_WAIT_MS = 1;
+
+	/// `pTarget` is written only from the writer thread and must outlive the logger
+	DataMailboxAsyncLogger(ILogger* pTarget, size_t ringCapacity = DEFAULT_RING_CAPACITY);
+
+	/// Writes everything queued, then stops the writer thread
+	virtual ~DataMailboxAsyncLogger();
+
+	DataMailboxAsyncLogger(const DataMailboxAsyncLogger&) = delete;
+	DataMailboxAsyncLogger& operator=(const DataMailboxAsyncLogger&) = delete;
+
+	/// Queues `message` as enuTraceEvent::TEXT records
+	virtual void operator<<(const std::string& message);
+
+	/// Returns ID of mailbox `name` used in trace records. Takes a lock, call it once per mailbox.
+	uint16_t registerName(const std::string& name);
+
+	/// Queues a binary trace record. Lock-free, does not allocate after the first record of the thread.
+	void trace(uint16_t mailboxId, enuTraceEvent event, MessageDataType dataType, size_t size, const std::string& peer);
+
+	/// Waits until everything queued before the call is written
+	void flush();
+
+	/// Records dropped because the ring of their thread was full
+	unsigned long long getDroppedCount();
+
+	/// Records (log lines and trace records) written to the target logger
+	unsigned long long getWrittenCount() const { return m_writtenCount; }
+
+private:
+	/// Single producer (the owning thread), single consumer (the writer thread)
+	struct Ring
+	{
+		explicit Ring(size_t capacity);
+
+		std::vector<TraceRecord> m_records;
+		size_t m_mask;
+
+		/// Next record to write, advanced by the producer. Padded so the producer and consumer do not share a cache line.
+		std::atomic<size_t> m_head;
+		char m_headPadding[64 - sizeof(std::atomic<size_t>)];
+
+		/// Next record to read, advanced by the consumer
+		std::atomic<size_t> m_tail;
+		char m_tailPadding[64 - sizeof(std::atomic<size_t>)];
+
+		std::atomic<unsigned long long> m_dropped;
+	};
+
+	ILogger* m_pTarget;
+	size_t m_ringCapacity;
+
+	/// Unique for every logger ever created, identifies the logger in the per-thread ring cache
+	unsigned long long m_id;
+
+	std::mutex m_ringsMutex;
+	std::vector<std::unique_ptr<Ring>> m_rings;
+	std::unordered_map<std::thread::id, Ring*> m_threadRings;
+
+	std::mutex m_namesMutex;
+	std::vector<std::string> m_names;
+
+	std::mutex m_writerMutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_passDone;
+	unsigned long long m_passCount;
+	bool m_stopping;
+
+	std::atomic<unsigned long long> m_writtenCount;
+
+	DataMailboxTime::Clock::time_point m_start;
+
+	/// Records of one pass over the rings, reused
+	std::vector<TraceRecord> m_batch;
+	std::vector<Ring*> m_ringSnapshot;
+
+	/// Copy of m_names used by the writer thread without locking
+	std::vector<std::string> m_writerNames;
+
+	std::thread m_writer;
+
+	/// Returns the ring of the calling thread, creates it on the first call
+	Ring& getRing();
+
+	/// Reserves `count` consecutive records starting at `index` (masked by the caller). \n
+	/// Returns false (and counts the drop) if the ring is full. \see publish()
+	bool reserve(Ring& ring, size_t count, size_t& index);
+
+	/// Makes `count` records reserved at `index` visible to the writer thread
+	void publish(Ring& ring, size_t index, size_t count);
+
+	void writerLoop();
+
+	/// Moves records of all rings to m_batch, sorted by timestamp. Returns false if there were none.
+	bool drain();
+
+	void writeBatch();
+
+	/// Formats record at `m_batch[i]`, returns the number of records it took
+	size_t writeRecord(size_t i, std::string& line);
+};
+
+#endif
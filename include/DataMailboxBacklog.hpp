@@ -0,0 +1,105 @@
+/*****************************************************************//**
+ * \file   DataMailboxBacklog.hpp
+ * \brief  Backlog tracking of a queue with high/low watermarks and load shedding.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_BACKLOG_HPP
+#define DATA_MAILBOX_BACKLOG_HPP
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class MessageDataType : char;
+
+/// Whether a backlog crossed its high watermark and has not yet fallen to the low one
+enum class enuBacklogState : char
+{
+	NORMAL = 0,
+	HIGH
+};
+
+/// Called when the backlog of queue `name` changes state. Runs on the thread which took the sample, keep it short.
+typedef std::function<void(const std::string& name, enuBacklogState state, size_t backlog)> BacklogCallback;
+
+/// Watermarks and shedding policy of one backlog. \see DataMailbox::setBacklogWatermarks()
+struct BacklogWatermarks
+{
+	/// Backlog (messages) at which the state becomes HIGH. 0 - the backlog is not tracked.
+	size_t m_high = 0;
+
+	/// Backlog at which the state returns to NORMAL, lower than m_high so the state does not flap
+	size_t m_low = 0;
+
+	/// Types of messages dropped while the state is HIGH, e.g. { MessageDataType::StringMessage }. Empty - nothing is shed.
+	std::vector<MessageDataType> m_shedTypes;
+
+	/// Called on every change of state, may be empty
+	BacklogCallback m_callback;
+
+	/// The backlog is sampled on every m_sampleInterval-th message, sampling the queue depth may take a system call
+	unsigned int m_sampleInterval = 16;
+};
+
+/// Counters of a DataMailboxBacklogTracker
+struct BacklogStatistics
+{
+	enuBacklogState m_state = enuBacklogState::NORMAL;
+	size_t m_backlog = 0; // last sample
+	size_t m_highestBacklog = 0; // highest sample
+	unsigned long long m_highCount = 0; // times the state became HIGH
+	unsigned long long m_shed = 0; // messages dropped while HIGH
+};
+
+/**
+ * @brief Tracks sampled backlog of one queue against BacklogWatermarks. All functions may be called from any thread.
+ *
+ * The owner samples the depth when `isSampleDue()` and passes it to `update()`, which calls the callback \n
+ * once per change of state, even if several threads update at once.
+*/
+class DataMailboxBacklogTracker
+{
+public:
+	DataMailboxBacklogTracker(const std::string& name, const BacklogWatermarks& watermarks);
+
+	DataMailboxBacklogTracker(const DataMailboxBacklogTracker&) = delete;
+	DataMailboxBacklogTracker& operator=(const DataMailboxBacklogTracker&) = delete;
+
+	/// Counts a message, returns true on every m_sampleInterval-th one
+	bool isSampleDue();
+
+	/// Records backlog sample and changes the state if a watermark was crossed
+	void update(size_t backlog);
+
+	/// True if the state is HIGH and `dataType` is shed. Counts the message as shed then.
+	bool shed(MessageDataType dataType);
+
+	enuBacklogState getState() const { return m_state; }
+
+	BacklogStatistics getStatistics() const;
+
+private:
+	std::string m_name;
+	size_t m_high;
+	size_t m_low;
+	BacklogCallback m_callback;
+	unsigned int m_sampleInterval;
+
+	/// Indexed by MessageDataType
+	std::bitset<256> m_shedTypes;
+
+	std::atomic<unsigned int> m_messageCount;
+	std::atomic<enuBacklogState> m_state;
+	std::atomic<size_t> m_backlog;
+	std::atomic<size_t> m_highestBacklog;
+	std::atomic<unsigned long long> m_highCount;
+	std::atomic<unsigned long long> m_shed;
+};
+
+#endif
@@ -0,0 +1,38 @@
+/*****************************************************************//**
+ * \file   DataMailboxCRC32C.hpp
+ * \brief  CRC32C (Castagnoli) checksum of DataMailbox frames.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_CRC32C_HPP
+#define DATA_MAILBOX_CRC32C_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief CRC32C with the fastest implementation available on the running CPU.
+ *
+ * The implementation is selected once at runtime: SSE4.2 `crc32` instruction on x86, \n
+ * CRC32 extension on AArch64, otherwise a portable slicing-by-8 table.
+ *
+ * `extend()` continues a checksum, so `extend(compute(a), b) == compute(a + b)`.
+*/
+namespace DataMailboxCRC32C
+{
+	/// Returns CRC32C of `size` bytes at `data`
+	uint32_t compute(const void* data, size_t size);
+
+	/// Returns CRC32C of the data `crc` was computed from, followed by `size` bytes at `data`
+	uint32_t extend(uint32_t crc, const void* data, size_t size);
+
+	/// Table driven implementation, always available. Used as fallback and for comparison.
+	uint32_t extendPortable(uint32_t crc, const void* data, size_t size);
+
+	/// Returns name of the selected implementation, e.g. "sse4.2" or "portable"
+	const char* getImplementationName();
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*****************************************************************//**
+ * \file   DataMailboxCapture.hpp
+ * \brief  Memory-mapped, append-only, segmented capture of DataMailbox traffic.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_CAPTURE_HPP
+#define DATA_MAILBOX_CAPTURE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+
+enum class MessageDataType : char;
+
+/// Whether the captured frame was sent or received by the capturing DataMailbox
+enum class enuCaptureDirection : char
+{
+	SENT = 0,
+	RECEIVED
+};
+
+/**
+ * @brief Header of every record in a capture segment. Followed by source name, destination name and the frame.
+ *
+ * Records are 8 byte aligned. A record with m_size == 0 marks the end of the written part of the segment.
+*/
+struct CaptureRecordHeader
+{
+	uint32_t m_size; // whole record including header and padding. Written last.
+	uint32_t m_frameSize;
+	uint64_t m_timestamp_ns; // CLOCK_REALTIME, so captures of different processes can be merged. Never decreases within one writer.
+	uint16_t m_sourceLength;
+	uint16_t m_destinationLength;
+	char m_direction; // enuCaptureDirection
+	char m_dataType; // MessageDataType, first byte of the frame without FRAME_CHECKSUM_FLAG (the frame itself is stored unchanged)
+	char m_reserved[2];
+};
+
+/// One captured frame as seen by DataMailboxCaptureReader. Pointers are valid only during the visitor call.
+struct CaptureRecord
+{
+	uint64_t m_timestamp_ns;
+	enuCaptureDirection m_direction;
+	MessageDataType m_dataType;
+
+	const char* m_pSource;
+	size_t m_sourceLength;
+
+	const char* m_pDestination;
+	size_t m_destinationLength;
+
+	/// Serialized frame, exactly as passed to / returned by the mailbox
+	const char* m_pFrame;
+	size_t m_frameSize;
+
+	std::string getSource() const { return std::string(m_pSource, m_sourceLength); }
+	std::string getDestination() const { return std::string(m_pDestination, m_destinationLength); }
+};
+
+/// Selects records read by DataMailboxCaptureReader
+struct CaptureFilter
+{
+	bool m_anyDataType = true;
+	MessageDataType m_dataType;
+
+	uint64_t m_from_ns = 0; // inclusive
+	uint64_t m_to_ns = std::numeric_limits<uint64_t>::max(); // exclusive
+
+	bool m_sent = true;
+	bool m_received = true;
+
+	bool matches(const CaptureRecordHeader& header) const;
+};
+
+/**
+ * @brief Appends frames to memory-mapped segment files `<directory>/<name>.<index>.capture`.
+ *
+ * Every segment is a fixed size file mapped once, so appending a record is a memcpy \n
+ * (no syscall) until the segment is full and the next one is created. \n
+ * A new writer never overwrites existing segments, it continues after the last one. \n
+ * Records of one writer are in timestamp order. Captures merged from several writers (or a writer continuing \n
+ * an older capture) are not, readers must not assume it across them. \n
+ * Thread safe.
+*/
+class DataMailboxCaptureWriter
+{
+public:
+	static const size_t DEFAULT_SEGMENT_SIZE = 16 * 1024 * 1024;
+
+	DataMailboxCaptureWriter(const std::string& directory, const std::string& name, size_t segmentSize = DEFAULT_SEGMENT_SIZE);
+	~DataMailboxCaptureWriter();
+
+	/// Appends one record. Frames larger than a segment are dropped with a warning.
+	void append(enuCaptureDirection direction, const std::string& source, const std::string& destination, const char* frame, size_t frameSize);
+
+	/// Returns number of records written by this writer
+	unsigned long long getRecordCount() const { return m_recordCount; }
+
+	/// Returns path of the segment file with `index`
+	static std::string getSegmentPath(const std::string& directory, const std::string& name, unsigned int index);
+
+private:
+	std::string m_directory;
+	std::string m_name;
+	size_t m_segmentSize;
+
+	std::mutex m_mutex;
+
+	unsigned int m_segmentIndex;
+	char* m_pSegment;
+	size_t m_offset;
+
+	unsigned long long m_recordCount;
+
+	/// Timestamp of the last record. CLOCK_REALTIME can step back (NTP, settimeofday), later records keep this one until it catches up.
+	uint64_t m_lastTimestamp_ns;
+
+	/// Unmaps current segment and maps a new, empty one. Returns false on failure.
+	bool openNextSegment();
+	void closeSegment();
+};
+
+/**
+ * @brief Iterates records of all segments of a capture written by DataMailboxCaptureWriter.
+ *
+ * Can read a capture which is still being written. Records are visited in the order they were written.
+*/
+class DataMailboxCaptureReader
+{
+public:
+	/// Return false to stop the iteration
+	typedef std::function<bool(const CaptureRecord& record)> Visitor;
+
+	DataMailboxCaptureReader(const std::string& directory, const std::string& name);
+
+	/// Calls `visitor` for every record accepted by `filter`. Returns number of visited records.
+	unsigned long long forEach(const CaptureFilter& filter, Visitor visitor);
+
+private:
+	std::string m_directory;
+	std::string m_name;
+};
+
+#endif
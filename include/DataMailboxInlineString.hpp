@@ -0,0 +1,108 @@
+/*****************************************************************//**
+ * \file   DataMailboxInlineString.hpp
+ * \brief  Small-buffer string for short, bounded message fields.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_INLINE_STRING_HPP
+#define DATA_MAILBOX_INLINE_STRING_HPP
+
+#include "Kernel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief String of at most `CAPACITY` characters stored inside the object. Never touches the heap.
+ *
+ * Meant for short fields such as RFID UUIDs, passwords and slot names, so messages carrying them \n
+ * stay within a cache line or two. Longer values are truncated to CAPACITY characters with a warning. \n
+ * Constructs implicitly from `const char*` and std::string, like the std::string fields it replaces. \n
+ * `make()` checks the length of a string literal at compile time.
+*/
+template <size_t CAPACITY>
+class DataMailboxInlineString
+{
+	static_assert(CAPACITY > 0 && CAPACITY <= 255, "DataMailboxInlineString capacity must be 1 - 255 characters");
+
+public:
+	static const size_t INLINE_CAPACITY = CAPACITY;
+
+	DataMailboxInlineString()
+		:	m_length(0)
+	{
+
+	}
+
+	DataMailboxInlineString(const char* data, size_t length)
+		:	m_length(0)
+	{
+		assign(data, length);
+	}
+
+	DataMailboxInlineString(const std::string& value)
+		:	m_length(0)
+	{
+		assign(value.data(), value.length());
+	}
+
+	/// Copies `value` up to its terminating null, so a short value in a larger buffer is stored without the padding
+	DataMailboxInlineString(const char* value)
+		:	m_length(0)
+	{
+		if (value != nullptr)
+			assign(value, strlen(value));
+	}
+
+	/// String literal which must fit, checked at compile time: `SlotName::make("watchdog")`
+	template <size_t SIZE>
+	static DataMailboxInlineString make(const char (&literal)[SIZE])
+	{
+		static_assert(SIZE - 1 <= CAPACITY, "String literal is longer than the DataMailboxInlineString capacity");
+		return DataMailboxInlineString(literal);
+	}
+
+	DataMailboxInlineString& operator=(const std::string& value)
+	{
+		assign(value.data(), value.length());
+		return *this;
+	}
+
+	/// Copies `length` characters of `data`, truncated to CAPACITY with a warning
+	void assign(const char* data, size_t length)
+	{
+		if (length > CAPACITY)
+		{
+			Kernel::Warning("DataMailboxInlineString: " + std::to_string(length) + " characters truncated to " + std::to_string(CAPACITY));
+			length = CAPACITY;
+		}
+
+		memmove(m_inline, data, length);
+		m_length = (uint8_t)length;
+	}
+
+	const char* data() const { return m_inline; }
+
+	size_t length() const { return m_length; }
+
+	bool empty() const { return m_length == 0; }
+
+	std::string str() const { return std::string(m_inline, m_length); }
+
+	bool operator==(const std::string& other) const
+	{
+		return other.length() == m_length && memcmp(other.data(), m_inline, m_length) == 0;
+	}
+
+	bool operator!=(const std::string& other) const { return !(*this == other); }
+
+private:
+	char m_inline[CAPACITY];
+	uint8_t m_length;
+};
+
+#endif
@@ -0,0 +1,139 @@
+/*****************************************************************//**
+ * \file   DataMailboxJournal.hpp
+ * \brief  Memory-mapped journal of received messages for durable DataMailbox delivery.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_JOURNAL_HPP
+#define DATA_MAILBOX_JOURNAL_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+/// State of a journal record, the only field changed after the record is written
+enum class enuJournalRecordState : uint8_t
+{
+	PENDING = 1,
+	ACKNOWLEDGED
+};
+
+/**
+ * @brief Header of every record in a journal segment. Followed by source name and the frame.
+ *
+ * Records are 8 byte aligned. A record with m_size == 0 marks the end of the written part of the segment. \n
+ * m_checksum covers everything but m_size, m_checksum and m_state, so records torn by a power loss are detected.
+*/
+struct JournalRecordHeader
+{
+	uint32_t m_size; // whole record including header and padding. Written last.
+	uint32_t m_checksum; // CRC32C
+	uint64_t m_sequence;
+	uint32_t m_frameSize;
+	uint16_t m_sourceLength;
+	uint8_t m_state; // enuJournalRecordState
+	uint8_t m_reserved;
+};
+
+/**
+ * @brief Append-only journal in memory-mapped segment files `<directory>/<name>.<index>.journal`.
+ *
+ * Appending a record is a memcpy, so it survives a crash of the process right away. \n
+ * `commit()` writes the records and acknowledgements back to disk, so they also survive a reboot; \n
+ * calling it once for a group of records amortizes the sync. \n
+ * Pending records of an existing journal are recovered when it is opened. \n
+ * Segments are deleted once all their records are acknowledged. \n
+ * Not thread safe.
+*/
+class DataMailboxJournal
+{
+public:
+	typedef uint64_t Sequence;
+
+	static const size_t DEFAULT_SEGMENT_SIZE = 4 * 1024 * 1024;
+
+	/// Number of records made durable by one sync. \see DataMailbox::enableDurability()
+	static const size_t DEFAULT_GROUP_COMMIT_SIZE = 32;
+
+	/// Called for pending records. Pointers are valid only during the call.
+	typedef std::function<void(Sequence sequence, const char* source, size_t sourceLength, const char* frame, size_t frameSize)> Visitor;
+
+	DataMailboxJournal(const std::string& directory, const std::string& name, size_t segmentSize = DEFAULT_SEGMENT_SIZE);
+
+	/// Commits and unmaps all segments
+	~DataMailboxJournal();
+
+	/// Appends a pending record. Returns its sequence (never 0), or 0 if it could not be written.
+	Sequence append(const std::string& source, const char* frame, size_t frameSize);
+
+	/// Marks the record acknowledged. Returns false if no such record is pending.
+	bool acknowledge(Sequence sequence);
+
+	/// Syncs all records appended and acknowledged since the last commit to disk
+	void commit();
+
+	/// Calls `visitor` for every pending record, in order of sequence
+	void forEachPending(Visitor visitor) const;
+
+	/// Returns number of records not yet acknowledged
+	size_t getPendingCount() const { return m_pending.size(); }
+
+	/// Returns number of records appended since the last commit
+	size_t getUncommittedCount() const { return m_uncommittedCount; }
+
+	/// Returns number of commits which synced anything
+	unsigned long long getCommitCount() const { return m_commitCount; }
+
+	/// Returns path of the segment file with `index`
+	static std::string getSegmentPath(const std::string& directory, const std::string& name, unsigned int index);
+
+private:
+	struct Segment
+	{
+		char* m_pData;
+		size_t m_size;
+		size_t m_pendingCount;
+
+		/// Range changed since the last commit, empty if m_dirtyBegin >= m_dirtyEnd
+		size_t m_dirtyBegin;
+		size_t m_dirtyEnd;
+	};
+
+	struct PendingRecord
+	{
+		unsigned int m_segmentIndex;
+		size_t m_offset;
+	};
+
+	std::string m_directory;
+	std::string m_name;
+	size_t m_segmentSize;
+
+	/// Mapped segments, the last one is appended to if m_appending
+	std::map<unsigned int, Segment> m_segments;
+	unsigned int m_nextSegmentIndex;
+	bool m_appending;
+	size_t m_offset;
+
+	std::map<Sequence, PendingRecord> m_pending;
+	Sequence m_nextSequence;
+
+	size_t m_uncommittedCount;
+	unsigned long long m_commitCount;
+
+	/// Maps existing segments and collects their pending records. Segments with none are deleted.
+	void recover();
+
+	/// Maps a new, empty segment to append to. Returns false on failure.
+	bool openNextSegment();
+
+	/// Unmaps and deletes a segment which has no pending records and is not appended to
+	void retireSegment(unsigned int index);
+
+	void markDirty(Segment& segment, size_t begin, size_t end);
+};
+
+#endif
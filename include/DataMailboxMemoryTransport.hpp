@@ -0,0 +1,173 @@
+/*****************************************************************//**
+ * \file   DataMailboxMemoryTransport.hpp
+ * \brief  In-process DataMailbox transport with a virtual clock, for deterministic protocol and throughput tests.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_MEMORY_TRANSPORT_HPP
+#define DATA_MAILBOX_MEMORY_TRANSPORT_HPP
+
+#include "DataMailboxTransport.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Counters of DataMailboxMemoryNetwork
+struct MemoryNetworkStatistics
+{
+	unsigned long long m_sent = 0;
+	unsigned long long m_received = 0;
+	unsigned long long m_blocked = 0; // sends which found the destination full and waited
+	unsigned long long m_dropped = 0; // unknown destination, frame larger than mq_msgsize, or destination full without blocking
+};
+
+/**
+ * @brief Queues of DataMailboxMemoryTransports and the virtual clock they share.
+ *
+ * Every queue keeps the limits of its mq_attr: at most mq_maxmsg frames (in flight ones included) of at most mq_msgsize bytes. \n
+ * A frame is delivered `getDeliveryDelay()` of virtual time after it was sent. \n
+ * \n
+ * Virtual time moves only when a receive has nothing to deliver now: it jumps to the delivery of the next frame, \n
+ * or to the end of the timeout of an enuReceiveOptions::TIMED receive, which then times out at once. \n
+ * So a test of timeouts runs without waiting, and the same calls give the same results every run. \n
+ * Only an enuReceiveOptions::NORMAL receive with nothing in flight, and a send to a full queue, wait in real time \n
+ * for another thread. DataMailbox deadlines, timers (`scheduleTimer()`) and DataMailboxRPC timeouts follow the virtual clock.
+ *
+ * Example - a watchdog which does not answer makes the request time out immediately:
+ *
+ *		DataMailboxMemoryNetwork network;
+ *		network.setDeliveryDelay(std::chrono::milliseconds(2));
+ *
+ *		DataMailbox client(std::unique_ptr<DataMailboxTransport>(new DataMailboxMemoryTransport("client", network)));
+ *		DataMailbox watchdog(std::unique_ptr<DataMailboxTransport>(new DataMailboxMemoryTransport("watchdog", network)));
+ *
+ *		client.setRTO_s(5);
+ *		client.receive(enuReceiveOptions::TIMED); // TimedOut, network.getTime() is 5 s
+*/
+class DataMailboxMemoryNetwork
+{
+public:
+	DataMailboxMemoryNetwork();
+
+	DataMailboxMemoryNetwork(const DataMailboxMemoryNetwork&) = delete;
+	DataMailboxMemoryNetwork& operator=(const DataMailboxMemoryNetwork&) = delete;
+
+	/// Virtual time since the network was created
+	std::chrono::nanoseconds getTime();
+
+	/// Moves virtual time forward, frames sent until then become deliverable
+	void advance(std::chrono::nanoseconds duration);
+
+	/// Delay of frames to destinations without a delay of their own, 0 by default
+	void setDeliveryDelay(std::chrono::nanoseconds delay);
+
+	/// Delay of frames to `destination`, also before its transport is created
+	void setDeliveryDelay(const std::string& destination, std::chrono::nanoseconds delay);
+
+	std::chrono::nanoseconds getDeliveryDelay(const std::string& destination);
+
+	/// True (default) - a send to a full queue waits for its receiver, like a POSIX queue. False - the frame is dropped.
+	void setBlockWhenFull(bool block);
+
+	MemoryNetworkStatistics getStatistics();
+
+private:
+	friend class DataMailboxMemoryTransport;
+
+	struct QueuedFrame
+	{
+		std::chrono::nanoseconds m_deliveryTime;
+		std::string m_source;
+		std::vector<char> m_data;
+	};
+
+	struct Queue
+	{
+		mq_attr m_attributes;
+
+		/// Ordered by delivery time, frames delivered at the same time in order of sending
+		std::deque<QueuedFrame> m_frames;
+	};
+
+	std::mutex m_mutex;
+
+	/// Notified when a frame is queued or taken, or the clock moves
+	std::condition_variable m_changed;
+
+	std::chrono::nanoseconds m_time;
+	std::chrono::nanoseconds m_defaultDelay;
+	std::unordered_map<std::string, std::chrono::nanoseconds> m_delays;
+	bool m_blockWhenFull;
+
+	std::unordered_map<std::string, Queue> m_queues;
+
+	MemoryNetworkStatistics m_statistics;
+
+	void attach(const std::string& name, const mq_attr& attributes);
+	void detach(const std::string& name);
+
+	/// Queues `parts` concatenated as one frame
+	void send(const std::string& source, const std::string& destination, const TransportBuffer* parts, size_t count);
+
+	/// `timeout` is used with enuReceiveOptions::TIMED
+	TransportFrame receive(const std::string& name, enuReceiveOptions options, std::chrono::nanoseconds timeout);
+
+	mq_attr getAttributes(const std::string& name);
+	void setAttributes(const std::string& name, const mq_attr& attributes);
+};
+
+/**
+ * @brief Transport of a mailbox `name` in a DataMailboxMemoryNetwork. \see DataMailboxMemoryNetwork
+ *
+ * Frames are copied once, into the destination queue, and never touch the kernel. \n
+ * mq_attr limits are simulated, mq_curmsgs counts the frames deliverable now.
+*/
+class DataMailboxMemoryTransport : public DataMailboxTransport
+{
+public:
+	/// `network` must outlive the transport
+	DataMailboxMemoryTransport(const std::string& name, DataMailboxMemoryNetwork& network, const mq_attr& attributes = MailboxReference::messageAttributes);
+
+	/// Frames still queued for the mailbox are discarded
+	virtual ~DataMailboxMemoryTransport();
+
+	virtual const std::string& getName() const { return m_name; }
+
+	virtual void send(MailboxReference& destination, const char* data, size_t size);
+
+	/// Copies the parts straight into the destination queue
+	virtual void sendGather(MailboxReference& destination, const TransportBuffer* parts, size_t count);
+
+	virtual TransportFrame receive(enuReceiveOptions options);
+
+	/// `timeout` is virtual time
+	virtual TransportFrame receiveFor(const struct timespec& timeout);
+
+	/// The timeout is virtual time
+	virtual void setTimeout_settings(struct timespec timeout) { m_timeout = timeout; }
+	virtual struct timespec getTimeout_settings() { return m_timeout; }
+
+	virtual mq_attr getAttributes();
+
+	/// mq_maxmsg and mq_msgsize take effect at once, frames already queued are kept
+	virtual void setAttributes(const mq_attr& attributes);
+
+	/// Virtual time of the network
+	virtual DataMailboxTime::Clock::time_point now();
+
+	DataMailboxMemoryNetwork& getNetwork() { return m_network; }
+
+private:
+	std::string m_name;
+	DataMailboxMemoryNetwork& m_network;
+	struct timespec m_timeout;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*****************************************************************//**
+ * \file   DataMailboxMessageRegistry.hpp
+ * \brief  Registry of message classes which can be decoded by DataMailbox.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_MESSAGE_REGISTRY_HPP
+#define DATA_MAILBOX_MESSAGE_REGISTRY_HPP
+
+#include "DataMailbox.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Maps MessageDataType codes to message classes, so received frames can be decoded without if-chains.
+ *
+ * Built-in messages are registered in advance. Applications register their own ExtendedDataMailboxMessage \n
+ * subclasses under unused codes, preferably starting at FIRST_USER_TYPE:
+ *
+ *		static const MessageDataType SensorMessageType = (MessageDataType)(DataMailboxMessageRegistry::FIRST_USER_TYPE + 0);
+ *
+ *		DataMailboxMessageRegistry::getInstance().registerType<SensorMessage>(SensorMessageType, "SensorMessage", 16);
+ *
+ *		BasicDataMailboxMessage received = mailbox.receive();
+ *		DataMailboxMessageRegistry::MessagePtr message = DataMailboxMessageRegistry::getInstance().unpack(received);
+ *
+ * Lookup is a flat table indexed by the type code and takes no lock, so decoding every received frame stays cheap. \n
+ * Instances are recycled through a per type pool, a pooled instance keeps the state of its last use until `Unpack()` \n
+ * overwrites it. Thread safe.
+*/
+class DataMailboxMessageRegistry
+{
+public:
+	/// Number of type codes. The high bit of the type byte is reserved for frame flags.
+	static const size_t MAX_TYPES = 128;
+
+	/// First code reserved for application message types. Codes between MessageDataType::COUNT and this one may be used by future built-in types.
+	static const size_t FIRST_USER_TYPE = 64;
+
+	typedef ExtendedDataMailboxMessage* (*Factory)();
+
+	/// Returns the message to the pool of its type instead of deleting it
+	struct PoolReturn
+	{
+		MessageDataType m_dataType;
+
+		void operator()(ExtendedDataMailboxMessage* message) const;
+	};
+
+	typedef std::unique_ptr<ExtendedDataMailboxMessage, PoolReturn> MessagePtr;
+
+	static DataMailboxMessageRegistry& getInstance();
+
+	/**
+	 * @brief Registers message class created by `factory` under `dataType` code.
+	 * @param poolSize Number of instances created in advance and kept for reuse
+	 * @return False (with a warning) if the code is out of range or already registered
+	*/
+	bool registerType(MessageDataType dataType, const std::string& name, Factory factory, size_t poolSize = 0);
+
+	/// Registers default-constructible `MessageClass` under `dataType` code
+	template <typename MessageClass>
+	bool registerType(MessageDataType dataType, const std::string& name, size_t poolSize = 0)
+	{
+		return registerType(dataType, name, []() -> ExtendedDataMailboxMessage* { return new MessageClass(); }, poolSize);
+	}
+
+	/// Returns true for built-in and registered codes
+	bool isRegistered(MessageDataType dataType) const;
+
+	/// Returns registered name of `dataType`, nullptr if it is not registered
+	const char* getName(MessageDataType dataType) const;
+
+	/// Returns pooled (or new) instance of the class registered under `dataType`, nullptr if there is none
+	MessagePtr create(MessageDataType dataType);
+
+	/**
+	 * @brief Decodes `message` into an instance of its registered class. Takes the serialized data of `message`.
+	 * @return nullptr for messages without a class (TimedOut, EmptyQueue, unknown codes)
+	*/
+	MessagePtr unpack(BasicDataMailboxMessage& message);
+
+private:
+	struct Registration
+	{
+		/// Set last, with release order. m_name and m_factory never change once it is true, so lookups read them without the lock.
+		std::atomic<bool> m_registered{ false };
+		std::string m_name;
+		Factory m_factory = nullptr;
+
+		size_t m_poolSize = 0;
+		std::vector<ExtendedDataMailboxMessage*> m_pool;
+	};
+
+	DataMailboxMessageRegistry();
+	~DataMailboxMessageRegistry();
+
+	DataMailboxMessageRegistry(const DataMailboxMessageRegistry&) = delete;
+	DataMailboxMessageRegistry& operator=(const DataMailboxMessageRegistry&) = delete;
+
+	static bool isValidCode(MessageDataType dataType) { return (unsigned char)dataType < MAX_TYPES; }
+
+	void release(MessageDataType dataType, ExtendedDataMailboxMessage* message);
+
+	/// Serializes registrations and guards the pools
+	mutable std::mutex m_mutex;
+	std::array<Registration, MAX_TYPES> m_registrations;
+};
+
+#endif
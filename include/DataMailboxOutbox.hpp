@@ -0,0 +1,150 @@
+/*****************************************************************//**
+ * \file   DataMailboxOutbox.hpp
+ * \brief  Bounded per-destination outbound buffer drained by a background thread.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_OUTBOX_HPP
+#define DATA_MAILBOX_OUTBOX_HPP
+
+#include "SimplifiedMailbox.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/// What DataMailboxOutbox does when a frame is queued for a destination whose buffer is full
+enum class enuOutboxOverflowPolicy : char
+{
+	DROP_OLDEST = 0, // discard the oldest queued frame to make room
+	DROP_NEWEST, // discard the new frame
+	BLOCK, // wait until the flusher makes room
+	REJECT // do not queue, report the error as enuOutboxStatus::FULL
+};
+
+/// Result of queueing a frame in DataMailboxOutbox
+enum class enuOutboxStatus : char
+{
+	QUEUED = 0,
+	DROPPED_OLDEST, // queued, but the oldest frame for the destination was discarded
+	DROPPED_NEWEST, // not queued, the frame was discarded
+	FULL, // not queued, enuOutboxOverflowPolicy::REJECT
+	CONFLATED, // replaced a queued frame with the same conflation key
+	SHED // not queued, the destination backlog is over its high watermark and the type is shed (\see DataMailbox::setDestinationWatermarks())
+};
+
+/// Counters of DataMailboxOutbox, per destination or in total
+struct OutboxStatistics
+{
+	size_t m_queued = 0; // frames waiting in the buffer now
+	size_t m_highestQueued = 0; // highest m_queued seen
+	unsigned long long m_sent = 0;
+	unsigned long long m_droppedOldest = 0;
+	unsigned long long m_droppedNewest = 0;
+	unsigned long long m_rejected = 0; // enuOutboxStatus::FULL
+	unsigned long long m_conflated = 0; // queued frames replaced by a newer frame with the same conflation key
+};
+
+/**
+ * @brief Bounded outbound buffer per destination, each drained by a background flusher thread of its own.
+ *
+ * Frames for one destination are sent in order. The flusher of a destination is started with its first frame, \n
+ * so a full or dead destination queue blocks only its own flusher, the other destinations keep being sent. \n
+ * Destruction waits until all queued frames are sent.
+*/
+class DataMailboxOutbox
+{
+public:
+	/// Sends serialized frame to `destination`, may block. Called from the flusher threads, one per destination at a time.
+	typedef std::function<void(MailboxReference& destination, const char* frame, size_t size)> SendFunction;
+
+	/**
+	 * @param sendFunction Function which sends the frames (e.g. SimplifiedMailbox::send)
+	 * @param capacity Maximum number of queued frames per destination
+	 * @param overflowPolicy What to do when a destination buffer is full
+	 * @param pLogger Pointer to a ILogger* inherited class to log information.
+	*/
+	DataMailboxOutbox(SendFunction sendFunction, size_t capacity, enuOutboxOverflowPolicy overflowPolicy, ILogger* pLogger = NulLogger::getInstance());
+	~DataMailboxOutbox();
+
+	/**
+	 * @brief Queues serialized `frame` for `destination`. Blocks only with enuOutboxOverflowPolicy::BLOCK.
+	 * @param conflationKey If not empty and a frame with the same key is still queued for `destination`, \n
+	 * that frame is replaced in place (keeps its position) instead of queueing a new one.
+	*/
+	enuOutboxStatus enqueue(const MailboxReference& destination, std::string frame, const std::string& conflationKey = "");
+
+	/// Waits until every queued frame is sent, to every destination
+	void flush();
+
+	/// Waits until every frame queued for one destination is sent
+	void flush(const std::string& destinationName);
+
+	/// Returns counters for one destination (all zero for unknown destination)
+	OutboxStatistics getStatistics(const std::string& destinationName);
+
+	/// Returns counters summed over all destinations. m_highestQueued is the highest of any single destination.
+	OutboxStatistics getTotalStatistics();
+
+	size_t getCapacity() const { return m_capacity; }
+	enuOutboxOverflowPolicy getOverflowPolicy() const { return m_overflowPolicy; }
+
+private:
+	struct QueuedFrame
+	{
+		std::string m_frame;
+		std::string m_conflationKey;
+	};
+
+	struct DestinationBuffer
+	{
+		MailboxReference m_destination;
+		std::deque<QueuedFrame> m_frames;
+		OutboxStatistics m_statistics;
+
+		/// Sequence number of m_frames.front(). Frame `i` has sequence m_frontSequence + i.
+		unsigned long long m_frontSequence = 0;
+
+		/// Sequence number of the queued frame for every conflation key
+		std::unordered_map<std::string, unsigned long long> m_conflationIndex;
+
+		/// True while the flusher sends a frame taken from m_frames
+		bool m_sending = false;
+
+		/// Notified when a frame is queued or the outbox is destroyed
+		std::condition_variable m_workAvailable;
+
+		std::thread m_flusher;
+
+		/// Removes the front frame and its conflation index entry
+		QueuedFrame popFront();
+	};
+
+	SendFunction m_sendFunction;
+	size_t m_capacity;
+	enuOutboxOverflowPolicy m_overflowPolicy;
+	ILogger* m_pLogger;
+
+	std::mutex m_mutex;
+	std::condition_variable m_spaceAvailable;
+	std::condition_variable m_drained;
+
+	/// Never erased, so flushers keep references to their buffers
+	std::unordered_map<std::string, DestinationBuffer> m_buffers;
+	size_t m_totalQueued;
+	size_t m_inFlight;
+	bool m_stopping;
+
+	/// Returns buffer of `destination`, creates it and starts its flusher on first use. Called with m_mutex locked.
+	DestinationBuffer& getBuffer(const MailboxReference& destination);
+
+	void flusherLoop(DestinationBuffer& buffer);
+};
+
+#endif
@@ -0,0 +1,178 @@
+/*****************************************************************//**
+ * \file   DataMailboxRPC.hpp
+ * \brief  Pipelined request/reply layer on top of DataMailbox.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_RPC_HPP
+#define DATA_MAILBOX_RPC_HPP
+
+#include "DataMailbox.hpp"
+#include "DataMailboxTime.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <unordered_map>
+
+
+/**
+ * @brief Envelope which stamps a correlation id on any other DataMailboxMessage.
+ *
+ * Serialized layout: \n
+ *		[MessageDataType::RPCMessage][enuRPCKind][uint32_t correlationId][serialized payload message]
+*/
+class RPCMessage : public ExtendedDataMailboxMessage
+{
+public:
+	typedef enum : char
+	{
+		REQUEST = 0,
+		REPLY
+	} enuRPCKind;
+
+	RPCMessage();
+
+	/// Serializes `payload` and keeps a copy of its frame. `payload` can be reused or destroyed afterwards.
+	RPCMessage(enuRPCKind kind, uint32_t correlationId, DataMailboxMessage* payload);
+
+	virtual ~RPCMessage() {}
+
+	virtual void Serialize();
+	virtual void Deserialize();
+	virtual bool describeFrame(GatherFrame& frame);
+	virtual std::string getInfo();
+	virtual size_t formatInfo(char* buffer, size_t size);
+
+	enuRPCKind getKind() const { return m_kind; }
+	uint32_t getCorrelationId() const { return m_correlationId; }
+
+	/// Returns the wrapped message as if it was received directly by DataMailbox. Unpack it to the specific message class.
+	BasicDataMailboxMessage getPayload();
+
+private:
+	enuRPCKind m_kind;
+	uint32_t m_correlationId;
+
+	std::string m_payload;
+};
+
+/**
+ * @brief Client and server side of request/reply over a DataMailbox.
+ *
+ * Any number of requests can be in flight, to the same or different destinations. \n
+ * Replies are matched to requests by correlation id, so they can arrive in any order. \n
+ * Replies are only dispatched while `receive()` is being called - DataMailboxRPC does not own a thread. \n
+ * \n
+ * Example client:
+ *
+ *		DataMailboxRPC rpc(mailbox);
+ *		rpc.call(watchdog, &registerRequest, timeout, [](BasicDataMailboxMessage& reply)
+ *		{
+ *			if (reply.getDataType() == MessageDataType::TimedOut)
+ *				return; // no reply in time
+ *
+ *			WatchdogMessage message;
+ *			message.Unpack(reply);
+ *		});
+ *
+ *		while (true)
+ *		{
+ *			BasicDataMailboxMessage message = rpc.receive(); // replies are routed to callbacks, everything else is returned
+ *			// (...)
+ *		}
+ *
+ * Example server:
+ *
+ *		BasicDataMailboxMessage message = rpc.receive();
+ *		if (message.getDataType() == MessageDataType::RPCMessage)
+ *		{
+ *			RPCMessage request;
+ *			request.Unpack(message);
+ *
+ *			BasicDataMailboxMessage payload = request.getPayload();
+ *			// (...)
+ *			rpc.reply(request, &response);
+ *		}
+*/
+class DataMailboxRPC
+{
+public:
+	typedef uint32_t CorrelationId;
+
+	/// Called with the reply, or with a message of type MessageDataType::TimedOut if no reply arrived before the timeout.
+	typedef std::function<void(BasicDataMailboxMessage& reply)> ReplyCallback;
+
+	/**
+	 * @brief Creates RPC layer over `mailbox`
+	 * @param mailbox DataMailbox used to send requests and receive replies. Must outlive DataMailboxRPC.
+	 * @param pLogger Pointer to a ILogger* inherited class to log information.
+	*/
+	DataMailboxRPC(DataMailbox& mailbox, ILogger* pLogger = NulLogger::getInstance());
+	~DataMailboxRPC();
+
+	/**
+	 * @brief Sends `request` to `destination` and registers `callback` for the reply
+	 * @param timeout Maximum time to wait for the reply, relative to now
+	 * @return Correlation id of the request. Can be used to cancel it.
+	*/
+	CorrelationId call(MailboxReference& destination, DataMailboxMessage* request, const struct timespec& timeout, ReplyCallback callback);
+
+	/**
+	 * @brief Sends `request` to `destination`
+	 * @return Future which gets the reply (or a MessageDataType::TimedOut message). Completed by `receive()`.
+	*/
+	std::future<BasicDataMailboxMessage> call(MailboxReference& destination, DataMailboxMessage* request, const struct timespec& timeout);
+
+	/// Forgets the pending request. Its callback is never called. Returns false if there is no such pending request.
+	bool cancel(CorrelationId correlationId);
+
+	/// Sends `response` back to the source of `request` with the same correlation id
+	void reply(RPCMessage& request, DataMailboxMessage* response);
+
+	/**
+	 * @brief Receives messages, dispatching RPC replies and expired requests to their callbacks.
+	 *
+	 * Returns the first message which is not an RPC reply (requests are returned as RPCMessage). \n
+	 * With enuReceiveOptions::TIMED and enuReceiveOptions::NONBLOCKING it returns \n
+	 * MessageDataType::TimedOut and MessageDataType::EmptyQueue messages just like DataMailbox::receive(). \n
+	 * Expired timers of the mailbox (`DataMailbox::scheduleTimer()`) are returned with any options.
+	*/
+	BasicDataMailboxMessage receive(enuReceiveOptions options = enuReceiveOptions::NORMAL);
+
+	/// Returns number of requests waiting for a reply
+	size_t getPendingCount() const { return m_pending.size(); }
+
+private:
+	typedef DataMailboxTime::Clock Clock;
+	typedef std::multimap<Clock::time_point, CorrelationId> DeadlineMap;
+
+	struct PendingCall
+	{
+		ReplyCallback m_callback;
+		MailboxReference m_destination;
+		DeadlineMap::iterator m_deadline;
+	};
+
+	DataMailbox& m_mailbox;
+	ILogger* m_pLogger;
+
+	CorrelationId m_nextCorrelationId;
+
+	std::unordered_map<CorrelationId, PendingCall> m_pending;
+	DeadlineMap m_deadlines;
+
+	/// Calls callbacks of all requests whose deadline passed with a TimedOut message
+	void expireCalls(Clock::time_point now);
+
+	/// Routes the reply to its pending request. Unknown (late or cancelled) replies are dropped.
+	void dispatchReply(RPCMessage& reply);
+
+	/// Receives one message from the mailbox waiting at most until `deadline`
+	BasicDataMailboxMessage receiveUntil(Clock::time_point deadline);
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*****************************************************************//**
+ * \file   DataMailboxRealtime.hpp
+ * \brief  CPU affinity, real-time scheduling and memory locking of latency critical mailbox threads.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_REALTIME_HPP
+#define DATA_MAILBOX_REALTIME_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// Real-time settings of a thread, everything is off by default. \see DataMailbox::applyRealtimeSettings()
+struct RealtimeSettings
+{
+	/// CPUs the thread may run on. Empty - affinity is not changed.
+	std::vector<int> m_cpus;
+
+	/// SCHED_FIFO priority, 1 (lowest) to 99. 0 - scheduling class is not changed.
+	int m_priority = 0;
+
+	/// Locks all current and future memory of the process (`mlockall()`), so it is never paged out and new mappings are faulted in at once
+	bool m_lockMemory = false;
+
+	/// Bytes of stack of the calling thread touched in advance
+	size_t m_prefaultStack = 0;
+
+	/// Bytes of heap allocated, touched and freed in advance. malloc then keeps freed memory instead of returning it to the system.
+	size_t m_prefaultHeap = 0;
+
+	/// Nodes of the DataMailbox timer pool allocated in advance, for this many timers scheduled at once
+	size_t m_timerCapacity = 0;
+};
+
+/// Outcome of one setting of RealtimeSettings
+enum class enuRealtimeStatus : char
+{
+	NOT_REQUESTED = 0,
+	APPLIED,
+	FAILED
+};
+
+struct RealtimeSettingResult
+{
+	enuRealtimeStatus m_status = enuRealtimeStatus::NOT_REQUESTED;
+
+	/// What was applied (e.g. "CPUs 2,3") or why it failed (e.g. "Operation not permitted")
+	std::string m_detail;
+};
+
+/// Which of the RealtimeSettings were actually applied
+struct RealtimeReport
+{
+	RealtimeSettingResult m_affinity;
+	RealtimeSettingResult m_scheduling;
+	RealtimeSettingResult m_memoryLock;
+	RealtimeSettingResult m_prefault;
+
+	/// True if nothing requested failed
+	bool isComplete() const;
+
+	/// One line, e.g. "affinity: CPUs 2 | scheduling: FAILED (Operation not permitted) | memory lock: off | prefault: 256 KiB stack, 8192 KiB heap"
+	std::string toString() const;
+};
+
+namespace DataMailboxRealtime
+{
+	/**
+	 * @brief Applies `settings` to the calling thread (and memory locking to the whole process).
+	 *
+	 * Settings are independent, one failing (usually for lack of CAP_SYS_NICE or RLIMIT_MEMLOCK) does not stop the others. \n
+	 * Memory is locked before it is prefaulted, so the prefaulted pages stay resident.
+	*/
+	RealtimeReport applyToCurrentThread(const RealtimeSettings& settings);
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*****************************************************************//**
+ * \file   DataMailboxSizingAdvisor.hpp
+ * \brief  Recommends mq_attr of a mailbox queue from the frame sizes and queue depths it observed.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_SIZING_ADVISOR_HPP
+#define DATA_MAILBOX_SIZING_ADVISOR_HPP
+
+#include <mqueue.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// What DataMailboxSizingAdvisor sizes the queue for. \see DataMailbox::enableSizingAdvisor()
+struct SizingOptions
+{
+	/// Highest acceptable fraction of sends which find the queue full and block
+	double m_blockingProbability = 0.001;
+
+	/// mq_msgsize is the largest frame seen, enlarged by this fraction and rounded up to MSGSIZE_GRANULARITY
+	double m_sizeHeadroom = 0.25;
+
+	/// Bytes added to every frame on top of what the transport reports. \n
+	/// DataMailbox already records frames with DataMailboxTransport::getFrameOverhead(), e.g. the SimplifiedMailbox header and source name.
+	size_t m_frameOverhead = 0;
+
+	/// No recommendation is made before this many frames were received
+	unsigned long long m_minimumFrames = 1000;
+
+	/// The queue depth is sampled on every m_depthSampleInterval-th received frame, sampling may take a system call
+	unsigned int m_depthSampleInterval = 16;
+};
+
+/// Observed traffic and the mq_attr recommended for it
+struct SizingRecommendation
+{
+	/// False if fewer than SizingOptions::m_minimumFrames frames were received, m_recommended is m_current then
+	bool m_valid = false;
+
+	mq_attr m_current = {};
+	mq_attr m_recommended = {};
+
+	unsigned long long m_frames = 0;
+	size_t m_largestFrame = 0;
+	size_t m_frameP99 = 0;
+
+	unsigned long long m_depthSamples = 0;
+	long m_depthP50 = 0;
+	long m_depthP99 = 0;
+	long m_largestDepth = 0;
+
+	/// Fraction of depth samples at which the queue was full
+	double m_observedBlocking = 0;
+
+	/// The queue was full more often than allowed, so the demand above mq_maxmsg is unknown and m_recommended doubles it
+	bool m_saturated = false;
+
+	/// \see DataMailboxSizingAdvisor::estimateKernelMemory()
+	size_t m_currentBytes = 0;
+	size_t m_recommendedBytes = 0;
+
+	/// One line, e.g. "frames 12000 (largest 86 B, p99 80 B) | depth p50 1 p99 3 max 4 of 10, full 0.00% | maxmsg 10 msgsize 8192 (81 KiB) -> maxmsg 5 msgsize 128 (1 KiB), saves 80 KiB"
+	std::string toString() const;
+};
+
+/**
+ * @brief Records sizes of received frames and sampled depths of a queue and recommends the smallest mq_attr for them.
+ *
+ * mq_msgsize must fit every frame, so it follows the largest frame seen. mq_maxmsg is the smallest depth \n
+ * which the sampled depths reached no more often than SizingOptions::m_blockingProbability. \n
+ * Called only from the receiving thread of the mailbox.
+*/
+class DataMailboxSizingAdvisor
+{
+public:
+	/// Frame sizes are counted in buckets of this many bytes, mq_msgsize is rounded up to a multiple of it
+	static const size_t MSGSIZE_GRANULARITY = 64;
+
+	explicit DataMailboxSizingAdvisor(const SizingOptions& options);
+
+	/// Records a received frame taking `size` bytes of the queue, the header of the transport included
+	void recordFrame(size_t size);
+
+	/// Counts a received frame, returns true on every m_depthSampleInterval-th one
+	bool isDepthSampleDue();
+
+	/// Records number of frames waiting in the queue, including the one just received
+	void recordDepth(long depth);
+
+	SizingRecommendation recommend(const mq_attr& current) const;
+
+	/**
+	 * @brief Returns bytes a POSIX queue with `attributes` is charged against RLIMIT_MSGQUEUE.
+	 *
+	 * Linux charges the full mq_msgsize of every possible message plus the kernel bookkeeping \n
+	 * (struct msg_msg and a priority tree node, about 6 pointers each), whether the queue is full or not.
+	*/
+	static size_t estimateKernelMemory(const mq_attr& attributes);
+
+private:
+	SizingOptions m_options;
+
+	/// Frames per MSGSIZE_GRANULARITY bucket of size
+	std::vector<unsigned long long> m_frameSizes;
+	unsigned long long m_frameCount;
+	size_t m_largestFrame;
+
+	/// Samples per depth
+	std::vector<unsigned long long> m_depths;
+	unsigned long long m_depthSampleCount;
+
+	unsigned int m_framesUntilSample;
+};
+
+#endif
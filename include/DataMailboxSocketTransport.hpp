@@ -0,0 +1,148 @@
+/*****************************************************************//**
+ * \file   DataMailboxSocketTransport.hpp
+ * \brief  Unix-domain SOCK_SEQPACKET transport of DataMailbox frames.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_SOCKET_TRANSPORT_HPP
+#define DATA_MAILBOX_SOCKET_TRANSPORT_HPP
+
+#include "DataMailboxTransport.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Transport over Unix-domain SOCK_SEQPACKET sockets `<directory>/<name>.sock`.
+ *
+ * Works across containers which share `directory` (e.g. a bind mount), without the POSIX queue limits. \n
+ * Every sender keeps one connection per destination and introduces itself with its name, \n
+ * so frames carry no per-frame header. Frames are sent and received up to BATCH_SIZE per \n
+ * `sendmmsg()` / `recvmmsg()` call. A full receiver blocks its senders, like a full queue. \n
+ * Threads sending at the same time share the connections and do not wait for each other. \n
+ * No lock is held while sending, so a blocked receiver does not delay connecting to other ones.
+ *
+ * Example:
+ *
+ *		DataMailbox mailbox(std::unique_ptr<DataMailboxTransport>(new DataMailboxSocketTransport("reader")));
+*/
+class DataMailboxSocketTransport : public DataMailboxTransport
+{
+public:
+	static const char* const DEFAULT_DIRECTORY;
+
+	static const size_t DEFAULT_MAX_FRAME_SIZE = 8192;
+
+	/// Maximum number of frames moved by one system call
+	static const size_t BATCH_SIZE = 16;
+
+	/// Listens on `<directory>/<name>.sock`. A socket file left by a crashed process is replaced.
+	DataMailboxSocketTransport(const std::string& name, const std::string& directory = DEFAULT_DIRECTORY, size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE);
+	virtual ~DataMailboxSocketTransport();
+
+	virtual const std::string& getName() const { return m_name; }
+
+	virtual void send(MailboxReference& destination, const char* data, size_t size);
+	virtual void sendBatch(MailboxReference& destination, const TransportBuffer* frames, size_t count);
+
+	/// Sends the parts as one record straight from their buffers, the kernel gathers them
+	virtual void sendGather(MailboxReference& destination, const TransportBuffer* parts, size_t count);
+
+	virtual TransportFrame receive(enuReceiveOptions options);
+	virtual TransportFrame receiveFor(const struct timespec& timeout);
+
+	virtual void setTimeout_settings(struct timespec timeout) { m_timeout = timeout; }
+	virtual struct timespec getTimeout_settings() { return m_timeout; }
+
+	/// mq_msgsize is the maximum frame size, mq_curmsgs the frames already readable. mq_maxmsg is not limited (0).
+	virtual mq_attr getAttributes();
+
+	/// Only mq_msgsize is used
+	virtual void setAttributes(const mq_attr& attributes);
+
+	/// Sends frames as if from mailbox `source`. Used by bridges forwarding frames of other mailboxes.
+	void sendAs(const std::string& source, MailboxReference& destination, const TransportBuffer* frames, size_t count);
+
+	static std::string getSocketPath(const std::string& directory, const std::string& name);
+
+private:
+	/// Accepted connection of one sender
+	struct InboundConnection
+	{
+		int m_fd;
+		std::string m_source; // empty until the sender introduced itself
+	};
+
+	/// Connected socket to one destination, closed when the last sender using it releases it
+	struct OutboundConnection
+	{
+		int m_fd;
+
+		explicit OutboundConnection(int fd) : m_fd(fd) {}
+		~OutboundConnection();
+
+		OutboundConnection(const OutboundConnection&) = delete;
+		OutboundConnection& operator=(const OutboundConnection&) = delete;
+	};
+
+	typedef std::shared_ptr<OutboundConnection> OutboundConnectionPtr;
+
+	std::string m_name;
+	std::string m_directory;
+	std::string m_path;
+	size_t m_maxFrameSize;
+
+	int m_listenFd;
+	struct timespec m_timeout;
+
+	std::vector<InboundConnection> m_connections;
+
+	/// Frames read by `recvmmsg()` but not returned yet
+	std::deque<TransportFrame> m_received;
+
+	/// Receive buffers of one `recvmmsg()` call, BATCH_SIZE * m_maxFrameSize
+	std::vector<char> m_receiveBuffer;
+	std::vector<struct pollfd> m_pollFds;
+
+	/// Shared while looking up m_outbound, exclusive while adding or removing connections. Never held while sending.
+	std::shared_timed_mutex m_outboundMutex;
+
+	/// Connection of every source (this mailbox, or the ones a bridge forwards for) to every destination
+	std::unordered_map<std::string, std::unordered_map<std::string, OutboundConnectionPtr>> m_outbound;
+
+	/// Waits up to `pTimeout` (nullptr - forever) until frames are readable and reads them
+	void fetch(const struct timespec* pTimeout);
+
+	void acceptConnections();
+
+	/// Returns the first frame of m_received, or an empty frame of `emptyType`
+	TransportFrame takeReceived(enuMessageType emptyType);
+
+	/// Reads frames of the connection to m_received. Returns false if the sender closed it.
+	bool readConnection(InboundConnection& connection);
+
+	/// Sends `count` prepared messages in order, reconnecting once if the receiver restarted. \n
+	/// Returns false (with a warning) if they could not be sent.
+	bool sendMessages(const std::string& source, const std::string& destination, struct mmsghdr* messages, size_t count);
+
+	/// Returns the connection or nullptr if not connected yet. Called with m_outboundMutex locked (shared or exclusive).
+	OutboundConnectionPtr findOutboundConnection(const std::string& source, const std::string& destination) const;
+
+	/// Connects and adds the socket to m_outbound. Called with m_outboundMutex locked exclusively.
+	bool connectOutbound(const std::string& source, const std::string& destination);
+
+	/// Connects and sends `source` as the first frame. Returns -1 if `destination` does not listen.
+	int connectTo(const std::string& source, const std::string& destination);
+};
+
+#endif
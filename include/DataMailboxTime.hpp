@@ -0,0 +1,36 @@
+/*****************************************************************//**
+ * \file   DataMailboxTime.hpp
+ * \brief  Conversions between timespec (used by the mailbox RTO settings) and std::chrono.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_TIME_HPP
+#define DATA_MAILBOX_TIME_HPP
+
+#include <chrono>
+#include <ctime>
+
+namespace DataMailboxTime
+{
+	/// Monotonic clock used for all DataMailbox deadlines
+	typedef std::chrono::steady_clock Clock;
+
+	/// Converts relative `time` (e.g. RTO) to a duration
+	inline std::chrono::nanoseconds fromTimespec(const struct timespec& time)
+	{
+		return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+	}
+
+	/// Converts `duration` to a normalized relative timespec (tv_nsec < 1e9)
+	inline struct timespec toTimespec(std::chrono::nanoseconds duration)
+	{
+		struct timespec time;
+		time.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(duration).count();
+		time.tv_nsec = (duration - std::chrono::seconds(time.tv_sec)).count();
+		return time;
+	}
+}
+
+#endif
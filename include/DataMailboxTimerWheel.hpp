@@ -0,0 +1,104 @@
+/*****************************************************************//**
+ * \file   DataMailboxTimerWheel.hpp
+ * \brief  Hierarchical timer wheel used by DataMailbox for cancellable timers.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_TIMER_WHEEL_HPP
+#define DATA_MAILBOX_TIMER_WHEEL_HPP
+
+#include "DataMailboxTime.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Hierarchical timer wheel with O(1) schedule and cancel.
+ *
+ * Time is divided into ticks of `resolution`. There are LEVELS wheels of SLOTS slots each, \n
+ * so timers up to SLOTS^LEVELS ticks in the future are stored without overflow lists \n
+ * (2^32 ticks - about 49 days with the default 1 ms resolution). Longer delays are clamped. \n
+ * \n
+ * Timers are nodes of a pool linked into slot lists by index, so scheduling and cancelling \n
+ * never search. Timers fire at or after their deadline, never before. \n
+ * The wheel does not read the clock itself, the owner passes `now` to every call.
+*/
+class DataMailboxTimerWheel
+{
+public:
+	/// Identifies scheduled timer. Low 32 bits are the pool index, high 32 bits the reuse generation. 0 is never a valid id.
+	typedef uint64_t TimerId;
+
+	static const unsigned int LEVEL_BITS = 8;
+	static const unsigned int SLOTS = 1 << LEVEL_BITS;
+	static const unsigned int LEVELS = 4;
+
+	DataMailboxTimerWheel(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1), DataMailboxTime::Clock::time_point start = DataMailboxTime::Clock::now());
+
+	/// Schedules timer which expires `delay` after `now`
+	TimerId schedule(std::chrono::nanoseconds delay, DataMailboxTime::Clock::time_point now);
+
+	/// Cancels the timer. Returns false if the timer already expired or was cancelled.
+	bool cancel(TimerId timerId);
+
+	/// Moves the wheel to `now` and appends ids of expired timers to `expired` in order of expiry
+	void advance(DataMailboxTime::Clock::time_point now, std::vector<TimerId>& expired);
+
+	/**
+	 * @brief Returns time at which `advance()` should be called next.
+	 *
+	 * Exact for timers in the next SLOTS ticks, otherwise the time of the next cascade \n
+	 * (which does not necessarily expire anything). time_point::max() if there are no timers.
+	*/
+	DataMailboxTime::Clock::time_point getNextWakeup() const;
+
+	/// Allocates pool nodes for `timers` timers scheduled at once, so `schedule()` does not allocate until there are more
+	void reserve(size_t timers);
+
+	/// Returns number of scheduled (not expired, not cancelled) timers
+	size_t getActiveCount() const { return m_activeCount; }
+
+private:
+	static const uint32_t NIL = 0xFFFFFFFF;
+
+	struct TimerNode
+	{
+		uint32_t m_next;
+		uint32_t m_prev;
+		uint32_t m_generation;
+		uint32_t m_slot; // index into m_slots, NIL when the node is free
+		uint64_t m_expiryTick;
+	};
+
+	std::chrono::nanoseconds m_resolution;
+	DataMailboxTime::Clock::time_point m_start;
+
+	uint64_t m_currentTick;
+	size_t m_activeCount;
+
+	std::vector<TimerNode> m_nodes;
+	uint32_t m_freeList;
+
+	/// Head node index of every slot of every level. Slot `s` of level `l` is at `l * SLOTS + s`.
+	std::array<uint32_t, SLOTS * LEVELS> m_slots;
+	std::array<size_t, LEVELS> m_levelCounts;
+
+	uint64_t toTick(DataMailboxTime::Clock::time_point time) const;
+	DataMailboxTime::Clock::time_point toTime(uint64_t tick) const;
+
+	/// Links the node into the slot determined by its expiry tick relative to the current tick
+	void place(uint32_t nodeIndex);
+	void unlink(uint32_t nodeIndex);
+	void release(uint32_t nodeIndex);
+
+	/// Re-places all timers of slot `slot` of `level` into lower levels
+	void cascade(unsigned int level, unsigned int slot);
+
+	/// Processes `m_currentTick` - cascades higher levels on wrap and expires level 0 slot
+	void processTick(std::vector<TimerId>& expired);
+};
+
+#endif
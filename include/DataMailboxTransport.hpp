@@ -0,0 +1,135 @@
+/*****************************************************************//**
+ * \file   DataMailboxTransport.hpp
+ * \brief  Interface of the frame transports DataMailbox sends and receives through.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#ifndef DATA_MAILBOX_TRANSPORT_HPP
+#define DATA_MAILBOX_TRANSPORT_HPP
+
+#include "DataMailboxTime.hpp"
+#include "SimplifiedMailbox.hpp"
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+
+/// Frame returned by DataMailboxTransport::receive()
+struct TransportFrame
+{
+	/// enuMessageType::DATA, or TIMED_OUT / EMPTY when nothing was received
+	enuMessageType m_type = enuMessageType::EMPTY;
+
+	/// Allocated with new[], the caller takes ownership
+	char* m_pData = nullptr;
+	size_t m_size = 0;
+
+	/// Name of the sending mailbox
+	std::string m_source;
+};
+
+/// One frame of DataMailboxTransport::sendBatch(), or one part of a frame of DataMailboxTransport::sendGather()
+struct TransportBuffer
+{
+	const char* m_pData;
+	size_t m_size;
+};
+
+/**
+ * @brief Moves serialized frames between named mailboxes. Implementations keep message boundaries.
+ *
+ * Mailboxes are addressed by MailboxReference names, whatever the transport. \n
+ * `send()` and `sendBatch()` may be called from several threads, `receive()` only from one.
+*/
+class DataMailboxTransport
+{
+public:
+	/// Most parts `sendGather()` is called with
+	static const size_t MAX_GATHER_PARTS = 8;
+
+	virtual ~DataMailboxTransport() = default;
+
+	/// Name other mailboxes send to
+	virtual const std::string& getName() const = 0;
+
+	/// Sends one frame, blocks while the destination is full
+	virtual void send(MailboxReference& destination, const char* data, size_t size) = 0;
+
+	virtual void sendConnectionless(MailboxReference& destination, const char* data, size_t size) { send(destination, data, size); }
+
+	/// Sends frames in order. Transports with batched I/O send them with fewer system calls.
+	virtual void sendBatch(MailboxReference& destination, const TransportBuffer* frames, size_t count);
+
+	/// Sends one frame made of `parts` concatenated. Transports with scatter/gather I/O send the parts in place, \n
+	/// the default copies them into one buffer and calls `send()`.
+	virtual void sendGather(MailboxReference& destination, const TransportBuffer* parts, size_t count);
+
+	/// Receives one frame. With enuReceiveOptions::TIMED waits no longer than the timeout settings.
+	virtual TransportFrame receive(enuReceiveOptions options) = 0;
+
+	/// Receives one frame, waits no longer than `timeout`. The default swaps the timeout settings for the call.
+	virtual TransportFrame receiveFor(const struct timespec& timeout);
+
+	virtual void setTimeout_settings(struct timespec timeout) = 0;
+	virtual struct timespec getTimeout_settings() = 0;
+
+	virtual void setRTO_s(time_t RTOs) { setTimeout_settings(timespec{ RTOs, 0 }); }
+	virtual void setRTO_ns(long RTOns) { setTimeout_settings(timespec{ 0, RTOns }); }
+
+	/// Limits in mq_attr terms: mq_maxmsg depth, mq_msgsize maximum frame size, mq_curmsgs frames waiting
+	virtual mq_attr getAttributes() = 0;
+	virtual void setAttributes(const mq_attr& attributes) = 0;
+
+	/// Time of the receive deadlines and timers of DataMailbox. Transports with a virtual clock return its time.
+	virtual DataMailboxTime::Clock::time_point now() { return DataMailboxTime::Clock::now(); }
+
+	/// Bytes the received `frame` took in the queue on top of its payload (a header of the transport, the source name), counted against mq_msgsize
+	virtual size_t getFrameOverhead(const TransportFrame&) const { return 0; }
+};
+
+/**
+ * @brief POSIX message queue transport, the default of DataMailbox.
+ *
+ * Receives through SimplifiedMailbox. Sends write the SimplifiedMailbox frame (header, source name, payload) \n
+ * with `mq_send()` on a descriptor opened for the call, as SimplifiedMailbox is not thread-safe. \n
+ * Sending threads share no state and take no lock, so a full destination blocks only the threads sending to it, \n
+ * and a restarted receiver is found by the next send.
+*/
+class DataMailboxMqTransport : public DataMailboxTransport
+{
+public:
+	DataMailboxMqTransport(const std::string& name, ILogger* pLogger, const mq_attr& mailboxAttributes = MailboxReference::messageAttributes);
+	virtual ~DataMailboxMqTransport() {}
+
+	virtual const std::string& getName() const { return m_name; }
+
+	virtual void send(MailboxReference& destination, const char* data, size_t size);
+	virtual void sendConnectionless(MailboxReference& destination, const char* data, size_t size);
+
+	virtual TransportFrame receive(enuReceiveOptions options);
+
+	virtual void setTimeout_settings(struct timespec timeout);
+	virtual struct timespec getTimeout_settings();
+
+	virtual void setRTO_s(time_t RTOs);
+	virtual void setRTO_ns(long RTOns);
+
+	virtual mq_attr getAttributes();
+	virtual void setAttributes(const mq_attr& attributes);
+
+	/// SimplifiedMailbox header and the source name with its terminator, which SimplifiedMailbox strips on receive
+	virtual size_t getFrameOverhead(const TransportFrame& frame) const;
+
+private:
+	/// Sends one SimplifiedMailbox frame straight to the destination queue, blocks while it is full
+	void sendFrame(MailboxReference& destination, const char* data, size_t size);
+
+	SimplifiedMailbox m_mailbox;
+
+	/// Cached, SimplifiedMailbox returns a copy
+	std::string m_name;
+};
+
+#endif
@@ -1,290 +1,1353 @@
 #include "DataMailbox.hpp"
+#include "DataMailboxMessageRegistry.hpp"
+#include "DataMailboxCRC32C.hpp"
+#include "DataMailboxAsyncLogger.hpp"
 
 #include "Kernel.hpp"
 
 #include "Time.hpp"
+#include "DataMailboxTime.hpp"
 
+#include <cstdio>
 #include <cstring>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+static constexpr const char* DATA_TYPE_NAMES[] =
+{
+	"NONE",
+	"EmptyQueue",
+	"TimedOut",
+	"KeypadMessage_wPassword",
+	"KeypadMessage_wCommand",
+	"RFIDMessage",
+	"StringMessage",
+	"WatchdogMessage",
+	"RPCMessage"
+};
+
+static_assert(sizeof(DATA_TYPE_NAMES) / sizeof(DATA_TYPE_NAMES[0]) == (size_t)MessageDataType::COUNT, "DATA_TYPE_NAMES does not match MessageDataType");
+
+/// Sentinel frames of the messages DataMailbox makes up itself. Shared, never freed.
+static const char TIMED_OUT_FRAME[] = { (char)MessageDataType::TimedOut };
+static const char EMPTY_QUEUE_FRAME[] = { (char)MessageDataType::EmptyQueue };
+
+/// Converts snprintf() result to the length actually written into a buffer of `size` bytes
+static size_t writtenInfoLength(int length, size_t size)
+{
+	if (length < 0 || size == 0)
+		return 0;
+
+	return std::min((size_t)length, size - 1);
+}
 
 const std::string getDataTypeName(MessageDataType dataType)
 {
-	std::array<std::string, 8> names = { 
-		"NONE"
-		"TimedOut",
-		"EmptyQueue",
-		"KeypadMessage_wPassword",
-		"KeypadMessage_wCommand",
-		"RFIDMessage",
-		"StringMessage",
-		"WatchdogMessage"
+	return getDataTypeNameCStr(dataType);
+}
+
+const char* getDataTypeNameCStr(MessageDataType dataType)
+{
+	if ((int)dataType >= 0 && (int)dataType < (int)MessageDataType::COUNT)
+		return DATA_TYPE_NAMES[(int)dataType];
+
+	const char* registeredName = DataMailboxMessageRegistry::getInstance().getName(dataType);
+
+	return registeredName != nullptr ? registeredName : "INVALID";
+}
+
+bool GatherFrame::appendHeader(const void* data, size_t size)
+{
+	if (size > HEADER_CAPACITY - m_headerSize)
+		return false;
+
+	memcpy(m_header + m_headerSize, data, size);
+	m_headerSize += size;
+
+	return true;
+}
+
+bool GatherFrame::appendPart(const char* data, size_t size)
+{
+	if (m_partCount == MAX_PARTS)
+		return false;
+
+	m_parts[m_partCount++] = TransportBuffer{ data, size };
+
+	return true;
+}
+
+DataMailboxMessage::DataMailboxMessage()
+	: m_dataType(MessageDataType::NONE),
+	m_ownsSerializedData(true),
+	m_capacityOfSerializedData(0),
+	m_serialized(nullptr),
+	m_sizeOfSerializedData(0)
+{
+
+}
+
+DataMailboxMessage::DataMailboxMessage(MessageDataType dataType)
+	: m_dataType(dataType),
+	m_ownsSerializedData(true),
+	m_capacityOfSerializedData(0),
+	m_serialized(nullptr),
+	m_sizeOfSerializedData(0)
+{
+
+}
+
+DataMailboxMessage::DataMailboxMessage(const DataMailboxMessage& other)
+	: m_dataType(other.m_dataType),
+	m_ownsSerializedData(true),
+	m_capacityOfSerializedData(0),
+	m_serialized(nullptr),
+	m_sizeOfSerializedData(0),
+	m_source(other.m_source)
+{
+
+}
+
+DataMailboxMessage& DataMailboxMessage::operator=(const DataMailboxMessage& other)
+{
+	if (this == &other)
+		return *this;
+
+	deleteSerializedData();
+
+	m_dataType = other.m_dataType;
+	m_source = other.m_source;
+
+	return *this;
+}
+
+DataMailboxMessage::~DataMailboxMessage()
+{
+	deleteSerializedData();
+}
+
+void DataMailboxMessage::DumpSerialData(const std::string filepath)
+{
+	if (m_serialized == nullptr)
+	{
+		Kernel::Warning("Trying to dump message with no serialized data! ");
+		Serialize();
+	}
+
+	std::ofstream dump(filepath + ".dump", std::ios::out | std::ios::binary);
+	if (!dump)
+	{
+		Kernel::Warning("Cannot dump message: " + getInfo());
+		return;
+	}
+
+	dump.write(m_serialized, m_sizeOfSerializedData);
+
+	Kernel::Trace("Serial data dumped!");
+
+	// deleteSerializedData();
+
+	dump.close();
+}
+
+bool DataMailboxMessage::decodeMessageDataType()
+{
+
+	if (m_serialized == nullptr)
+	{
+		Kernel::Fatal_Error("Cannot decode message datatype from null pointer!");
+	}
+
+	memcpy(&m_dataType, m_serialized, sizeof(MessageDataType));
+
+	// Built-in types are known without asking the registry
+	if ((int)m_dataType >= 0 && (int)m_dataType < (int)MessageDataType::COUNT)
+		return true;
+
+	if (DataMailboxMessageRegistry::getInstance().isRegistered(m_dataType))
+		return true;
+
+	// Only the first one of the process is dumped and reported, a flood of foreign frames must not turn into disk I/O
+	static std::atomic<bool> reported(false);
+
+	if (!reported.exchange(true))
+	{
+		Kernel::DumpRawData(m_serialized, m_sizeOfSerializedData, "invalid_message_datatype_pid_" + std::to_string( getpid() ) );
+		Kernel::Warning("Message has invalid datatype: " + std::to_string((int)m_dataType) + " from - " + m_source.getName()
+			+ ". Further ones are not reported, see DataMailbox::getUnknownTypeCount()");
+	}
+
+	m_dataType = MessageDataType::NONE;
+
+	return false;
+}
+
+size_t DataMailboxMessage::formatInfo(char* buffer, size_t size)
+{
+	return writtenInfoLength(snprintf(buffer, size, "%s", getInfo().c_str()), size);
+}
+
+bool DataMailboxMessage::describeFrame(GatherFrame&)
+{
+	return false;
+}
+
+void DataMailboxMessage::setSerializedData(char* rawData, size_t dataSize)
+{
+	m_serialized = rawData;
+	m_sizeOfSerializedData = dataSize;
+	m_capacityOfSerializedData = (uint32_t)dataSize;
+	m_ownsSerializedData = true;
+}
+
+void DataMailboxMessage::setStaticSerializedData(const char* rawData, size_t dataSize)
+{
+	deleteSerializedData();
+
+	m_serialized = const_cast<char*>(rawData);
+	m_sizeOfSerializedData = dataSize;
+	m_ownsSerializedData = false;
+}
+
+void DataMailboxMessage::takeSerializedData(DataMailboxMessage& other)
+{
+	deleteSerializedData();
+
+	m_serialized = other.m_serialized;
+	m_sizeOfSerializedData = other.m_sizeOfSerializedData;
+	m_capacityOfSerializedData = other.m_capacityOfSerializedData;
+	m_ownsSerializedData = other.m_ownsSerializedData;
+
+	other.m_serialized = nullptr;
+	other.m_sizeOfSerializedData = 0;
+	other.m_capacityOfSerializedData = 0;
+	other.m_ownsSerializedData = true;
+}
+
+void DataMailboxMessage::checkSerializedData()
+{
+	if (m_serialized == nullptr)
+		Kernel::Fatal_Error("Cannot deserialize data from nullptr!");
+}
+
+void DataMailboxMessage::deleteSerializedData()
+{
+	if (m_serialized != nullptr && m_ownsSerializedData)
+		delete[] m_serialized;
+
+	m_serialized = nullptr;
+	m_sizeOfSerializedData = 0;
+	m_capacityOfSerializedData = 0;
+	m_ownsSerializedData = true;
+}
+
+void DataMailboxMessage::deleteAndReallocateSerializedData(size_t size)
+{
+	if (m_serialized != nullptr && m_ownsSerializedData && size <= m_capacityOfSerializedData)
+	{
+		m_sizeOfSerializedData = size;
+		return;
+	}
+
+	size_t inlineCapacity = 0;
+	char* pInlineBuffer = getInlineSerializedDataBuffer(inlineCapacity);
+
+	if (pInlineBuffer != nullptr && size <= inlineCapacity)
+	{
+		deleteSerializedData();
+		m_serialized = pInlineBuffer;
+		m_sizeOfSerializedData = size;
+		m_capacityOfSerializedData = (uint32_t)inlineCapacity;
+		m_ownsSerializedData = false;
+		return;
+	}
+
+	deleteSerializedData();
+	m_sizeOfSerializedData = size;
+	m_capacityOfSerializedData = (uint32_t)size;
+	m_serialized = new char[m_sizeOfSerializedData];
+}
+
+ExtendedDataMailboxMessage::ExtendedDataMailboxMessage(MessageDataType dataType)
+	:	DataMailboxMessage(dataType)
+{
+
+}
+
+void ExtendedDataMailboxMessage::Unpack(BasicDataMailboxMessage& message)
+{
+	takeSerializedData(message);
+
+	Deserialize();
+
+	m_source = message.getSource();
+
+	deleteSerializedData();
+}
+
+
+
+DataMailboxMessageFilter::DataMailboxMessageFilter(MessageDataType dataType, const std::string& source, std::function<bool(BasicDataMailboxMessage&)> predicate)
+	:	m_dataType(dataType), m_source(source), m_predicate(predicate)
+{
+
+}
+
+bool DataMailboxMessageFilter::matches(BasicDataMailboxMessage& message) const
+{
+	if (m_dataType != MessageDataType::NONE && message.getDataType() != m_dataType)
+		return false;
+
+	if (!m_source.empty() && message.getSource().getName() != m_source)
+		return false;
+
+	return !m_predicate || m_predicate(message);
+}
+
+DataMailbox::DataMailbox(const std::string name, ILogger* pLogger, const mq_attr& mailboxAttributes)
+	:	DataMailbox(std::unique_ptr<DataMailboxTransport>(new DataMailboxMqTransport(name, pLogger, mailboxAttributes)), pLogger)
+{
+
+}
+
+DataMailbox::DataMailbox(std::unique_ptr<DataMailboxTransport> pTransport, ILogger* pLogger)
+	: m_pTransport(std::move(pTransport)),
+	m_logging(pLogger != nullptr && pLogger != NulLogger::getInstance()),
+	m_pTracer(nullptr),
+	m_traceId(0),
+	m_stashSequence(0),
+	m_stashedCount(0),
+	m_conflatedCount(0),
+	m_unknownTypeCount(0),
+	m_checksums(false),
+	m_corruptedCount(0),
+	m_groupCommitSize(0),
+	m_durableTypes{ (unsigned char)MessageDataType::KeypadMessage_wPassword, (unsigned char)MessageDataType::RFIDMessage },
+	m_timers(std::chrono::milliseconds(1), m_pTransport->now()),
+	m_nextExpiredTimer(0)
+{
+	if (pLogger == nullptr)
+		pLogger = NulLogger::getInstance();
+
+	m_pLogger = pLogger;
+
+	// Sends and receives are queued as binary records, formatted later by the logger thread
+	m_pTracer = dynamic_cast<DataMailboxAsyncLogger*>(pLogger);
+
+	if (m_pTracer != nullptr)
+	{
+		m_traceId = m_pTracer->registerName(m_pTransport->getName());
+		m_logging = false;
+	}
+
+	log("DataMailbox opened: " + m_pTransport->getName());
+}
+
+DataMailbox::~DataMailbox()
+{
+	log("DataMailbox closed: " + m_pTransport->getName());
+}
+
+void DataMailbox::log(const std::string& line)
+{
+	// NulLogger and DataMailboxAsyncLogger are thread-safe, other loggers need not be
+	if (!m_logging)
+	{
+		*m_pLogger << line;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_logMutex);
+	*m_pLogger << line;
+}
+
+void DataMailbox::logMessage(DataMailboxMessage* message)
+{
+	if (!m_logging)
+		return;
+
+	char info[INFO_BUFFER_SIZE];
+	message->formatInfo(info, sizeof(info));
+
+	std::stringstream stringbuilder;
+
+	stringbuilder << "\n"
+		<< "==========================================" << "\n"
+		<< "Message: | " << info << "\n"
+		<< "==========================================";
+
+	log(stringbuilder.str());
+}
+
+/*
+void DataMailbox::clearMessageBuffer()
+{
+	if (m_receivedMessage != nullptr)
+	{
+		delete m_receivedMessage;
+		m_receivedMessage = nullptr;
+	}
+}*/
+
+void DataMailbox::send(MailboxReference& destination, DataMailboxMessage* message)
+{
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - sending message to - " + destination.getName());
+
+	logMessage(message);
+
+	size_t frameSize = 0;
+
+	// Capture needs the whole frame in one buffer
+	if (m_pCapture || !sendGathered(destination, message, frameSize))
+	{
+		// The serialized frame stays in the message, so sending it again reuses the buffer
+		char* frame = prepareFrame(message, frameSize);
+
+		m_pTransport->send(destination, frame, frameSize);
+
+		if (m_pCapture)
+			captureFrame(enuCaptureDirection::SENT, m_pTransport->getName(), destination.getName(), frame, frameSize);
+	}
+
+	if (m_pTracer)
+		m_pTracer->trace(m_traceId, enuTraceEvent::SENT, message->getDataType(), frameSize, destination.getName());
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - message successfully sent to - " + destination.getName());
+
+}
+
+void DataMailbox::sendConnectionless(MailboxReference& destination, DataMailboxMessage* message)
+{
+	if (m_logging)
+		log(m_pTransport->getName() + " - sending message to - " + destination.getName() + " - CONNECTIONLESS");
+
+	logMessage(message);
+
+	size_t frameSize = 0;
+	char* frame = prepareFrame(message, frameSize);
+
+	m_pTransport->sendConnectionless(destination, frame, frameSize);
+
+	if (m_pCapture)
+		captureFrame(enuCaptureDirection::SENT, m_pTransport->getName(), destination.getName(), frame, frameSize);
+
+	if (m_pTracer)
+		m_pTracer->trace(m_traceId, enuTraceEvent::SENT_CONNECTIONLESS, message->getDataType(), frameSize, destination.getName());
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - message successfully sent to - " + destination.getName());
+}
+
+void DataMailbox::sendBatch(MailboxReference& destination, const std::vector<DataMailboxMessage*>& messages)
+{
+	if (m_logging)
+		log(m_pTransport->getName() + " - sending " + std::to_string(messages.size()) + " messages to - " + destination.getName());
+
+	// Per thread, like the buffer of prepareFrame(). It is reused, so every frame is copied out before the next one is prepared.
+	thread_local std::vector<char> batchFrames;
+	thread_local std::vector<TransportBuffer> batchBuffers;
+
+	batchFrames.clear();
+	batchBuffers.clear();
+
+	for (DataMailboxMessage* message : messages)
+	{
+		logMessage(message);
+
+		size_t frameSize = 0;
+		char* frame = prepareFrame(message, frameSize);
+
+		batchFrames.insert(batchFrames.end(), frame, frame + frameSize);
+		batchBuffers.push_back(TransportBuffer{ nullptr, frameSize });
+	}
+
+	// Pointers are set once batchFrames does not grow any more
+	const char* pFrame = batchFrames.data();
+
+	for (TransportBuffer& buffer : batchBuffers)
+	{
+		buffer.m_pData = pFrame;
+		pFrame += buffer.m_size;
+	}
+
+	m_pTransport->sendBatch(destination, batchBuffers.data(), batchBuffers.size());
+
+	if (m_pCapture)
+	{
+		for (const TransportBuffer& buffer : batchBuffers)
+			captureFrame(enuCaptureDirection::SENT, m_pTransport->getName(), destination.getName(), buffer.m_pData, buffer.m_size);
+	}
+
+	if (m_pTracer)
+	{
+		for (size_t i = 0; i < messages.size(); i++)
+			m_pTracer->trace(m_traceId, enuTraceEvent::SENT_BATCH, messages[i]->getDataType(), batchBuffers[i].m_size, destination.getName());
+	}
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - messages successfully sent to - " + destination.getName());
+}
+
+void DataMailbox::enableOutbox(size_t capacity, enuOutboxOverflowPolicy overflowPolicy)
+{
+	m_pOutbox.reset(); // sends everything buffered with the old settings
+
+	m_pOutbox.reset(new DataMailboxOutbox([this](MailboxReference& destination, const char* frame, size_t size)
+	{
+		m_pTransport->send(destination, frame, size);
+
+		captureFrame(enuCaptureDirection::SENT, m_pTransport->getName(), destination.getName(), frame, size);
+	}, capacity, overflowPolicy, m_pLogger));
+
+	log(m_pTransport->getName() + " - outbox enabled, capacity: " + std::to_string(capacity));
+}
+
+enuOutboxStatus DataMailbox::sendNonBlocking(MailboxReference& destination, DataMailboxMessage* message)
+{
+	return bufferMessage(destination, message, "");
+}
+
+enuOutboxStatus DataMailbox::sendConflated(MailboxReference& destination, DataMailboxMessage* message, const std::string& key)
+{
+	// Keys of different message types never collide
+	return bufferMessage(destination, message, std::string(1, (char)message->getDataType()) + key);
+}
+
+enuOutboxStatus DataMailbox::bufferMessage(MailboxReference& destination, DataMailboxMessage* message, const std::string& conflationKey)
+{
+	if (!m_pOutbox)
+		enableOutbox(64);
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - buffering message to - " + destination.getName());
+
+	if (!m_destinationBacklogs.empty())
+	{
+		auto backlog = m_destinationBacklogs.find(destination.getName());
+
+		if (backlog != m_destinationBacklogs.end())
+		{
+			DataMailboxBacklogTracker& tracker = *backlog->second;
+
+			if (tracker.isSampleDue())
+				tracker.update(m_pOutbox->getStatistics(destination.getName()).m_queued);
+
+			if (tracker.shed(message->getDataType()))
+			{
+				if (m_logging)
+					log(m_pTransport->getName() + " - shed message to - " + destination.getName());
+
+				return enuOutboxStatus::SHED;
+			}
+		}
+	}
+
+	logMessage(message);
+
+	size_t frameSize = 0;
+	char* frame = prepareFrame(message, frameSize);
+
+	enuOutboxStatus status = m_pOutbox->enqueue(destination, std::string(frame, frameSize), conflationKey);
+
+	message->deleteSerializedData();
+
+	if (m_pTracer)
+		m_pTracer->trace(m_traceId, enuTraceEvent::QUEUED, message->getDataType(), frameSize, destination.getName());
+
+	if (m_logging && status != enuOutboxStatus::QUEUED && status != enuOutboxStatus::CONFLATED)
+		log(m_pTransport->getName() + " - outbox full for - " + destination.getName() + " - status: " + std::to_string((int)status));
+
+	return status;
+}
+
+void DataMailbox::setBacklogWatermarks(const BacklogWatermarks& watermarks)
+{
+	if (watermarks.m_high == 0)
+		m_pBacklog.reset();
+	else
+		m_pBacklog = createBacklogTracker(m_pTransport->getName(), watermarks);
+}
+
+void DataMailbox::setDestinationWatermarks(const MailboxReference& destination, const BacklogWatermarks& watermarks)
+{
+	if (watermarks.m_high == 0)
+		m_destinationBacklogs.erase(destination.getName());
+	else
+		m_destinationBacklogs[destination.getName()] = createBacklogTracker(destination.getName(), watermarks);
+}
+
+size_t DataMailbox::getBacklog()
+{
+	return (size_t)m_pTransport->getAttributes().mq_curmsgs + m_stashedCount;
+}
+
+BacklogStatistics DataMailbox::getBacklogStatistics() const
+{
+	if (!m_pBacklog)
+		return BacklogStatistics{};
+
+	return m_pBacklog->getStatistics();
+}
+
+BacklogStatistics DataMailbox::getBacklogStatistics(const MailboxReference& destination) const
+{
+	auto backlog = m_destinationBacklogs.find(destination.getName());
+
+	if (backlog == m_destinationBacklogs.end())
+		return BacklogStatistics{};
+
+	return backlog->second->getStatistics();
+}
+
+std::unique_ptr<DataMailboxBacklogTracker> DataMailbox::createBacklogTracker(const std::string& name, const BacklogWatermarks& watermarks)
+{
+	BacklogWatermarks logged = watermarks;
+
+	logged.m_callback = [this, watermarks](const std::string& queueName, enuBacklogState state, size_t backlog)
+	{
+		if (m_logging)
+			log(m_pTransport->getName() + " - backlog of - " + queueName + (state == enuBacklogState::HIGH ? " - over high watermark: " : " - back under low watermark: ")
+				+ std::to_string(backlog));
+
+		if (watermarks.m_callback)
+			watermarks.m_callback(queueName, state, backlog);
 	};
 
-	return names.at((int)dataType); // Potential indexOutOfBounds exception
+	return std::unique_ptr<DataMailboxBacklogTracker>(new DataMailboxBacklogTracker(name, logged));
+}
+
+bool DataMailbox::shedReceived(BasicDataMailboxMessage& message)
+{
+	if (m_pBacklog->isSampleDue())
+		m_pBacklog->update(getBacklog());
+
+	if (!m_pBacklog->shed(message.getDataType()))
+		return false;
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - shed message from - " + message.getSource().getName());
+
+	return true;
+}
+
+void DataMailbox::enableSizingAdvisor(const SizingOptions& options)
+{
+	m_pSizingAdvisor.reset(new DataMailboxSizingAdvisor(options));
+}
+
+void DataMailbox::disableSizingAdvisor()
+{
+	m_pSizingAdvisor.reset();
+}
+
+SizingRecommendation DataMailbox::getSizingRecommendation()
+{
+	if (!m_pSizingAdvisor)
+		return SizingRecommendation{};
+
+	return m_pSizingAdvisor->recommend(getMQAttributes());
+}
+
+SizingRecommendation DataMailbox::applySizingRecommendation()
+{
+	SizingRecommendation recommendation = getSizingRecommendation();
+
+	log(m_pTransport->getName() + " - sizing: " + recommendation.toString());
+
+	if (recommendation.m_valid)
+		setMQAttributes(recommendation.m_recommended);
+
+	return recommendation;
+}
+
+void DataMailbox::flushOutbox()
+{
+	if (m_pOutbox)
+		m_pOutbox->flush();
+}
+
+void DataMailbox::flushOutbox(const MailboxReference& destination)
+{
+	if (m_pOutbox)
+		m_pOutbox->flush(destination.getName());
+}
+
+OutboxStatistics DataMailbox::getOutboxStatistics(const MailboxReference& destination)
+{
+	if (!m_pOutbox)
+		return OutboxStatistics{};
+
+	return m_pOutbox->getStatistics(destination.getName());
+}
+
+OutboxStatistics DataMailbox::getOutboxStatistics()
+{
+	if (!m_pOutbox)
+		return OutboxStatistics{};
+
+	return m_pOutbox->getTotalStatistics();
+}
+
+void DataMailbox::enableCapture(const std::string& directory, size_t segmentSize)
+{
+	m_pCapture.reset(new DataMailboxCaptureWriter(directory, m_pTransport->getName(), segmentSize));
+
+	log(m_pTransport->getName() + " - capture enabled: " + directory);
+}
+
+void DataMailbox::disableCapture()
+{
+	m_pCapture.reset();
+}
+
+void DataMailbox::enableDurability(const std::string& directory, size_t groupCommitSize, size_t segmentSize)
+{
+	if (m_pJournal)
+	{
+		Kernel::Warning(m_pTransport->getName() + " - durability already enabled");
+		return;
+	}
+
+	m_pJournal.reset(new DataMailboxJournal(directory, m_pTransport->getName(), segmentSize));
+	m_groupCommitSize = groupCommitSize;
+
+	// Messages received but not acknowledged before the restart are received first
+	m_pJournal->forEachPending([this](DataMailboxJournal::Sequence sequence, const char* source, size_t sourceLength, const char* frame, size_t frameSize)
+	{
+		BasicDataMailboxMessage message;
+
+		char* pData = new char[frameSize];
+		memcpy(pData, frame, frameSize);
+
+		message.setSerializedData(pData, frameSize);
+		message.setSource(MailboxReference(std::string(source, sourceLength)));
+		message.m_deliveryId = sequence;
+
+		if (!message.decodeMessageDataType())
+		{
+			m_unknownTypeCount++;
+			m_pJournal->acknowledge(sequence);
+			return;
+		}
+
+		stashMessage(message);
+	});
+
+	log(m_pTransport->getName() + " - durability enabled: " + directory + ", unacknowledged messages: " + std::to_string(m_pJournal->getPendingCount()));
+}
+
+void DataMailbox::setDurable(MessageDataType dataType, bool durable)
+{
+	if (durable)
+		m_durableTypes.insert((unsigned char)dataType);
+	else
+		m_durableTypes.erase((unsigned char)dataType);
+}
+
+bool DataMailbox::acknowledge(const BasicDataMailboxMessage& message)
+{
+	if (!m_pJournal || message.getDeliveryId() == 0)
+		return false;
+
+	return m_pJournal->acknowledge(message.getDeliveryId());
+}
+
+size_t DataMailbox::getUnacknowledgedCount() const
+{
+	return m_pJournal ? m_pJournal->getPendingCount() : 0;
+}
+
+void DataMailbox::journalMessage(BasicDataMailboxMessage& message)
+{
+	if (m_durableTypes.count((unsigned char)message.getDataType()) == 0)
+		return;
+
+	message.m_deliveryId = m_pJournal->append(message.getSource().getName(), message.m_serialized, message.m_sizeOfSerializedData);
+}
+
+void DataMailbox::commitJournal(const BasicDataMailboxMessage& message)
+{
+	if (!m_pJournal || message.getDeliveryId() == 0 || m_groupCommitSize == 0 || m_pJournal->getUncommittedCount() == 0)
+		return;
+
+	// Group commit - messages already queued are journaled now, so one sync covers all of them
+	for (size_t grouped = m_pJournal->getUncommittedCount(); grouped < m_groupCommitSize; grouped++)
+	{
+		BasicDataMailboxMessage queued = receiveFromQueue(enuReceiveOptions::NONBLOCKING);
+
+		if (queued.getDataType() == MessageDataType::EmptyQueue)
+			break;
+
+		stashMessage(queued);
+	}
+
+	m_pJournal->commit();
 }
 
-DataMailboxMessage::DataMailboxMessage()
-	: m_dataType(MessageDataType::NONE),
-	m_serialized(nullptr),
-	m_sizeOfSerializedData(0)
+void DataMailbox::enableChecksums()
 {
+	m_checksums = true;
 
+	log(m_pTransport->getName() + " - checksums enabled: " + DataMailboxCRC32C::getImplementationName());
 }
 
-DataMailboxMessage::DataMailboxMessage(MessageDataType dataType)
-	: m_dataType(dataType),
-	m_serialized(nullptr),
-	m_sizeOfSerializedData(0)
+void DataMailbox::disableChecksums()
 {
-
+	m_checksums = false;
 }
 
-DataMailboxMessage::~DataMailboxMessage()
+char* DataMailbox::prepareFrame(DataMailboxMessage* message, size_t& size)
 {
-	deleteSerializedData();
+	message->Serialize();
+
+	size = message->m_sizeOfSerializedData;
+
+	if (!m_checksums || size == 0)
+		return message->m_serialized;
+
+	// Per thread, so several threads can send at once
+	thread_local std::vector<char> checksumFrame;
+
+	// [type | FRAME_CHECKSUM_FLAG][rest of the frame][CRC32C of everything before, little endian]
+	checksumFrame.resize(size + sizeof(uint32_t));
+
+	memcpy(checksumFrame.data(), message->m_serialized, size);
+	checksumFrame[0] = (char)((unsigned char)checksumFrame[0] | FRAME_CHECKSUM_FLAG);
+
+	uint32_t checksum = DataMailboxCRC32C::compute(checksumFrame.data(), size);
+
+	for (size_t i = 0; i < sizeof(checksum); i++)
+		checksumFrame[size + i] = (char)(checksum >> (8 * i));
+
+	size += sizeof(checksum);
+
+	return checksumFrame.data();
 }
 
-void DataMailboxMessage::DumpSerialData(const std::string filepath)
+bool DataMailbox::sendGathered(MailboxReference& destination, DataMailboxMessage* message, size_t& size)
 {
-	if (m_serialized == nullptr)
-	{
-		Kernel::Warning("Trying to dump message with no serialized data! ");
-		Serialize();
-	}
+	static_assert(GatherFrame::MAX_PARTS + 2 <= DataMailboxTransport::MAX_GATHER_PARTS, "header, parts and checksum must fit into one sendGather()");
 
-	std::ofstream dump(filepath + ".dump", std::ios::out | std::ios::binary);
-	if (!dump)
+	GatherFrame frame;
+
+	if (!message->describeFrame(frame) || frame.m_headerSize == 0)
+		return false;
+
+	// [header][parts...][CRC32C of everything before, little endian] - same bytes as prepareFrame()
+	TransportBuffer parts[GatherFrame::MAX_PARTS + 2];
+	size_t count = 0;
+
+	parts[count++] = TransportBuffer{ frame.m_header, frame.m_headerSize };
+
+	for (size_t i = 0; i < frame.m_partCount; i++)
+		parts[count++] = frame.m_parts[i];
+
+	char trailer[sizeof(uint32_t)];
+
+	if (m_checksums)
 	{
-		Kernel::Warning("Cannot dump message: " + getInfo());
-		return;
+		frame.m_header[0] = (char)((unsigned char)frame.m_header[0] | FRAME_CHECKSUM_FLAG);
+
+		uint32_t checksum = DataMailboxCRC32C::compute(frame.m_header, frame.m_headerSize);
+
+		for (size_t i = 0; i < frame.m_partCount; i++)
+			checksum = DataMailboxCRC32C::extend(checksum, frame.m_parts[i].m_pData, frame.m_parts[i].m_size);
+
+		for (size_t i = 0; i < sizeof(checksum); i++)
+			trailer[i] = (char)(checksum >> (8 * i));
+
+		parts[count++] = TransportBuffer{ trailer, sizeof(trailer) };
 	}
 
-	dump.write(m_serialized, m_sizeOfSerializedData);
+	m_pTransport->sendGather(destination, parts, count);
 
-	Kernel::Trace("Serial data dumped!");
+	size = 0;
 
-	// deleteSerializedData();
+	for (size_t i = 0; i < count; i++)
+		size += parts[i].m_size;
 
-	dump.close();
+	return true;
 }
 
-void DataMailboxMessage::decodeMessageDataType()
+bool DataMailbox::verifyChecksum(BasicDataMailboxMessage& message)
 {
+	if (message.m_serialized == nullptr || message.m_sizeOfSerializedData == 0)
+		return true;
 
-	if (m_serialized == nullptr)
-	{
-		Kernel::Fatal_Error("Cannot decode message datatype from null pointer!");
-	}
+	unsigned char& typeByte = reinterpret_cast<unsigned char&>(message.m_serialized[0]);
 
-	memcpy(&m_dataType, m_serialized, sizeof(MessageDataType));
+	if ((typeByte & FRAME_CHECKSUM_FLAG) == 0)
+		return true;
 
-	if ((int)m_dataType < 0 || (int)m_dataType >= (int)MessageDataType::COUNT)
-	{
-		Kernel::DumpRawData(m_serialized, m_sizeOfSerializedData, "invalid_message_datatype_pid_" + std::to_string( getpid() ) );
-		Kernel::Fatal_Error("Message has invalid datatype: " + std::to_string((int)m_dataType));
-	}
-		
+	if (message.m_sizeOfSerializedData < sizeof(MessageDataType) + sizeof(uint32_t))
+		return false;
+
+	size_t size = message.m_sizeOfSerializedData - sizeof(uint32_t);
+	const unsigned char* pTrailer = reinterpret_cast<const unsigned char*>(message.m_serialized + size);
+
+	uint32_t checksum = 0;
+	for (size_t i = 0; i < sizeof(checksum); i++)
+		checksum |= (uint32_t)pTrailer[i] << (8 * i);
+
+	if (DataMailboxCRC32C::compute(message.m_serialized, size) != checksum)
+		return false;
+
+	typeByte &= ~FRAME_CHECKSUM_FLAG;
+	message.m_sizeOfSerializedData = size;
+
+	return true;
 }
 
-void DataMailboxMessage::checkSerializedData()
+void DataMailbox::captureFrame(enuCaptureDirection direction, const std::string& source, const std::string& destination, const char* frame, size_t size)
 {
-	if (m_serialized == nullptr)
-		Kernel::Fatal_Error("Cannot deserialize data from nullptr!");
+	if (m_pCapture)
+		m_pCapture->append(direction, source, destination, frame, size);
 }
 
-void DataMailboxMessage::deleteSerializedData()
+struct timespec DataMailbox::setRTO_s(time_t RTOs)
 {
-	if (m_serialized != nullptr)
-	{
-		delete[] m_serialized;
-		m_serialized = nullptr;
-	}
-
-	m_sizeOfSerializedData = 0;
-		
+	timespec oldSettings = getTimeout_settings();
+	m_pTransport->setRTO_s(RTOs);
+	return oldSettings;
 }
 
-void DataMailboxMessage::deleteAndReallocateSerializedData(size_t size)
+struct timespec DataMailbox::setRTO_ns(long RTOns)
 {
+	timespec oldSettings = getTimeout_settings();
+	m_pTransport->setRTO_ns(RTOns);
+	return oldSettings;
+}
 
-	deleteSerializedData();
-	m_sizeOfSerializedData = size;
-	m_serialized = new char[m_sizeOfSerializedData];
+void DataMailbox::setTimeout_settings(struct timespec _timeout_settings)
+{
+	m_pTransport->setTimeout_settings(_timeout_settings);
 }
 
-ExtendedDataMailboxMessage::ExtendedDataMailboxMessage(MessageDataType dataType)
-	:	DataMailboxMessage(dataType)
+struct timespec DataMailbox::getTimeout_settings()
 {
+	return m_pTransport->getTimeout_settings();
+}
 
+mq_attr DataMailbox::getMQAttributes()
+{
+	return m_pTransport->getAttributes();
 }
 
-void ExtendedDataMailboxMessage::Unpack(BasicDataMailboxMessage& message)
+void DataMailbox::setMQAttributes(const mq_attr& message_queue_attributes)
 {
-	m_sizeOfSerializedData = message.getRawDataSize();
-	m_serialized = message.getRawDataPointer();
-	message.releaseRawDataOwnership();
+	m_pTransport->setAttributes(message_queue_attributes);
+}
 
-	Deserialize();
+BasicDataMailboxMessage DataMailbox::receive(enuReceiveOptions options)
+{
+	BasicDataMailboxMessage message = receiveUncommitted(options, getReceiveDeadline(options));
 
-	m_source = message.getSource();
+	commitJournal(message);
 
-	deleteSerializedData();
+	return message;
 }
 
+BasicDataMailboxMessage DataMailbox::receive(const struct timespec& timeout)
+{
+	BasicDataMailboxMessage message = receiveUncommitted(enuReceiveOptions::TIMED, getTime() + DataMailboxTime::fromTimespec(timeout));
+
+	commitJournal(message);
 
+	return message;
+}
 
-DataMailbox::DataMailbox(const std::string name, ILogger* pLogger, const mq_attr& mailboxAttributes)
-	: m_mailbox(name, pLogger, mailboxAttributes)
+BasicDataMailboxMessage DataMailbox::receiveMatching(const DataMailboxMessageFilter& filter, enuReceiveOptions options)
 {
-	if (pLogger == nullptr)
-		pLogger = NulLogger::getInstance();
+	BasicDataMailboxMessage message = receiveMatchingUncommitted(filter, options, getReceiveDeadline(options));
 
-	m_pLogger = pLogger;
+	commitJournal(message);
 
-	*m_pLogger << "DataMailbox opened: " + name;
+	return message;
 }
 
-DataMailbox::~DataMailbox()
+BasicDataMailboxMessage DataMailbox::receiveMatching(const DataMailboxMessageFilter& filter, const struct timespec& timeout)
 {
-	*m_pLogger << "DataMailbox closed: " + m_mailbox.getName();
+	BasicDataMailboxMessage message = receiveMatchingUncommitted(filter, enuReceiveOptions::TIMED, getTime() + DataMailboxTime::fromTimespec(timeout));
+
+	commitJournal(message);
+
+	return message;
 }
 
-/*
-void DataMailbox::clearMessageBuffer()
+DataMailboxTime::Clock::time_point DataMailbox::getReceiveDeadline(enuReceiveOptions options)
 {
-	if (m_receivedMessage != nullptr)
-	{
-		delete m_receivedMessage;
-		m_receivedMessage = nullptr;
-	}
-}*/
+	if (options % enuReceiveOptions::TIMED)
+		return getTime() + DataMailboxTime::fromTimespec(getTimeout_settings());
 
-void DataMailbox::send(MailboxReference& destination, DataMailboxMessage* message)
+	return DataMailboxTime::Clock::time_point::max();
+}
+
+BasicDataMailboxMessage DataMailbox::receiveUncommitted(enuReceiveOptions options, DataMailboxTime::Clock::time_point deadline)
 {
+	BasicDataMailboxMessage message;
 
-	*m_pLogger << m_mailbox.getName() + " - sending message to - " + destination.getName();
+	if (takeExpiredTimer(message))
+		return message;
 
-	std::stringstream stringbuilder;
+	if (!m_conflationKeyFunctions.empty())
+		drainQueueToStash();
 
-	stringbuilder << "\n"
-		<< "==========================================" << "\n"
-		<< "Message: | " << message->getInfo() << "\n"
-		<< "==========================================";
+	if (takeFromStash(DataMailboxMessageFilter{}, message))
+	{
+		if (m_logging)
+			log(m_pTransport->getName() + " - message taken from stash: " + getDataTypeName(message.getDataType()));
 
-	*m_pLogger << stringbuilder.str();
+		return message;
+	}
 
-	message->Serialize();
+	if (m_timers.getActiveCount() == 0 || (options % enuReceiveOptions::NONBLOCKING))
+		return receiveFromQueue(options, deadline);
 
-	m_mailbox.send(destination, message->m_serialized, message->m_sizeOfSerializedData);
+	// Wait no longer than the next timer, and no longer than the deadline (none unless timed)
+	while (true)
+	{
+		message = receiveFromQueueUntil(std::min(deadline, m_timers.getNextWakeup()));
 
-	message->deleteSerializedData();
+		if (message.getDataType() != MessageDataType::TimedOut)
+			return message;
 
-	*m_pLogger << m_mailbox.getName() + " - message successfully sent to - " + destination.getName();
+		if (takeExpiredTimer(message))
+			return message;
 
+		if (getTime() >= deadline)
+			return message;
+	}
 }
 
-void DataMailbox::sendConnectionless(MailboxReference& destination, DataMailboxMessage* message)
+BasicDataMailboxMessage DataMailbox::receiveMatchingUncommitted(const DataMailboxMessageFilter& filter, enuReceiveOptions options, DataMailboxTime::Clock::time_point deadline)
 {
-	*m_pLogger << m_mailbox.getName() + " - sending message to - " + destination.getName() + " - CONNECTIONLESS";
+	BasicDataMailboxMessage message;
 
-	std::stringstream stringbuilder;
+	if (takeFromStash(filter, message))
+		return message;
 
-	stringbuilder << "\n"
-		<< "==========================================" << "\n"
-		<< "Message: | " << message->getInfo() << "\n"
-		<< "==========================================";
+	const bool timed = options % enuReceiveOptions::TIMED;
 
-	*m_pLogger << stringbuilder.str();
+	while (true)
+	{
+		if (timed)
+			message = receiveFromQueueUntil(deadline);
+		else
+			message = receiveFromQueue(options);
 
-	message->Serialize();
+		if (message.getDataType() == MessageDataType::TimedOut || message.getDataType() == MessageDataType::EmptyQueue)
+			return message;
 
-	m_mailbox.sendConnectionless(destination, message->m_serialized, message->m_sizeOfSerializedData);
+		if (filter.matches(message))
+			return message;
 
-	message->deleteSerializedData();
+		stashMessage(message);
+	}
+}
 
-	*m_pLogger << m_mailbox.getName() + " - message successfully sent to - " + destination.getName();
+BasicDataMailboxMessage DataMailbox::receiveFromQueueUntil(DataMailboxTime::Clock::time_point deadline)
+{
+	DataMailboxTime::Clock::time_point now = getTime();
+
+	if (now >= deadline)
+		return BasicDataMailboxMessage(MessageDataType::TimedOut, MailboxReference{});
+
+	return receiveFromQueue(enuReceiveOptions::TIMED, deadline);
 }
 
-struct timespec DataMailbox::setRTO_s(time_t RTOs)
+DataMailboxTimerWheel::TimerId DataMailbox::scheduleTimer(const struct timespec& delay)
 {
-	timespec oldSettings = getTimeout_settings();
-	m_mailbox.setRTO_s(RTOs);
-	return oldSettings;
+	return m_timers.schedule(DataMailboxTime::fromTimespec(delay), getTime());
 }
 
-struct timespec DataMailbox::setRTO_ns(long RTOns)
+bool DataMailbox::cancelTimer(DataMailboxTimerWheel::TimerId timerId)
 {
-	timespec oldSettings = getTimeout_settings();
-	m_mailbox.setRTO_ns(RTOns);
-	return oldSettings;
+	return m_timers.cancel(timerId);
 }
 
-void DataMailbox::setTimeout_settings(struct timespec _timeout_settings)
+RealtimeReport DataMailbox::applyRealtimeSettings(const RealtimeSettings& settings)
 {
-	m_mailbox.setTimeout_settings(_timeout_settings);
+	m_timers.reserve(settings.m_timerCapacity);
+
+	RealtimeReport report = DataMailboxRealtime::applyToCurrentThread(settings);
+
+	log(m_pTransport->getName() + " - realtime settings: " + report.toString());
+
+	const std::pair<const char*, const RealtimeSettingResult*> results[] =
+	{
+		{ "CPU affinity", &report.m_affinity },
+		{ "SCHED_FIFO scheduling", &report.m_scheduling },
+		{ "memory locking", &report.m_memoryLock },
+		{ "prefaulting", &report.m_prefault }
+	};
+
+	for (const auto& result : results)
+	{
+		if (result.second->m_status == enuRealtimeStatus::FAILED)
+			Kernel::Warning(m_pTransport->getName() + " - " + result.first + " failed: " + result.second->m_detail);
+	}
+
+	return report;
 }
 
-struct timespec DataMailbox::getTimeout_settings()
+bool DataMailbox::takeExpiredTimer(BasicDataMailboxMessage& message)
 {
-	return m_mailbox.getTimeout_settings();
+	if (m_nextExpiredTimer == m_expiredTimers.size())
+	{
+		m_expiredTimers.clear();
+		m_nextExpiredTimer = 0;
+
+		if (m_timers.getActiveCount() == 0)
+			return false;
+
+		m_timers.advance(getTime(), m_expiredTimers);
+
+		if (m_expiredTimers.empty())
+			return false;
+	}
+
+	DataMailboxTimerWheel::TimerId timerId = m_expiredTimers[m_nextExpiredTimer++];
+
+	message = BasicDataMailboxMessage(MessageDataType::TimedOut, MailboxReference(m_pTransport->getName()));
+	message.setStaticSerializedData(TIMED_OUT_FRAME, sizeof(TIMED_OUT_FRAME)); // Emulate received message with datatype code = TimedOut
+	message.m_timerId = timerId;
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - timer expired: " + std::to_string(timerId));
+
+	return true;
 }
 
-mq_attr DataMailbox::getMQAttributes()
+void DataMailbox::enableConflation(MessageDataType dataType, ConflationKeyFunction keyFunction)
 {
-	return m_mailbox.getMQAttributes();
+	m_conflationKeyFunctions[(unsigned char)dataType] = keyFunction;
 }
 
-void DataMailbox::setMQAttributes(const mq_attr& message_queue_attributes)
+void DataMailbox::disableConflation(MessageDataType dataType)
 {
-	m_mailbox.setMQAttributes(message_queue_attributes);
+	m_conflationKeyFunctions.erase((unsigned char)dataType);
 }
 
-BasicDataMailboxMessage DataMailbox::receive(enuReceiveOptions options)
+void DataMailbox::drainQueueToStash()
 {
+	// Bounded by the depth at the start, so fast senders cannot keep the receiver draining forever
+	long queued = getMQAttributes().mq_curmsgs;
 
-	*m_pLogger << m_mailbox.getName() + " - waiting for message!";
+	for (long i = 0; i < queued; i++)
+	{
+		BasicDataMailboxMessage message = receiveFromQueue(enuReceiveOptions::NONBLOCKING);
+
+		if (message.getDataType() == MessageDataType::EmptyQueue)
+			break;
+
+		stashMessage(message);
+	}
+}
+
+void DataMailbox::stashMessage(BasicDataMailboxMessage& message)
+{
+	unsigned char dataType = (unsigned char)message.getDataType();
+	std::string conflationKey;
 
-	SimpleMailboxMessage rawMessage = m_mailbox.receive(options);
+	auto keyFunction = m_conflationKeyFunctions.find(dataType);
 
-	//Kernel::DumpRawData(rawMessage.m_pData, rawMessage.m_header.m_payloadSize, "dump_rec_trace_1_" + Time::getTime());
+	if (keyFunction != m_conflationKeyFunctions.end())
+	{
+		conflationKey = keyFunction->second(message);
 
-	BasicDataMailboxMessage receivedMessage;
+		if (!conflationKey.empty())
+			conflationKey.insert(conflationKey.begin(), (char)dataType);
+	}
 
-	if (rawMessage.m_header.m_type == enuMessageType::TIMED_OUT) // TODO change enum name
+	if (!conflationKey.empty())
 	{
-		// std::cout << "TIMEDOUT" << std::endl;
-		char* pData = new char[1]{ (char)MessageDataType::TimedOut }; // Emulate received message with datatype code = TimedOut
-		receivedMessage.setSerializedData(pData, 1);
+		auto stashed = m_conflationIndex.find(conflationKey);
+
+		if (stashed != m_conflationIndex.end())
+		{
+			std::deque<StashedMessage>& list = m_stash[dataType];
+
+			auto older = std::lower_bound(list.begin(), list.end(), stashed->second,
+				[](const StashedMessage& entry, unsigned long long sequence) { return entry.m_sequence < sequence; });
+
+			// The replaced message will never be handled
+			if (m_pJournal && older->m_message.getDeliveryId() != 0)
+				m_pJournal->acknowledge(older->m_message.getDeliveryId());
+
+			older->m_message = std::move(message);
+			m_conflatedCount++;
+
+			if (m_logging)
+				log(m_pTransport->getName() + " - message conflated: " + getDataTypeName(older->m_message.getDataType()));
+
+			return;
+		}
+
+		m_conflationIndex[conflationKey] = m_stashSequence;
 	}
-	else if (rawMessage.m_header.m_type == enuMessageType::EMPTY && (options % enuReceiveOptions::NONBLOCKING))
+
+	if (m_logging)
+		log(m_pTransport->getName() + " - message stashed: " + getDataTypeName(message.getDataType()));
+
+	m_stash[dataType].push_back(StashedMessage{ m_stashSequence++, std::move(message), conflationKey });
+	m_stashedCount++;
+}
+
+bool DataMailbox::takeFromStash(const DataMailboxMessageFilter& filter, BasicDataMailboxMessage& message)
+{
+	if (m_stashedCount == 0)
+		return false;
+
+	std::deque<StashedMessage>* pBestList = nullptr;
+	std::deque<StashedMessage>::iterator best;
+
+	auto findInList = [&](std::deque<StashedMessage>& list)
+	{
+		for (auto stashed = list.begin(); stashed != list.end(); ++stashed)
+		{
+			if (!filter.matches(stashed->m_message))
+				continue;
+
+			if (pBestList == nullptr || stashed->m_sequence < best->m_sequence)
+			{
+				pBestList = &list;
+				best = stashed;
+			}
+
+			return; // lists are ordered by sequence
+		}
+	};
+
+	if (filter.m_dataType != MessageDataType::NONE)
 	{
-		// std::cout << "NONBLOCKING_EMPTY" << std::endl;
-		char* pData = new char[1]{ (char)MessageDataType::EmptyQueue }; // Emulate received message with datatype code = EmptyQueue
-		receivedMessage.setSerializedData(pData, 1);
+		auto list = m_stash.find((unsigned char)filter.m_dataType);
+
+		if (list != m_stash.end())
+			findInList(list->second);
 	}
 	else
 	{
-		// std::cout << "~TIMEDOUT" << std::endl;
-		receivedMessage.setSerializedData(rawMessage.m_pData, rawMessage.m_header.m_payloadSize);
-		receivedMessage.setSource(MailboxReference(rawMessage.m_sourceName));
+		for (auto& list : m_stash)
+			findInList(list.second);
 	}
 
-	receivedMessage.decodeMessageDataType();
-	
+	if (pBestList == nullptr)
+		return false;
 
-	*m_pLogger << m_mailbox.getName() + " - message successfully received";
+	message = std::move(best->m_message);
 
-	std::stringstream stringbuilder;
+	if (!best->m_conflationKey.empty())
+		m_conflationIndex.erase(best->m_conflationKey);
 
-	stringbuilder << "\n"
-		<< "==========================================" << "\n"
-		<< "Message: | " << receivedMessage.getInfo() << "\n"
-		<< "==========================================";
+	pBestList->erase(best);
+	m_stashedCount--;
 
-	*m_pLogger << stringbuilder.str();
+	if (pBestList->empty())
+		m_stash.erase((unsigned char)message.getDataType());
 
-	return receivedMessage;
+	return true;
+}
+
+BasicDataMailboxMessage DataMailbox::receiveFromQueue(enuReceiveOptions options, DataMailboxTime::Clock::time_point deadline)
+{
+	while (true)
+	{
+		if (m_logging)
+			log(m_pTransport->getName() + " - waiting for message!");
+
+		TransportFrame rawMessage;
+
+		if (options % enuReceiveOptions::TIMED)
+		{
+			// Frames dropped below do not extend the wait
+			DataMailboxTime::Clock::time_point now = getTime();
+			rawMessage = m_pTransport->receiveFor(DataMailboxTime::toTimespec(now < deadline ? deadline - now : DataMailboxTime::Clock::duration::zero()));
+		}
+		else
+			rawMessage = m_pTransport->receive(options);
+
+		//Kernel::DumpRawData(rawMessage.m_pData, rawMessage.m_size, "dump_rec_trace_1_" + Time::getTime());
+
+		BasicDataMailboxMessage receivedMessage;
+
+		if (rawMessage.m_type == enuMessageType::TIMED_OUT) // TODO change enum name
+		{
+			// std::cout << "TIMEDOUT" << std::endl;
+			receivedMessage.setStaticSerializedData(TIMED_OUT_FRAME, sizeof(TIMED_OUT_FRAME)); // Emulate received message with datatype code = TimedOut
+
+			// Nothing is queued, so the backlog is only the stash
+			if (m_pBacklog)
+				m_pBacklog->update(m_stashedCount);
+		}
+		else if (rawMessage.m_type == enuMessageType::EMPTY && (options % enuReceiveOptions::NONBLOCKING))
+		{
+			// std::cout << "NONBLOCKING_EMPTY" << std::endl;
+			receivedMessage.setStaticSerializedData(EMPTY_QUEUE_FRAME, sizeof(EMPTY_QUEUE_FRAME)); // Emulate received message with datatype code = EmptyQueue
+
+			if (m_pBacklog)
+				m_pBacklog->update(m_stashedCount);
+		}
+		else
+		{
+			// std::cout << "~TIMEDOUT" << std::endl;
+			receivedMessage.setSerializedData(rawMessage.m_pData, rawMessage.m_size);
+			receivedMessage.setSource(MailboxReference(rawMessage.m_source));
+
+			if (m_pCapture)
+				captureFrame(enuCaptureDirection::RECEIVED, rawMessage.m_source, m_pTransport->getName(), rawMessage.m_pData, rawMessage.m_size);
+
+			if (!verifyChecksum(receivedMessage))
+			{
+				m_corruptedCount++;
+				Kernel::Warning(m_pTransport->getName() + " - dropped corrupted message from - " + rawMessage.m_source);
+				continue;
+			}
+
+			if (m_pSizingAdvisor)
+			{
+				m_pSizingAdvisor->recordFrame(rawMessage.m_size + m_pTransport->getFrameOverhead(rawMessage));
+
+				// Depth before this receive, the frame just taken was waiting too. Senders may have refilled the queue since.
+				if (m_pSizingAdvisor->isDepthSampleDue())
+				{
+					mq_attr attributes = m_pTransport->getAttributes();
+					long depth = attributes.mq_curmsgs + 1;
+
+					m_pSizingAdvisor->recordDepth(attributes.mq_maxmsg > 0 ? std::min(depth, attributes.mq_maxmsg) : depth);
+				}
+			}
+		}
+
+		// A frame of a type this process does not know is dropped (reported by decodeMessageDataType()), the receive goes on with the next one
+		if (!receivedMessage.decodeMessageDataType())
+		{
+			m_unknownTypeCount++;
+			continue;
+		}
+
+		// Shed before journaling, a dropped durable message is never delivered
+		if (m_pBacklog && rawMessage.m_type == enuMessageType::DATA && shedReceived(receivedMessage))
+			continue;
+
+		if (m_pJournal)
+			journalMessage(receivedMessage);
+
+		if (m_pTracer && rawMessage.m_type == enuMessageType::DATA)
+			m_pTracer->trace(m_traceId, enuTraceEvent::RECEIVED, receivedMessage.getDataType(), rawMessage.m_size, rawMessage.m_source);
+
+		if (m_logging)
+			log(m_pTransport->getName() + " - message successfully received");
+
+		logMessage(&receivedMessage);
+
+		return receivedMessage;
+	}
 }
 
 BasicDataMailboxMessage::BasicDataMailboxMessage()
@@ -298,6 +1361,31 @@ BasicDataMailboxMessage::BasicDataMailboxMessage(MessageDataType dataType, const
 	setSource(source);
 }
 
+BasicDataMailboxMessage::BasicDataMailboxMessage(BasicDataMailboxMessage&& other)
+	:	DataMailboxMessage(other.m_dataType)
+{
+	*this = std::move(other);
+}
+
+BasicDataMailboxMessage& BasicDataMailboxMessage::operator=(BasicDataMailboxMessage&& other)
+{
+	if (this == &other)
+		return *this;
+
+	takeSerializedData(other);
+
+	m_dataType = other.m_dataType;
+	m_source = other.m_source;
+
+	m_deliveryId = other.m_deliveryId;
+	other.m_deliveryId = 0;
+
+	m_timerId = other.m_timerId;
+	other.m_timerId = 0;
+
+	return *this;
+}
+
 void BasicDataMailboxMessage::Serialize()
 {
 	deleteAndReallocateSerializedData(sizeof(MessageDataType));
@@ -326,6 +1414,8 @@ void BasicDataMailboxMessage::releaseRawDataOwnership()
 {
 	m_serialized = 0;
 	m_sizeOfSerializedData = 0;
+	m_capacityOfSerializedData = 0;
+	m_ownsSerializedData = true;
 }
 
 /*
@@ -340,14 +1430,20 @@ std::string BasicDataMailboxMessage::getInfo()
 	return "BasicDataMailboxMessage - MessageDataType: " + std::to_string((int)m_dataType) + " from: " + m_source.getName();
 }
 
+size_t BasicDataMailboxMessage::formatInfo(char* buffer, size_t size)
+{
+	// Source name is left out, getName() returns a copy
+	return writtenInfoLength(snprintf(buffer, size, "BasicDataMailboxMessage - MessageDataType: %d (%s)", (int)m_dataType, getDataTypeNameCStr(m_dataType)), size);
+}
+
 KeypadMessage_wPassword::KeypadMessage_wPassword()
-	:	m_password(""), ExtendedDataMailboxMessage(MessageDataType::KeypadMessage_wPassword)
+	:	InlineDataMailboxMessage(MessageDataType::KeypadMessage_wPassword), m_password()
 {
 
 }
 
-KeypadMessage_wPassword::KeypadMessage_wPassword(const std::string& password)
-	:	m_password(password), ExtendedDataMailboxMessage(MessageDataType::KeypadMessage_wPassword)
+KeypadMessage_wPassword::KeypadMessage_wPassword(const Password& password)
+	:	InlineDataMailboxMessage(MessageDataType::KeypadMessage_wPassword), m_password(password)
 {
 
 }
@@ -382,7 +1478,7 @@ void KeypadMessage_wPassword::Serialize()
 	deleteAndReallocateSerializedData(sizeOfSerializedData);
 
 	memcpy(m_serialized, &m_dataType, sizeof(MessageDataType));
-	memcpy(m_serialized + passwordOffset, m_password.c_str(), passwordLength);
+	memcpy(m_serialized + passwordOffset, m_password.data(), passwordLength);
 }
 
 void KeypadMessage_wPassword::Deserialize()
@@ -405,13 +1501,18 @@ void KeypadMessage_wPassword::Deserialize()
 	size_t passwordLength = m_sizeOfSerializedData - passwordOffset;
 
 	memcpy(&m_dataType, m_serialized, sizeof(MessageDataType));
-	m_password = std::string(m_serialized + passwordOffset, passwordLength);
+	m_password.assign(m_serialized + passwordOffset, passwordLength);
 
 }
 
 std::string KeypadMessage_wPassword::getInfo()
 {
-	return "KeypadMessage_wPassword - Password: " + m_password;
+	return "KeypadMessage_wPassword - Password: " + m_password.str();
+}
+
+size_t KeypadMessage_wPassword::formatInfo(char* buffer, size_t size)
+{
+	return writtenInfoLength(snprintf(buffer, size, "KeypadMessage_wPassword - Password: %.*s", (int)m_password.length(), m_password.data()), size);
 }
 
 KeypadMessage_wCommand::KeypadMessage_wCommand()
@@ -463,14 +1564,19 @@ std::string KeypadMessage_wCommand::getInfo()
 	return "KeypadMessage_wCommand - CommandId: " + std::to_string((int)m_command);
 }
 
+size_t KeypadMessage_wCommand::formatInfo(char* buffer, size_t size)
+{
+	return writtenInfoLength(snprintf(buffer, size, "KeypadMessage_wCommand - CommandId: %d", (int)m_command), size);
+}
+
 RFIDMessage::RFIDMessage()
-	:	m_uuid(""), ExtendedDataMailboxMessage(MessageDataType::RFIDMessage)
+	:	InlineDataMailboxMessage(MessageDataType::RFIDMessage), m_uuid()
 {
 
 }
 
-RFIDMessage::RFIDMessage(const std::string& uuid)
-	: m_uuid(uuid), ExtendedDataMailboxMessage(MessageDataType::RFIDMessage)
+RFIDMessage::RFIDMessage(const UUID& uuid)
+	:	InlineDataMailboxMessage(MessageDataType::RFIDMessage), m_uuid(uuid)
 {
 
 }
@@ -485,7 +1591,7 @@ void RFIDMessage::Serialize()
 	deleteAndReallocateSerializedData(sizeOfSerializedData);
 
 	memcpy(reinterpret_cast<void*>(m_serialized), reinterpret_cast<const void*>(&m_dataType), sizeof(MessageDataType));
-	memcpy(reinterpret_cast<void*>(m_serialized + uuidOffset), reinterpret_cast<const void*>(m_uuid.c_str()), uuidLength);
+	memcpy(reinterpret_cast<void*>(m_serialized + uuidOffset), reinterpret_cast<const void*>(m_uuid.data()), uuidLength);
 }
 
 void RFIDMessage::Deserialize()
@@ -496,12 +1602,17 @@ void RFIDMessage::Deserialize()
 
 	int uuidLength = m_sizeOfSerializedData - uuidOffset;
 
-	m_uuid = std::string(m_serialized + uuidOffset, uuidLength);
+	m_uuid.assign(m_serialized + uuidOffset, uuidLength);
 }
 
 std::string RFIDMessage::getInfo()
 {
-	return "RFIDMessage - UUID: " + m_uuid;
+	return "RFIDMessage - UUID: " + m_uuid.str();
+}
+
+size_t RFIDMessage::formatInfo(char* buffer, size_t size)
+{
+	return writtenInfoLength(snprintf(buffer, size, "RFIDMessage - UUID: %.*s", (int)m_uuid.length(), m_uuid.data()), size);
 }
 
 StringMessage::StringMessage()
@@ -529,6 +1640,12 @@ void StringMessage::Serialize()
 	memcpy(reinterpret_cast<void*>(m_serialized + messageOffset), reinterpret_cast<const void*>(m_message.c_str()), messageLength);
 }
 
+bool StringMessage::describeFrame(GatherFrame& frame)
+{
+	return frame.appendHeader(&m_dataType, sizeof(MessageDataType))
+		&& frame.appendPart(m_message.data(), m_message.length());
+}
+
 void StringMessage::Deserialize()
 {
 	checkSerializedData();
@@ -541,33 +1658,38 @@ std::string StringMessage::getInfo()
 	return "StringMessage - message: " + m_message;
 }
 
+size_t StringMessage::formatInfo(char* buffer, size_t size)
+{
+	return writtenInfoLength(snprintf(buffer, size, "StringMessage - message: %.*s", (int)m_message.length(), m_message.data()), size);
+}
+
 
 
 WatchdogMessage::WatchdogMessage()
-	:	ExtendedDataMailboxMessage(MessageDataType::WatchdogMessage),
-	m_name(""), m_messageClass(MessageClass::NONE), m_settings(), m_PID(0), m_onFailure(enuActionOnFailure::RESET_ONLY)
+	:	InlineDataMailboxMessage(MessageDataType::WatchdogMessage),
+	m_name(),m_messageClass(MessageClass::NONE), m_settings(), m_PID(0), m_onFailure(enuActionOnFailure::RESET_ONLY)
 {
 
 }
 
-WatchdogMessage::WatchdogMessage(const std::string& name, const SlotSettings& settings, unsigned int PID, enuActionOnFailure onFailure, MessageClass type)
-	: ExtendedDataMailboxMessage(MessageDataType::WatchdogMessage),
-	m_name(name), m_settings(settings), m_messageClass(type), m_PID(PID), m_onFailure(onFailure)
+WatchdogMessage::WatchdogMessage(const SlotName& name, const SlotSettings& settings, unsigned int PID, enuActionOnFailure onFailure, MessageClass type)
+	: InlineDataMailboxMessage(MessageDataType::WatchdogMessage),
+	m_name(name),m_settings(settings), m_messageClass(type), m_PID(PID), m_onFailure(onFailure)
 {
 
 }
 
-WatchdogMessage::WatchdogMessage(const std::string& name,
+WatchdogMessage::WatchdogMessage(const SlotName& name,
 	MessageClass type)
-	: ExtendedDataMailboxMessage(MessageDataType::WatchdogMessage),
-	m_name(name), m_messageClass(type), m_settings(), m_PID(0), m_onFailure(enuActionOnFailure::RESET_ONLY)
+	: InlineDataMailboxMessage(MessageDataType::WatchdogMessage),
+	m_name(name),m_messageClass(type), m_settings(), m_PID(0), m_onFailure(enuActionOnFailure::RESET_ONLY)
 {
 
 }
 
 WatchdogMessage::WatchdogMessage(MessageClass type)
-	:	ExtendedDataMailboxMessage(MessageDataType::WatchdogMessage),
-	m_name(""), m_messageClass(MessageClass::NONE), m_settings(), m_PID(0), m_onFailure(enuActionOnFailure::RESET_ONLY)
+	:	InlineDataMailboxMessage(MessageDataType::WatchdogMessage),
+	m_name(),m_messageClass(MessageClass::NONE), m_settings(), m_PID(0), m_onFailure(enuActionOnFailure::RESET_ONLY)
 {
 
 }
@@ -589,7 +1711,7 @@ void WatchdogMessage::Serialize()
 	memcpy(m_serialized + settingsOffset, &m_settings, sizeof(m_settings));
 	memcpy(m_serialized + PID_Offset, &m_PID, sizeof(m_PID));
 	memcpy(m_serialized + actionOnFailureOffset, &m_onFailure, sizeof(m_onFailure));
-	memcpy(m_serialized + nameOffset, m_name.c_str(), m_name.length());
+	memcpy(m_serialized + nameOffset, m_name.data(), m_name.length());
 }
 
 void WatchdogMessage::Deserialize()
@@ -609,33 +1731,82 @@ void WatchdogMessage::Deserialize()
 	memcpy(&m_PID, m_serialized + PID_Offset, sizeof(m_PID));
 	memcpy(&m_onFailure, m_serialized + actionOnFailureOffset, sizeof(m_onFailure));
 
-	m_name = std::string(m_serialized + nameOffset, m_sizeOfSerializedData - nameOffset);
+	m_name.assign(m_serialized + nameOffset, m_sizeOfSerializedData - nameOffset);
 
 }
 
 std::string WatchdogMessage::getInfo()
 {
-	std::array<std::string, 2> onFailureActionNamesList = { "RESET_ONLY", "KILL_ALL" };
+	char info[DataMailbox::INFO_BUFFER_SIZE];
+	size_t length = formatInfo(info, sizeof(info));
+
+	return std::string(info, length);
+}
+
+size_t WatchdogMessage::formatInfo(char* buffer, size_t size)
+{
+	static constexpr const char* onFailureActionNames[] = { "RESET_ONLY", "KILL_ALL" };
+
+	const char* onFailureActionName = (size_t)m_onFailure < sizeof(onFailureActionNames) / sizeof(onFailureActionNames[0])
+		? onFailureActionNames[(size_t)m_onFailure] : "INVALID";
+
+	return writtenInfoLength(snprintf(buffer, size, "\n"
+		"WatchdogSlotRequestMessage - from: %.*s\n"
+		"\tPID:%u\n"
+		"\tType: %s\n"
+		"\tOn faliure: %s\n"
+		"\tSettings:\n"
+		"\t\tBaseTTL: %lld\n"
+		"\t\tTimeout: %lld ms\n",
+		(int)m_name.length(), m_name.data(), (unsigned int)m_PID, getMessageClassNameCStr(m_messageClass), onFailureActionName,
+		(long long)m_settings.m_BaseTTL, (long long)m_settings.m_timeout_ms), size);
+}
+
+DataMailboxMessageFilter WatchdogMessage::getFilter(MessageClass messageClass)
+{
+	if (messageClass == MessageClass::ANY)
+		return DataMailboxMessageFilter(MessageDataType::WatchdogMessage);
+
+	return DataMailboxMessageFilter(MessageDataType::WatchdogMessage, "", [messageClass](BasicDataMailboxMessage& message)
+	{
+		size_t messageClassOffset = sizeof(MessageDataType);
+
+		if (message.getRawDataSize() < (int)(messageClassOffset + sizeof(MessageClass)))
+			return false;
+
+		MessageClass receivedClass;
+		memcpy(&receivedClass, message.getRawDataPointer() + messageClassOffset, sizeof(MessageClass));
+
+		return receivedClass == messageClass;
+	});
+}
+
+std::string WatchdogMessage::getConflationKey(BasicDataMailboxMessage& message)
+{
+	size_t messageClassOffset = sizeof(MessageDataType);
+	size_t nameOffset = messageClassOffset + sizeof(m_messageClass) + sizeof(m_settings) + sizeof(m_PID) + sizeof(m_onFailure);
 
-	std::stringstream stringBuilder;
+	if (message.getDataType() != MessageDataType::WatchdogMessage || message.getRawDataSize() < (int)nameOffset)
+		return "";
 
-	// std::cout << "m_onFailure" << (int)m_onFailure << std::endl;
+	// Reads the class directly instead of through getFilter(), which would build a std::function on every call
+	MessageClass receivedClass;
+	memcpy(&receivedClass, message.getRawDataPointer() + messageClassOffset, sizeof(MessageClass));
 
-	stringBuilder << "\n"
-		<< "WatchdogSlotRequestMessage - from: " << m_name << "\n"
-		<< "\tPID:" << m_PID << "\n"
-		<< "\tType: " << getMessageClassName(m_messageClass) << "\n"
-		<< "\tOn faliure: " << onFailureActionNamesList.at((int)m_onFailure) << "\n"
-		<< "\tSettings:" << "\n"
-		<< "\t\tBaseTTL: " << m_settings.m_BaseTTL << "\n"
-		<< "\t\tTimeout: " << m_settings.m_timeout_ms << " ms" << "\n";
+	if (receivedClass != UPDATE_SETTINGS)
+		return "";
 
-	return stringBuilder.str();
+	return std::string(message.getRawDataPointer() + nameOffset, message.getRawDataSize() - nameOffset);
 }
 
 std::string WatchdogMessage::getMessageClassName(MessageClass messageClass)
 {
-	std::array<std::string, 14> m_messageClassNames =
+	return getMessageClassNameCStr(messageClass);
+}
+
+const char* WatchdogMessage::getMessageClassNameCStr(MessageClass messageClass)
+{
+	static constexpr const char* messageClassNames[] =
 	{
 		"REGISTER_REQUEST",
 		"REGISTER_REPLY",
@@ -653,5 +1824,8 @@ std::string WatchdogMessage::getMessageClassName(MessageClass messageClass)
 		"NONE"
 	};
 
-	return m_messageClassNames.at((int)messageClass);
+	if ((int)messageClass < 0 || (size_t)messageClass >= sizeof(messageClassNames) / sizeof(messageClassNames[0]))
+		return "INVALID";
+
+	return messageClassNames[(int)messageClass];
 }
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "DataMailboxAsyncLogger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+const size_t TraceRecord::TEXT_CAPACITY;
+const size_t DataMailboxAsyncLogger::DEFAULT_RING_CAPACITY;
+const int DataMailboxAsyncLogger::IDLE_WAIT_MS;
+
+static const char* const TRACE_EVENT_NAMES[] =
+{
+	"text",
+	"sent",
+	"sent connectionless",
+	"sent in batch",
+	"queued",
+	"received"
+};
+
+static std::atomic<unsigned long long> g_nextLoggerId(1);
+
+static uint64_t getTimestamp()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(DataMailboxTime::Clock::now().time_since_epoch()).count();
+}
+
+/// Smallest power of two not less than `value` (at least 2)
+static size_t roundUpToPowerOfTwo(size_t value)
+{
+	size_t result = 2;
+
+	while (result < value)
+		result *= 2;
+
+	return result;
+}
+
+DataMailboxAsyncLogger::Ring::Ring(size_t capacity)
+	:	m_records(capacity), m_mask(capacity - 1), m_head(0), m_tail(0), m_dropped(0)
+{
+
+}
+
+DataMailboxAsyncLogger::DataMailboxAsyncLogger(ILogger* pTarget, size_t ringCapacity)
+	:	m_pTarget(pTarget), m_ringCapacity(roundUpToPowerOfTwo(ringCapacity)), m_id(g_nextLoggerId++),
+	m_passCount(0), m_stopping(false), m_writtenCount(0), m_start(DataMailboxTime::Clock::now())
+{
+	if (m_pTarget == nullptr)
+		m_pTarget = NulLogger::getInstance();
+
+	m_writer = std::thread(&DataMailboxAsyncLogger::writerLoop, this);
+}
+
+DataMailboxAsyncLogger::~DataMailboxAsyncLogger()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_writerMutex);
+		m_stopping = true;
+	}
+
+	m_wake.notify_one();
+	m_writer.join();
+}
+
+void DataMailboxAsyncLogger::operator<<(const std::string& message)
+{
+	Ring& ring = getRing();
+
+	size_t length = message.length();
+	size_t count = std::max<size_t>(1, (length + TraceRecord::TEXT_CAPACITY - 1) / TraceRecord::TEXT_CAPACITY);
+	size_t index;
+
+	if (!reserve(ring, count, index))
+		return;
+
+	uint64_t timestamp = getTimestamp();
+
+	// Every chunk carries the timestamp and length of the whole line, so the writer can put it back together
+	for (size_t i = 0; i < count; i++)
+	{
+		TraceRecord& record = ring.m_records[(index + i) & ring.m_mask];
+		size_t offset = i * TraceRecord::TEXT_CAPACITY;
+
+		record.m_timestamp = timestamp;
+		record.m_size = (uint32_t)length;
+		record.m_mailboxId = 0;
+		record.m_event = enuTraceEvent::TEXT;
+		record.m_dataType = MessageDataType::NONE;
+
+		memcpy(record.m_text, message.data() + offset, std::min(TraceRecord::TEXT_CAPACITY, length - offset));
+	}
+
+	publish(ring, index, count);
+}
+
+uint16_t DataMailboxAsyncLogger::registerName(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_namesMutex);
+
+	auto existing = std::find(m_names.begin(), m_names.end(), name);
+	if (existing != m_names.end())
+		return (uint16_t)(existing - m_names.begin());
+
+	m_names.push_back(name);
+
+	return (uint16_t)(m_names.size() - 1);
+}
+
+void DataMailboxAsyncLogger::trace(uint16_t mailboxId, enuTraceEvent event, MessageDataType dataType, size_t size, const std::string& peer)
+{
+	Ring& ring = getRing();
+	size_t index;
+
+	if (!reserve(ring, 1, index))
+		return;
+
+	TraceRecord& record = ring.m_records[index & ring.m_mask];
+
+	record.m_timestamp = getTimestamp();
+	record.m_size = (uint32_t)size;
+	record.m_mailboxId = mailboxId;
+	record.m_event = event;
+	record.m_dataType = dataType;
+
+	size_t length = std::min(peer.length(), TraceRecord::TEXT_CAPACITY - 1);
+	memcpy(record.m_text, peer.data(), length);
+	record.m_text[length] = '\0';
+
+	publish(ring, index, 1);
+}
+
+void DataMailboxAsyncLogger::flush()
+{
+	std::unique_lock<std::mutex> lock(m_writerMutex);
+
+	// The pass running now may have missed the records, the one after it cannot
+	unsigned long long target = m_passCount + 2;
+
+	m_wake.notify_one();
+	m_passDone.wait(lock, [&]() { return m_passCount >= target; });
+}
+
+unsigned long long DataMailboxAsyncLogger::getDroppedCount()
+{
+	std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+	unsigned long long dropped = 0;
+
+	for (const std::unique_ptr<Ring>& ring : m_rings)
+		dropped += ring->m_dropped.load(std::memory_order_relaxed);
+
+	return dropped;
+}
+
+DataMailboxAsyncLogger::Ring& DataMailboxAsyncLogger::getRing()
+{
+	// Ring of the logger this thread used last, the map is searched only when the thread switches loggers
+	thread_local unsigned long long cachedLoggerId = 0;
+	thread_local Ring* pCachedRing = nullptr;
+
+	if (cachedLoggerId == m_id)
+		return *pCachedRing;
+
+	std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+	Ring*& pRing = m_threadRings[std::this_thread::get_id()];
+
+	if (pRing == nullptr)
+	{
+		m_rings.emplace_back(new Ring(m_ringCapacity));
+		pRing = m_rings.back().get();
+	}
+
+	cachedLoggerId = m_id;
+	pCachedRing = pRing;
+
+	return *pRing;
+}
+
+bool DataMailboxAsyncLogger::reserve(Ring& ring, size_t count, size_t& index)
+{
+	index = ring.m_head.load(std::memory_order_relaxed);
+
+	size_t tail = ring.m_tail.load(std::memory_order_acquire);
+
+	if (index - tail + count > ring.m_records.size())
+	{
+		ring.m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+void DataMailboxAsyncLogger::publish(Ring& ring, size_t index, size_t count)
+{
+	ring.m_head.store(index + count, std::memory_order_release);
+}
+
+void DataMailboxAsyncLogger::writerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_writerMutex);
+
+	while (true)
+	{
+		bool stopping = m_stopping;
+
+		lock.unlock();
+
+		bool drained = drain();
+
+		if (drained)
+			writeBatch();
+
+		lock.lock();
+
+		m_passCount++;
+		m_passDone.notify_all();
+
+		// Once stopping, keeps going until a pass finds nothing
+		if (!drained)
+		{
+			if (stopping)
+				return;
+
+			m_wake.wait_for(lock, std::chrono::milliseconds(IDLE_WAIT_MS));
+		}
+	}
+}
+
+bool DataMailboxAsyncLogger::drain()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+		m_ringSnapshot.clear();
+
+		for (const std::unique_ptr<Ring>& ring : m_rings)
+			m_ringSnapshot.push_back(ring.get());
+	}
+
+	m_batch.clear();
+
+	for (Ring* pRing : m_ringSnapshot)
+	{
+		size_t tail = pRing->m_tail.load(std::memory_order_relaxed);
+		size_t head = pRing->m_head.load(std::memory_order_acquire);
+
+		for (; tail != head; tail++)
+			m_batch.push_back(pRing->m_records[tail & pRing->m_mask]);
+
+		pRing->m_tail.store(tail, std::memory_order_release);
+	}
+
+	// Text chunks share the timestamp of their line, the stable sort keeps them together and in order
+	std::stable_sort(m_batch.begin(), m_batch.end(), [](const TraceRecord& left, const TraceRecord& right)
+	{
+		return left.m_timestamp < right.m_timestamp;
+	});
+
+	return !m_batch.empty();
+}
+
+void DataMailboxAsyncLogger::writeBatch()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_namesMutex);
+
+		if (m_writerNames.size() != m_names.size())
+			m_writerNames = m_names;
+	}
+
+	std::string line;
+
+	for (size_t i = 0; i < m_batch.size(); )
+	{
+		i += writeRecord(i, line);
+
+		*m_pTarget << line;
+		m_writtenCount++;
+	}
+}
+
+size_t DataMailboxAsyncLogger::writeRecord(size_t i, std::string& line)
+{
+	const TraceRecord& record = m_batch[i];
+
+	uint64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(m_start.time_since_epoch()).count();
+	uint64_t elapsed = record.m_timestamp > start ? record.m_timestamp - start : 0;
+
+	char prefix[32];
+	snprintf(prefix, sizeof(prefix), "[%llu.%09llu] ", (unsigned long long)(elapsed / 1000000000), (unsigned long long)(elapsed % 1000000000));
+
+	line.assign(prefix);
+
+	if (record.m_event == enuTraceEvent::TEXT)
+	{
+		size_t count = std::max<size_t>(1, (record.m_size + TraceRecord::TEXT_CAPACITY - 1) / TraceRecord::TEXT_CAPACITY);
+		count = std::min(count, m_batch.size() - i);
+
+		for (size_t k = 0; k < count; k++)
+		{
+			size_t offset = k * TraceRecord::TEXT_CAPACITY;
+			line.append(m_batch[i + k].m_text, std::min<size_t>(TraceRecord::TEXT_CAPACITY, record.m_size - offset));
+		}
+
+		return count;
+	}
+
+	const char* name = record.m_mailboxId < m_writerNames.size() ? m_writerNames[record.m_mailboxId].c_str() : "?";
+	const char* eventName = (size_t)record.m_event < sizeof(TRACE_EVENT_NAMES) / sizeof(TRACE_EVENT_NAMES[0]) ? TRACE_EVENT_NAMES[(int)record.m_event] : "?";
+
+	char text[TraceRecord::TEXT_CAPACITY + 128];
+	snprintf(text, sizeof(text), "%s - %s %s (%u B) %s - %s", name, eventName, getDataTypeNameCStr(record.m_dataType), record.m_size,
+		record.m_event == enuTraceEvent::RECEIVED ? "from" : "to", record.m_text);
+
+	line.append(text);
+
+	return 1;
+}
@@ -0,0 +1,75 @@
+#include "DataMailboxBacklog.hpp"
+
+#include <algorithm>
+
+DataMailboxBacklogTracker::DataMailboxBacklogTracker(const std::string& name, const BacklogWatermarks& watermarks)
+	:	m_name(name), m_high(watermarks.m_high), m_low(std::min(watermarks.m_low, watermarks.m_high)), m_callback(watermarks.m_callback),
+	m_sampleInterval(std::max(1u, watermarks.m_sampleInterval)), m_messageCount(0), m_state(enuBacklogState::NORMAL),
+	m_backlog(0), m_highestBacklog(0), m_highCount(0), m_shed(0)
+{
+	for (MessageDataType dataType : watermarks.m_shedTypes)
+		m_shedTypes.set((unsigned char)dataType);
+}
+
+bool DataMailboxBacklogTracker::isSampleDue()
+{
+	return m_messageCount.fetch_add(1, std::memory_order_relaxed) % m_sampleInterval == 0;
+}
+
+void DataMailboxBacklogTracker::update(size_t backlog)
+{
+	m_backlog.store(backlog, std::memory_order_relaxed);
+
+	size_t highest = m_highestBacklog.load(std::memory_order_relaxed);
+	while (backlog > highest && !m_highestBacklog.compare_exchange_weak(highest, backlog, std::memory_order_relaxed))
+		;
+
+	enuBacklogState expected;
+	enuBacklogState state;
+
+	if (backlog >= m_high)
+	{
+		expected = enuBacklogState::NORMAL;
+		state = enuBacklogState::HIGH;
+	}
+	else if (backlog <= m_low)
+	{
+		expected = enuBacklogState::HIGH;
+		state = enuBacklogState::NORMAL;
+	}
+	else
+		return;
+
+	// Only the thread which makes the change calls the callback
+	if (!m_state.compare_exchange_strong(expected, state))
+		return;
+
+	if (state == enuBacklogState::HIGH)
+		m_highCount++;
+
+	if (m_callback)
+		m_callback(m_name, state, backlog);
+}
+
+bool DataMailboxBacklogTracker::shed(MessageDataType dataType)
+{
+	if (m_state.load(std::memory_order_relaxed) != enuBacklogState::HIGH || !m_shedTypes.test((unsigned char)dataType))
+		return false;
+
+	m_shed.fetch_add(1, std::memory_order_relaxed);
+
+	return true;
+}
+
+BacklogStatistics DataMailboxBacklogTracker::getStatistics() const
+{
+	BacklogStatistics statistics;
+
+	statistics.m_state = m_state;
+	statistics.m_backlog = m_backlog;
+	statistics.m_highestBacklog = m_highestBacklog;
+	statistics.m_highCount = m_highCount;
+	statistics.m_shed = m_shed;
+
+	return statistics;
+}
@@ -0,0 +1,214 @@
+#include "DataMailboxCRC32C.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <nmmintrin.h>
+#define DATA_MAILBOX_CRC32C_X86
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define DATA_MAILBOX_CRC32C_AARCH64
+#endif
+
+namespace
+{
+	/// Reflected Castagnoli polynomial
+	const uint32_t POLYNOMIAL = 0x82F63B78;
+
+	struct SlicingTables
+	{
+		uint32_t m_table[8][256];
+
+		SlicingTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc = i;
+
+				for (int bit = 0; bit < 8; bit++)
+					crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+
+				m_table[0][i] = crc;
+			}
+
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				for (int slice = 1; slice < 8; slice++)
+					m_table[slice][i] = (m_table[slice - 1][i] >> 8) ^ m_table[0][m_table[slice - 1][i] & 0xFF];
+			}
+		}
+	};
+
+	const SlicingTables& getTables()
+	{
+		static const SlicingTables tables;
+		return tables;
+	}
+
+	uint32_t extendTable(uint32_t crc, const unsigned char* pData, size_t size)
+	{
+		const uint32_t (*table)[256] = getTables().m_table;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		// Eight bytes per step
+		while (size >= 8)
+		{
+			uint32_t low, high;
+			memcpy(&low, pData, sizeof(low));
+			memcpy(&high, pData + 4, sizeof(high));
+
+			low ^= crc;
+
+			crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24]
+				^ table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+
+			pData += 8;
+			size -= 8;
+		}
+#endif
+
+		while (size > 0)
+		{
+			crc = (crc >> 8) ^ table[0][(crc ^ *pData) & 0xFF];
+			pData++;
+			size--;
+		}
+
+		return crc;
+	}
+
+#ifdef DATA_MAILBOX_CRC32C_X86
+	__attribute__((target("sse4.2")))
+	uint32_t extendSSE42(uint32_t crc, const unsigned char* pData, size_t size)
+	{
+#ifdef __x86_64__
+		uint64_t crc64 = crc;
+
+		while (size >= 8)
+		{
+			uint64_t word;
+			memcpy(&word, pData, sizeof(word));
+
+			crc64 = _mm_crc32_u64(crc64, word);
+
+			pData += 8;
+			size -= 8;
+		}
+
+		crc = (uint32_t)crc64;
+#endif
+
+		while (size >= 4)
+		{
+			uint32_t word;
+			memcpy(&word, pData, sizeof(word));
+
+			crc = _mm_crc32_u32(crc, word);
+
+			pData += 4;
+			size -= 4;
+		}
+
+		while (size > 0)
+		{
+			crc = _mm_crc32_u8(crc, *pData);
+			pData++;
+			size--;
+		}
+
+		return crc;
+	}
+
+	bool hasSSE42()
+	{
+		unsigned int eax, ebx, ecx, edx;
+
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+			return false;
+
+		return (ecx & bit_SSE4_2) != 0;
+	}
+#endif
+
+#ifdef DATA_MAILBOX_CRC32C_AARCH64
+	__attribute__((target("+crc")))
+	uint32_t extendARMv8(uint32_t crc, const unsigned char* pData, size_t size)
+	{
+		while (size >= 8)
+		{
+			uint64_t word;
+			memcpy(&word, pData, sizeof(word));
+
+			crc = __builtin_aarch64_crc32cx(crc, word);
+
+			pData += 8;
+			size -= 8;
+		}
+
+		while (size > 0)
+		{
+			crc = __builtin_aarch64_crc32cb(crc, *pData);
+			pData++;
+			size--;
+		}
+
+		return crc;
+	}
+
+	bool hasARMv8CRC()
+	{
+		return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+	}
+#endif
+
+	typedef uint32_t (*ExtendFunction)(uint32_t crc, const unsigned char* pData, size_t size);
+
+	struct Implementation
+	{
+		ExtendFunction m_extend;
+		const char* m_name;
+	};
+
+	Implementation selectImplementation()
+	{
+#ifdef DATA_MAILBOX_CRC32C_X86
+		if (hasSSE42())
+			return Implementation{ extendSSE42, "sse4.2" };
+#endif
+
+#ifdef DATA_MAILBOX_CRC32C_AARCH64
+		if (hasARMv8CRC())
+			return Implementation{ extendARMv8, "armv8-crc" };
+#endif
+
+		return Implementation{ extendTable, "portable" };
+	}
+
+	const Implementation& getImplementation()
+	{
+		static const Implementation implementation = selectImplementation();
+		return implementation;
+	}
+}
+
+uint32_t DataMailboxCRC32C::compute(const void* data, size_t size)
+{
+	return extend(0, data, size);
+}
+
+uint32_t DataMailboxCRC32C::extend(uint32_t crc, const void* data, size_t size)
+{
+	return ~getImplementation().m_extend(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+uint32_t DataMailboxCRC32C::extendPortable(uint32_t crc, const void* data, size_t size)
+{
+	return ~extendTable(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+const char* DataMailboxCRC32C::getImplementationName()
+{
+	return getImplementation().m_name;
+}
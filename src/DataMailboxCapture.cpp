@@ -0,0 +1,236 @@
+#include "DataMailboxCapture.hpp"
+#include "DataMailbox.hpp"
+
+#include "Kernel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t RECORD_ALIGNMENT = 8;
+
+static size_t alignRecordSize(size_t size)
+{
+	return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+bool CaptureFilter::matches(const CaptureRecordHeader& header) const
+{
+	if (!m_anyDataType && header.m_dataType != (char)m_dataType)
+		return false;
+
+	if (header.m_timestamp_ns < m_from_ns || header.m_timestamp_ns >= m_to_ns)
+		return false;
+
+	if (header.m_direction == (char)enuCaptureDirection::SENT)
+		return m_sent;
+
+	return m_received;
+}
+
+std::string DataMailboxCaptureWriter::getSegmentPath(const std::string& directory, const std::string& name, unsigned int index)
+{
+	char indexString[16];
+	snprintf(indexString, sizeof(indexString), "%06u", index);
+
+	return directory + "/" + name + "." + indexString + ".capture";
+}
+
+DataMailboxCaptureWriter::DataMailboxCaptureWriter(const std::string& directory, const std::string& name, size_t segmentSize)
+	:	m_directory(directory), m_name(name), m_segmentSize(alignRecordSize(segmentSize)),
+	m_segmentIndex(0), m_pSegment(nullptr), m_offset(0), m_recordCount(0), m_lastTimestamp_ns(0)
+{
+	// Continue after the last existing segment
+	struct stat fileStatus;
+	while (stat(getSegmentPath(m_directory, m_name, m_segmentIndex).c_str(), &fileStatus) == 0)
+		m_segmentIndex++;
+
+	if (!openNextSegment())
+		Kernel::Warning("Cannot open capture segment: " + getSegmentPath(m_directory, m_name, m_segmentIndex));
+}
+
+DataMailboxCaptureWriter::~DataMailboxCaptureWriter()
+{
+	closeSegment();
+}
+
+bool DataMailboxCaptureWriter::openNextSegment()
+{
+	closeSegment();
+
+	std::string path = getSegmentPath(m_directory, m_name, m_segmentIndex);
+
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		return false;
+
+	// Sparse, zero filled file - zero m_size marks the end of the written records
+	if (ftruncate(fd, m_segmentSize) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* pMapping = mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (pMapping == MAP_FAILED)
+		return false;
+
+	m_pSegment = static_cast<char*>(pMapping);
+	m_offset = 0;
+	m_segmentIndex++;
+
+	return true;
+}
+
+void DataMailboxCaptureWriter::closeSegment()
+{
+	if (m_pSegment == nullptr)
+		return;
+
+	munmap(m_pSegment, m_segmentSize);
+	m_pSegment = nullptr;
+}
+
+void DataMailboxCaptureWriter::append(enuCaptureDirection direction, const std::string& source, const std::string& destination, const char* frame, size_t frameSize)
+{
+	size_t recordSize = alignRecordSize(sizeof(CaptureRecordHeader) + source.length() + destination.length() + frameSize);
+
+	// Keep room for the terminating zero m_size
+	if (recordSize + sizeof(uint32_t) > m_segmentSize)
+	{
+		Kernel::Warning("Frame too large for capture segment: " + std::to_string(frameSize) + " bytes");
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Read under the lock and never below the previous record, so records are written in timestamp order
+	// even when concurrent appends race or CLOCK_REALTIME steps back
+	uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	timestamp = std::max(timestamp, m_lastTimestamp_ns);
+	m_lastTimestamp_ns = timestamp;
+
+	if (m_pSegment == nullptr || m_offset + recordSize + sizeof(uint32_t) > m_segmentSize)
+	{
+		if (!openNextSegment())
+			return;
+	}
+
+	char* pRecord = m_pSegment + m_offset;
+
+	CaptureRecordHeader header;
+	header.m_size = 0;
+	header.m_frameSize = frameSize;
+	header.m_timestamp_ns = timestamp;
+	header.m_sourceLength = source.length();
+	header.m_destinationLength = destination.length();
+	header.m_direction = (char)direction;
+	// Without the checksum flag, so filters and readers see the MessageDataType whether checksums are on or not
+	header.m_dataType = frameSize > 0 ? (char)((unsigned char)frame[0] & ~FRAME_CHECKSUM_FLAG) : 0;
+	header.m_reserved[0] = header.m_reserved[1] = 0;
+
+	memcpy(pRecord, &header, sizeof(header));
+
+	char* pData = pRecord + sizeof(header);
+
+	memcpy(pData, source.c_str(), source.length());
+	pData += source.length();
+
+	memcpy(pData, destination.c_str(), destination.length());
+	pData += destination.length();
+
+	memcpy(pData, frame, frameSize);
+
+	// Publish the record for concurrent readers only after it is complete
+	std::atomic_thread_fence(std::memory_order_release);
+	reinterpret_cast<volatile uint32_t*>(pRecord)[0] = recordSize;
+
+	m_offset += recordSize;
+	m_recordCount++;
+}
+
+DataMailboxCaptureReader::DataMailboxCaptureReader(const std::string& directory, const std::string& name)
+	:	m_directory(directory), m_name(name)
+{
+
+}
+
+unsigned long long DataMailboxCaptureReader::forEach(const CaptureFilter& filter, Visitor visitor)
+{
+	unsigned long long visited = 0;
+
+	for (unsigned int index = 0; ; index++)
+	{
+		std::string path = DataMailboxCaptureWriter::getSegmentPath(m_directory, m_name, index);
+
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			break;
+
+		struct stat fileStatus;
+		if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size < (off_t)sizeof(CaptureRecordHeader))
+		{
+			close(fd);
+			continue;
+		}
+
+		size_t segmentSize = fileStatus.st_size;
+		void* pMapping = mmap(nullptr, segmentSize, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (pMapping == MAP_FAILED)
+		{
+			Kernel::Warning("Cannot map capture segment: " + path);
+			continue;
+		}
+
+		const char* pSegment = static_cast<const char*>(pMapping);
+		size_t offset = 0;
+		bool stop = false;
+
+		while (!stop && offset + sizeof(CaptureRecordHeader) <= segmentSize)
+		{
+			CaptureRecordHeader header;
+			memcpy(&header, pSegment + offset, sizeof(header));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (header.m_size == 0 || offset + header.m_size > segmentSize)
+				break;
+
+			if (filter.matches(header))
+			{
+				CaptureRecord record;
+				record.m_timestamp_ns = header.m_timestamp_ns;
+				record.m_direction = (enuCaptureDirection)header.m_direction;
+				record.m_dataType = (MessageDataType)header.m_dataType;
+				record.m_pSource = pSegment + offset + sizeof(header);
+				record.m_sourceLength = header.m_sourceLength;
+				record.m_pDestination = record.m_pSource + header.m_sourceLength;
+				record.m_destinationLength = header.m_destinationLength;
+				record.m_pFrame = record.m_pDestination + header.m_destinationLength;
+				record.m_frameSize = header.m_frameSize;
+
+				visited++;
+				stop = !visitor(record);
+			}
+
+			offset += header.m_size;
+		}
+
+		munmap(pMapping, segmentSize);
+
+		if (stop)
+			break;
+	}
+
+	return visited;
+}
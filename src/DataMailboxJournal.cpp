@@ -0,0 +1,386 @@
+#include "DataMailboxJournal.hpp"
+#include "DataMailboxCRC32C.hpp"
+
+#include "Kernel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t RECORD_ALIGNMENT = 8;
+
+static const char* SEGMENT_SUFFIX = ".journal";
+
+static size_t alignRecordSize(size_t size)
+{
+	return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+/// CRC32C of the immutable header fields followed by source name and frame
+static uint32_t computeRecordChecksum(const JournalRecordHeader& header, const char* pPayload, size_t payloadSize)
+{
+	const size_t first = offsetof(JournalRecordHeader, m_sequence);
+	const size_t last = offsetof(JournalRecordHeader, m_state);
+
+	uint32_t checksum = DataMailboxCRC32C::compute(reinterpret_cast<const char*>(&header) + first, last - first);
+
+	return DataMailboxCRC32C::extend(checksum, pPayload, payloadSize);
+}
+
+/// Makes creation and deletion of segment files durable
+static void syncDirectory(const std::string& directory)
+{
+	int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return;
+
+	fsync(fd);
+	close(fd);
+}
+
+std::string DataMailboxJournal::getSegmentPath(const std::string& directory, const std::string& name, unsigned int index)
+{
+	char indexString[16];
+	snprintf(indexString, sizeof(indexString), "%06u", index);
+
+	return directory + "/" + name + "." + indexString + SEGMENT_SUFFIX;
+}
+
+DataMailboxJournal::DataMailboxJournal(const std::string& directory, const std::string& name, size_t segmentSize)
+	:	m_directory(directory), m_name(name), m_segmentSize(alignRecordSize(segmentSize)),
+	m_nextSegmentIndex(0), m_appending(false), m_offset(0),
+	m_nextSequence(1), m_uncommittedCount(0), m_commitCount(0)
+{
+	recover();
+
+	// Never append to a recovered segment, its tail may be torn
+	if (!openNextSegment())
+		Kernel::Warning("Cannot open journal segment: " + getSegmentPath(m_directory, m_name, m_nextSegmentIndex));
+}
+
+DataMailboxJournal::~DataMailboxJournal()
+{
+	commit();
+
+	m_appending = false;
+
+	std::vector<unsigned int> retired;
+
+	for (auto& segment : m_segments)
+	{
+		if (segment.second.m_pendingCount == 0)
+			retired.push_back(segment.first);
+		else
+			munmap(segment.second.m_pData, segment.second.m_size);
+	}
+
+	for (unsigned int index : retired)
+		retireSegment(index);
+
+	m_segments.clear();
+}
+
+void DataMailboxJournal::recover()
+{
+	std::vector<unsigned int> indices;
+
+	DIR* pDirectory = opendir(m_directory.c_str());
+	if (pDirectory == nullptr)
+		return;
+
+	const std::string prefix = m_name + ".";
+	const size_t suffixLength = strlen(SEGMENT_SUFFIX);
+
+	while (struct dirent* pEntry = readdir(pDirectory))
+	{
+		std::string fileName = pEntry->d_name;
+
+		if (fileName.length() <= prefix.length() + suffixLength || fileName.compare(0, prefix.length(), prefix) != 0
+			|| fileName.compare(fileName.length() - suffixLength, suffixLength, SEGMENT_SUFFIX) != 0)
+			continue;
+
+		std::string indexString = fileName.substr(prefix.length(), fileName.length() - prefix.length() - suffixLength);
+
+		if (indexString.find_first_not_of("0123456789") != std::string::npos)
+			continue;
+
+		indices.push_back(strtoul(indexString.c_str(), nullptr, 10));
+	}
+
+	closedir(pDirectory);
+
+	std::sort(indices.begin(), indices.end());
+
+	for (unsigned int index : indices)
+	{
+		m_nextSegmentIndex = index + 1;
+
+		std::string path = getSegmentPath(m_directory, m_name, index);
+
+		int fd = open(path.c_str(), O_RDWR);
+		if (fd < 0)
+			continue;
+
+		struct stat fileStatus;
+		if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size < (off_t)sizeof(JournalRecordHeader))
+		{
+			close(fd);
+			unlink(path.c_str());
+			continue;
+		}
+
+		Segment segment{ nullptr, (size_t)fileStatus.st_size, 0, 0, 0 };
+
+		void* pMapping = mmap(nullptr, segment.m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (pMapping == MAP_FAILED)
+		{
+			Kernel::Warning("Cannot map journal segment: " + path);
+			continue;
+		}
+
+		segment.m_pData = static_cast<char*>(pMapping);
+
+		size_t offset = 0;
+
+		while (offset + sizeof(JournalRecordHeader) <= segment.m_size)
+		{
+			JournalRecordHeader header;
+			memcpy(&header, segment.m_pData + offset, sizeof(header));
+
+			if (header.m_size == 0)
+				break;
+
+			size_t payloadSize = (size_t)header.m_sourceLength + header.m_frameSize;
+
+			if (header.m_size % RECORD_ALIGNMENT != 0 || offset + header.m_size > segment.m_size || sizeof(header) + payloadSize > header.m_size
+				|| computeRecordChecksum(header, segment.m_pData + offset + sizeof(header), payloadSize) != header.m_checksum)
+			{
+				// Written, but not committed before a crash. Never delivered, so nothing is lost.
+				Kernel::Warning("Torn journal record skipped: " + path + " offset " + std::to_string(offset));
+				break;
+			}
+
+			if (header.m_state == (uint8_t)enuJournalRecordState::PENDING)
+			{
+				m_pending[header.m_sequence] = PendingRecord{ index, offset };
+				segment.m_pendingCount++;
+			}
+
+			m_nextSequence = std::max(m_nextSequence, header.m_sequence + 1);
+
+			offset += header.m_size;
+		}
+
+		m_segments[index] = segment;
+
+		if (segment.m_pendingCount == 0)
+			retireSegment(index);
+	}
+}
+
+bool DataMailboxJournal::openNextSegment()
+{
+	m_appending = false;
+
+	std::string path = getSegmentPath(m_directory, m_name, m_nextSegmentIndex);
+
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		return false;
+
+	// Zero filled file - zero m_size marks the end of the written records.
+	// Blocks are allocated up front, so commits do not wait for the filesystem to allocate them.
+	if (ftruncate(fd, m_segmentSize) != 0)
+	{
+		close(fd);
+		unlink(path.c_str());
+		return false;
+	}
+
+	posix_fallocate(fd, 0, m_segmentSize);
+
+	void* pMapping = mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (pMapping == MAP_FAILED)
+	{
+		unlink(path.c_str());
+		return false;
+	}
+
+	syncDirectory(m_directory);
+
+	m_segments[m_nextSegmentIndex] = Segment{ static_cast<char*>(pMapping), m_segmentSize, 0, 0, 0 };
+	m_nextSegmentIndex++;
+	m_appending = true;
+	m_offset = 0;
+
+	return true;
+}
+
+void DataMailboxJournal::retireSegment(unsigned int index)
+{
+	auto segment = m_segments.find(index);
+	if (segment == m_segments.end())
+		return;
+
+	munmap(segment->second.m_pData, segment->second.m_size);
+	m_segments.erase(segment);
+
+	unlink(getSegmentPath(m_directory, m_name, index).c_str());
+}
+
+void DataMailboxJournal::markDirty(Segment& segment, size_t begin, size_t end)
+{
+	if (segment.m_dirtyBegin >= segment.m_dirtyEnd)
+	{
+		segment.m_dirtyBegin = begin;
+		segment.m_dirtyEnd = end;
+		return;
+	}
+
+	segment.m_dirtyBegin = std::min(segment.m_dirtyBegin, begin);
+	segment.m_dirtyEnd = std::max(segment.m_dirtyEnd, end);
+}
+
+DataMailboxJournal::Sequence DataMailboxJournal::append(const std::string& source, const char* frame, size_t frameSize)
+{
+	size_t payloadSize = source.length() + frameSize;
+	size_t recordSize = alignRecordSize(sizeof(JournalRecordHeader) + payloadSize);
+
+	// Keep room for the terminating zero m_size
+	if (recordSize + sizeof(uint32_t) > m_segmentSize || source.length() > UINT16_MAX)
+	{
+		Kernel::Warning("Frame too large for journal segment: " + std::to_string(frameSize) + " bytes");
+		return 0;
+	}
+
+	if (!m_appending || m_offset + recordSize + sizeof(uint32_t) > m_segmentSize)
+	{
+		bool wasAppending = m_appending;
+		unsigned int previousIndex = m_nextSegmentIndex - 1;
+
+		if (!openNextSegment())
+		{
+			Kernel::Warning("Cannot open journal segment: " + getSegmentPath(m_directory, m_name, m_nextSegmentIndex));
+			return 0;
+		}
+
+		if (wasAppending && m_segments[previousIndex].m_pendingCount == 0)
+			retireSegment(previousIndex);
+	}
+
+	unsigned int index = m_nextSegmentIndex - 1;
+	Segment& segment = m_segments[index];
+
+	char* pRecord = segment.m_pData + m_offset;
+	char* pPayload = pRecord + sizeof(JournalRecordHeader);
+
+	memcpy(pPayload, source.c_str(), source.length());
+	memcpy(pPayload + source.length(), frame, frameSize);
+
+	JournalRecordHeader header;
+	header.m_size = 0;
+	header.m_sequence = m_nextSequence++;
+	header.m_frameSize = frameSize;
+	header.m_sourceLength = source.length();
+	header.m_state = (uint8_t)enuJournalRecordState::PENDING;
+	header.m_reserved = 0;
+	header.m_checksum = computeRecordChecksum(header, pPayload, payloadSize);
+
+	memcpy(pRecord, &header, sizeof(header));
+
+	// A reader (recovery after a crash of this process) sees only complete records
+	std::atomic_thread_fence(std::memory_order_release);
+	reinterpret_cast<volatile uint32_t*>(pRecord)[0] = recordSize;
+
+	markDirty(segment, m_offset, m_offset + recordSize);
+
+	m_pending[header.m_sequence] = PendingRecord{ index, m_offset };
+	segment.m_pendingCount++;
+
+	m_offset += recordSize;
+	m_uncommittedCount++;
+
+	return header.m_sequence;
+}
+
+bool DataMailboxJournal::acknowledge(Sequence sequence)
+{
+	auto pending = m_pending.find(sequence);
+	if (pending == m_pending.end())
+		return false;
+
+	unsigned int index = pending->second.m_segmentIndex;
+	size_t offset = pending->second.m_offset;
+
+	m_pending.erase(pending);
+
+	Segment& segment = m_segments[index];
+
+	segment.m_pData[offset + offsetof(JournalRecordHeader, m_state)] = (char)enuJournalRecordState::ACKNOWLEDGED;
+	markDirty(segment, offset, offset + sizeof(JournalRecordHeader));
+
+	segment.m_pendingCount--;
+
+	if (segment.m_pendingCount == 0 && !(m_appending && index == m_nextSegmentIndex - 1))
+		retireSegment(index);
+
+	return true;
+}
+
+void DataMailboxJournal::commit()
+{
+	static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+	bool synced = false;
+
+	for (auto& entry : m_segments)
+	{
+		Segment& segment = entry.second;
+
+		if (segment.m_dirtyBegin >= segment.m_dirtyEnd)
+			continue;
+
+		size_t begin = segment.m_dirtyBegin & ~(pageSize - 1);
+
+		if (msync(segment.m_pData + begin, segment.m_dirtyEnd - begin, MS_SYNC) != 0)
+			Kernel::Warning("Cannot sync journal segment: " + getSegmentPath(m_directory, m_name, entry.first));
+
+		segment.m_dirtyBegin = segment.m_dirtyEnd = 0;
+		synced = true;
+	}
+
+	m_uncommittedCount = 0;
+
+	if (synced)
+		m_commitCount++;
+}
+
+void DataMailboxJournal::forEachPending(Visitor visitor) const
+{
+	for (const auto& pending : m_pending)
+	{
+		const Segment& segment = m_segments.at(pending.second.m_segmentIndex);
+		const char* pRecord = segment.m_pData + pending.second.m_offset;
+
+		JournalRecordHeader header;
+		memcpy(&header, pRecord, sizeof(header));
+
+		const char* pSource = pRecord + sizeof(header);
+
+		visitor(pending.first, pSource, header.m_sourceLength, pSource + header.m_sourceLength, header.m_frameSize);
+	}
+}
@@ -0,0 +1,291 @@
+#include "DataMailboxMemoryTransport.hpp"
+#include "DataMailboxTime.hpp"
+#include "Kernel.hpp"
+
+#include <algorithm>
+
+DataMailboxMemoryNetwork::DataMailboxMemoryNetwork()
+	:	m_time(0), m_defaultDelay(0), m_blockWhenFull(true)
+{
+
+}
+
+std::chrono::nanoseconds DataMailboxMemoryNetwork::getTime()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_time;
+}
+
+void DataMailboxMemoryNetwork::advance(std::chrono::nanoseconds duration)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_time += std::max(duration, std::chrono::nanoseconds::zero());
+	}
+
+	m_changed.notify_all();
+}
+
+void DataMailboxMemoryNetwork::setDeliveryDelay(std::chrono::nanoseconds delay)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_defaultDelay = delay;
+}
+
+void DataMailboxMemoryNetwork::setDeliveryDelay(const std::string& destination, std::chrono::nanoseconds delay)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_delays[destination] = delay;
+}
+
+std::chrono::nanoseconds DataMailboxMemoryNetwork::getDeliveryDelay(const std::string& destination)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto delay = m_delays.find(destination);
+
+	return delay != m_delays.end() ? delay->second : m_defaultDelay;
+}
+
+void DataMailboxMemoryNetwork::setBlockWhenFull(bool block)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_blockWhenFull = block;
+	}
+
+	m_changed.notify_all();
+}
+
+MemoryNetworkStatistics DataMailboxMemoryNetwork::getStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+void DataMailboxMemoryNetwork::attach(const std::string& name, const mq_attr& attributes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_queues.count(name) != 0)
+		Kernel::Fatal_Error("Mailbox name already in use: " + name);
+
+	m_queues[name].m_attributes = attributes;
+}
+
+void DataMailboxMemoryNetwork::detach(const std::string& name)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queues.erase(name);
+	}
+
+	// Senders waiting for room find the queue gone
+	m_changed.notify_all();
+}
+
+void DataMailboxMemoryNetwork::send(const std::string& source, const std::string& destination, const TransportBuffer* parts, size_t count)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < count; i++)
+		size += parts[i].m_size;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto queue = m_queues.find(destination);
+
+	if (queue != m_queues.end() && size > (size_t)queue->second.m_attributes.mq_msgsize)
+	{
+		m_statistics.m_dropped++;
+		Kernel::Warning("Cannot send to mailbox " + destination + ": frame of " + std::to_string(size) + " bytes is larger than mq_msgsize");
+		return;
+	}
+
+	// The queue is looked up again after every wait, it may be gone
+	auto isFull = [&]()
+	{
+		queue = m_queues.find(destination);
+		return queue != m_queues.end() && queue->second.m_attributes.mq_maxmsg > 0
+			&& queue->second.m_frames.size() >= (size_t)queue->second.m_attributes.mq_maxmsg;
+	};
+
+	if (isFull())
+	{
+		if (!m_blockWhenFull)
+		{
+			m_statistics.m_dropped++;
+			return;
+		}
+
+		m_statistics.m_blocked++;
+		m_changed.wait(lock, [&]() { return !isFull() || !m_blockWhenFull; });
+
+		// Blocking was turned off while waiting
+		if (isFull())
+		{
+			m_statistics.m_dropped++;
+			return;
+		}
+	}
+
+	if (queue == m_queues.end())
+	{
+		m_statistics.m_dropped++;
+		Kernel::Warning("Cannot send to mailbox " + destination + ": not in this network");
+		return;
+	}
+
+	auto delay = m_delays.find(destination);
+
+	QueuedFrame frame;
+	frame.m_deliveryTime = m_time + (delay != m_delays.end() ? delay->second : m_defaultDelay);
+	frame.m_source = source;
+	frame.m_data.reserve(size);
+
+	for (size_t i = 0; i < count; i++)
+		frame.m_data.insert(frame.m_data.end(), parts[i].m_pData, parts[i].m_pData + parts[i].m_size);
+
+	std::deque<QueuedFrame>& frames = queue->second.m_frames;
+
+	// After every frame due no later, so a changed delay cannot reorder frames due at the same time
+	auto position = std::upper_bound(frames.begin(), frames.end(), frame.m_deliveryTime, [](std::chrono::nanoseconds time, const QueuedFrame& queued)
+	{
+		return time < queued.m_deliveryTime;
+	});
+
+	frames.insert(position, std::move(frame));
+	m_statistics.m_sent++;
+
+	lock.unlock();
+	m_changed.notify_all();
+}
+
+TransportFrame DataMailboxMemoryNetwork::receive(const std::string& name, enuReceiveOptions options, std::chrono::nanoseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	Queue& queue = m_queues.at(name);
+	std::chrono::nanoseconds deadline = m_time + timeout;
+
+	TransportFrame frame;
+
+	while (true)
+	{
+		if (!queue.m_frames.empty() && queue.m_frames.front().m_deliveryTime <= m_time)
+			break;
+
+		if (options % enuReceiveOptions::NONBLOCKING)
+		{
+			frame.m_type = enuMessageType::EMPTY;
+			return frame;
+		}
+
+		bool timed = options % enuReceiveOptions::TIMED;
+
+		if (!queue.m_frames.empty() && (!timed || queue.m_frames.front().m_deliveryTime <= deadline))
+		{
+			// Nothing to do until the next delivery, so time jumps to it
+			m_time = queue.m_frames.front().m_deliveryTime;
+			continue;
+		}
+
+		if (timed)
+		{
+			m_time = std::max(m_time, deadline);
+			frame.m_type = enuMessageType::TIMED_OUT;
+			return frame;
+		}
+
+		m_changed.wait(lock);
+	}
+
+	QueuedFrame& queued = queue.m_frames.front();
+
+	frame.m_type = enuMessageType::DATA;
+	frame.m_size = queued.m_data.size();
+	frame.m_pData = new char[frame.m_size];
+	std::copy(queued.m_data.begin(), queued.m_data.end(), frame.m_pData);
+	frame.m_source = std::move(queued.m_source);
+
+	queue.m_frames.pop_front();
+	m_statistics.m_received++;
+
+	lock.unlock();
+	m_changed.notify_all();
+
+	return frame;
+}
+
+mq_attr DataMailboxMemoryNetwork::getAttributes(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Queue& queue = m_queues.at(name);
+	mq_attr attributes = queue.m_attributes;
+
+	attributes.mq_curmsgs = std::count_if(queue.m_frames.begin(), queue.m_frames.end(), [&](const QueuedFrame& frame)
+	{
+		return frame.m_deliveryTime <= m_time;
+	});
+
+	return attributes;
+}
+
+void DataMailboxMemoryNetwork::setAttributes(const std::string& name, const mq_attr& attributes)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queues.at(name).m_attributes = attributes;
+	}
+
+	// A larger queue has room for waiting senders
+	m_changed.notify_all();
+}
+
+DataMailboxMemoryTransport::DataMailboxMemoryTransport(const std::string& name, DataMailboxMemoryNetwork& network, const mq_attr& attributes)
+	:	m_name(name), m_network(network), m_timeout{ 1, 0 }
+{
+	m_network.attach(m_name, attributes);
+}
+
+DataMailboxMemoryTransport::~DataMailboxMemoryTransport()
+{
+	m_network.detach(m_name);
+}
+
+void DataMailboxMemoryTransport::send(MailboxReference& destination, const char* data, size_t size)
+{
+	TransportBuffer frame{ data, size };
+	m_network.send(m_name, destination.getName(), &frame, 1);
+}
+
+void DataMailboxMemoryTransport::sendGather(MailboxReference& destination, const TransportBuffer* parts, size_t count)
+{
+	m_network.send(m_name, destination.getName(), parts, count);
+}
+
+TransportFrame DataMailboxMemoryTransport::receive(enuReceiveOptions options)
+{
+	return m_network.receive(m_name, options, DataMailboxTime::fromTimespec(m_timeout));
+}
+
+TransportFrame DataMailboxMemoryTransport::receiveFor(const struct timespec& timeout)
+{
+	return m_network.receive(m_name, enuReceiveOptions::TIMED, DataMailboxTime::fromTimespec(timeout));
+}
+
+mq_attr DataMailboxMemoryTransport::getAttributes()
+{
+	return m_network.getAttributes(m_name);
+}
+
+void DataMailboxMemoryTransport::setAttributes(const mq_attr& attributes)
+{
+	m_network.setAttributes(m_name, attributes);
+}
+
+DataMailboxTime::Clock::time_point DataMailboxMemoryTransport::now()
+{
+	return DataMailboxTime::Clock::time_point(std::chrono::duration_cast<DataMailboxTime::Clock::duration>(m_network.getTime()));
+}
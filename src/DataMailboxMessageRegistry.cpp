@@ -0,0 +1,151 @@
+#include "DataMailboxMessageRegistry.hpp"
+#include "DataMailboxRPC.hpp"
+
+#include "Kernel.hpp"
+
+void DataMailboxMessageRegistry::PoolReturn::operator()(ExtendedDataMailboxMessage* message) const
+{
+	DataMailboxMessageRegistry::getInstance().release(m_dataType, message);
+}
+
+DataMailboxMessageRegistry& DataMailboxMessageRegistry::getInstance()
+{
+	static DataMailboxMessageRegistry registry;
+	return registry;
+}
+
+DataMailboxMessageRegistry::DataMailboxMessageRegistry()
+{
+	// Messages made up by DataMailbox itself have a name but no class
+	for (MessageDataType dataType : { MessageDataType::NONE, MessageDataType::EmptyQueue, MessageDataType::TimedOut })
+	{
+		m_registrations[(unsigned char)dataType].m_name = getDataTypeName(dataType);
+		m_registrations[(unsigned char)dataType].m_registered.store(true, std::memory_order_release);
+	}
+
+	registerType<KeypadMessage_wPassword>(MessageDataType::KeypadMessage_wPassword, getDataTypeName(MessageDataType::KeypadMessage_wPassword));
+	registerType<KeypadMessage_wCommand>(MessageDataType::KeypadMessage_wCommand, getDataTypeName(MessageDataType::KeypadMessage_wCommand));
+	registerType<RFIDMessage>(MessageDataType::RFIDMessage, getDataTypeName(MessageDataType::RFIDMessage));
+	registerType<StringMessage>(MessageDataType::StringMessage, getDataTypeName(MessageDataType::StringMessage));
+	registerType<WatchdogMessage>(MessageDataType::WatchdogMessage, getDataTypeName(MessageDataType::WatchdogMessage));
+	registerType<RPCMessage>(MessageDataType::RPCMessage, getDataTypeName(MessageDataType::RPCMessage));
+}
+
+DataMailboxMessageRegistry::~DataMailboxMessageRegistry()
+{
+	for (Registration& registration : m_registrations)
+	{
+		for (ExtendedDataMailboxMessage* message : registration.m_pool)
+			delete message;
+	}
+}
+
+bool DataMailboxMessageRegistry::registerType(MessageDataType dataType, const std::string& name, Factory factory, size_t poolSize)
+{
+	if (!isValidCode(dataType) || factory == nullptr)
+	{
+		Kernel::Warning("Cannot register message type " + name + " with code " + std::to_string((int)dataType));
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Registration& registration = m_registrations[(unsigned char)dataType];
+
+	if (registration.m_registered.load(std::memory_order_relaxed))
+	{
+		Kernel::Warning("Message type code " + std::to_string((int)dataType) + " already registered as " + registration.m_name);
+		return false;
+	}
+
+	registration.m_name = name;
+	registration.m_factory = factory;
+	registration.m_poolSize = poolSize;
+
+	registration.m_pool.reserve(poolSize);
+	for (size_t i = 0; i < poolSize; i++)
+		registration.m_pool.push_back(factory());
+
+	// Publishes the name and factory to lookups without the lock
+	registration.m_registered.store(true, std::memory_order_release);
+
+	return true;
+}
+
+bool DataMailboxMessageRegistry::isRegistered(MessageDataType dataType) const
+{
+	if (!isValidCode(dataType))
+		return false;
+
+	return m_registrations[(unsigned char)dataType].m_registered.load(std::memory_order_acquire);
+}
+
+const char* DataMailboxMessageRegistry::getName(MessageDataType dataType) const
+{
+	if (!isValidCode(dataType))
+		return nullptr;
+
+	const Registration& registration = m_registrations[(unsigned char)dataType];
+
+	// Names never change once registered, so the pointer stays valid
+	return registration.m_registered.load(std::memory_order_acquire) ? registration.m_name.c_str() : nullptr;
+}
+
+DataMailboxMessageRegistry::MessagePtr DataMailboxMessageRegistry::create(MessageDataType dataType)
+{
+	if (!isValidCode(dataType))
+		return MessagePtr(nullptr, PoolReturn{ dataType });
+
+	Factory factory = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Registration& registration = m_registrations[(unsigned char)dataType];
+
+		if (!registration.m_pool.empty())
+		{
+			ExtendedDataMailboxMessage* message = registration.m_pool.back();
+			registration.m_pool.pop_back();
+
+			return MessagePtr(message, PoolReturn{ dataType });
+		}
+
+		factory = registration.m_factory;
+	}
+
+	if (factory == nullptr)
+		return MessagePtr(nullptr, PoolReturn{ dataType });
+
+	return MessagePtr(factory(), PoolReturn{ dataType });
+}
+
+DataMailboxMessageRegistry::MessagePtr DataMailboxMessageRegistry::unpack(BasicDataMailboxMessage& message)
+{
+	MessagePtr unpacked = create(message.getDataType());
+
+	if (unpacked)
+		unpacked->Unpack(message);
+
+	return unpacked;
+}
+
+void DataMailboxMessageRegistry::release(MessageDataType dataType, ExtendedDataMailboxMessage* message)
+{
+	if (message == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Registration& registration = m_registrations[(unsigned char)dataType];
+
+		if (registration.m_pool.size() < registration.m_poolSize)
+		{
+			registration.m_pool.push_back(message);
+			return;
+		}
+	}
+
+	delete message;
+}
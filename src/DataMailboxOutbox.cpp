@@ -0,0 +1,215 @@
+#include "DataMailboxOutbox.hpp"
+
+#include <functional>
+#include <utility>
+
+DataMailboxOutbox::DataMailboxOutbox(SendFunction sendFunction, size_t capacity, enuOutboxOverflowPolicy overflowPolicy, ILogger* pLogger)
+	:	m_sendFunction(sendFunction), m_capacity(capacity), m_overflowPolicy(overflowPolicy),
+	m_totalQueued(0), m_inFlight(0), m_stopping(false)
+{
+	if (pLogger == nullptr)
+		pLogger = NulLogger::getInstance();
+
+	m_pLogger = pLogger;
+
+	if (m_capacity == 0)
+		m_capacity = 1;
+}
+
+DataMailboxOutbox::~DataMailboxOutbox()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+
+	// Buffers are not added any more, so they can be walked without the lock
+	for (auto& buffer : m_buffers)
+		buffer.second.m_workAvailable.notify_all();
+
+	for (auto& buffer : m_buffers)
+		buffer.second.m_flusher.join();
+}
+
+DataMailboxOutbox::QueuedFrame DataMailboxOutbox::DestinationBuffer::popFront()
+{
+	QueuedFrame frame = std::move(m_frames.front());
+	m_frames.pop_front();
+
+	if (!frame.m_conflationKey.empty())
+		m_conflationIndex.erase(frame.m_conflationKey);
+
+	m_frontSequence++;
+	m_statistics.m_queued = m_frames.size();
+
+	return frame;
+}
+
+enuOutboxStatus DataMailboxOutbox::enqueue(const MailboxReference& destination, std::string frame, const std::string& conflationKey)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	DestinationBuffer& buffer = getBuffer(destination);
+
+	while (true)
+	{
+		if (!conflationKey.empty())
+		{
+			auto queued = buffer.m_conflationIndex.find(conflationKey);
+
+			if (queued != buffer.m_conflationIndex.end())
+			{
+				buffer.m_frames[queued->second - buffer.m_frontSequence].m_frame = std::move(frame);
+				buffer.m_statistics.m_conflated++;
+				return enuOutboxStatus::CONFLATED;
+			}
+		}
+
+		if (buffer.m_frames.size() < m_capacity || m_overflowPolicy != enuOutboxOverflowPolicy::BLOCK)
+			break;
+
+		// Another thread may queue a frame with the same key while this one waits, so the key is looked up again
+		m_spaceAvailable.wait(lock, [&]() { return buffer.m_frames.size() < m_capacity; });
+	}
+
+	enuOutboxStatus status = enuOutboxStatus::QUEUED;
+
+	if (buffer.m_frames.size() >= m_capacity)
+	{
+		switch (m_overflowPolicy)
+		{
+		case enuOutboxOverflowPolicy::DROP_OLDEST:
+			buffer.popFront();
+			m_totalQueued--;
+			buffer.m_statistics.m_droppedOldest++;
+			status = enuOutboxStatus::DROPPED_OLDEST;
+			break;
+
+		case enuOutboxOverflowPolicy::DROP_NEWEST:
+			buffer.m_statistics.m_droppedNewest++;
+			return enuOutboxStatus::DROPPED_NEWEST;
+
+		case enuOutboxOverflowPolicy::REJECT:
+		default:
+			buffer.m_statistics.m_rejected++;
+			return enuOutboxStatus::FULL;
+		}
+	}
+
+	if (!conflationKey.empty())
+		buffer.m_conflationIndex[conflationKey] = buffer.m_frontSequence + buffer.m_frames.size();
+
+	buffer.m_frames.push_back(QueuedFrame{ std::move(frame), conflationKey });
+	m_totalQueued++;
+
+	buffer.m_statistics.m_queued = buffer.m_frames.size();
+	if (buffer.m_statistics.m_queued > buffer.m_statistics.m_highestQueued)
+		buffer.m_statistics.m_highestQueued = buffer.m_statistics.m_queued;
+
+	lock.unlock();
+	buffer.m_workAvailable.notify_one();
+
+	return status;
+}
+
+DataMailboxOutbox::DestinationBuffer& DataMailboxOutbox::getBuffer(const MailboxReference& destination)
+{
+	auto found = m_buffers.find(destination.getName());
+
+	if (found != m_buffers.end())
+		return found->second;
+
+	DestinationBuffer& buffer = m_buffers[destination.getName()];
+
+	// Set only once, the flusher uses the reference without holding the lock
+	buffer.m_destination = destination;
+	buffer.m_flusher = std::thread(&DataMailboxOutbox::flusherLoop, this, std::ref(buffer));
+
+	return buffer;
+}
+
+void DataMailboxOutbox::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_drained.wait(lock, [this]() { return m_totalQueued == 0 && m_inFlight == 0; });
+}
+
+void DataMailboxOutbox::flush(const std::string& destinationName)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto buffer = m_buffers.find(destinationName);
+
+	if (buffer == m_buffers.end())
+		return;
+
+	m_drained.wait(lock, [&]() { return buffer->second.m_frames.empty() && !buffer->second.m_sending; });
+}
+
+OutboxStatistics DataMailboxOutbox::getStatistics(const std::string& destinationName)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto buffer = m_buffers.find(destinationName);
+
+	if (buffer == m_buffers.end())
+		return OutboxStatistics{};
+
+	return buffer->second.m_statistics;
+}
+
+OutboxStatistics DataMailboxOutbox::getTotalStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	OutboxStatistics total;
+
+	for (auto& buffer : m_buffers)
+	{
+		const OutboxStatistics& statistics = buffer.second.m_statistics;
+
+		total.m_queued += statistics.m_queued;
+		total.m_sent += statistics.m_sent;
+		total.m_droppedOldest += statistics.m_droppedOldest;
+		total.m_droppedNewest += statistics.m_droppedNewest;
+		total.m_rejected += statistics.m_rejected;
+		total.m_conflated += statistics.m_conflated;
+
+		if (statistics.m_highestQueued > total.m_highestQueued)
+			total.m_highestQueued = statistics.m_highestQueued;
+	}
+
+	return total;
+}
+
+void DataMailboxOutbox::flusherLoop(DestinationBuffer& buffer)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		buffer.m_workAvailable.wait(lock, [&]() { return m_stopping || !buffer.m_frames.empty(); });
+
+		if (buffer.m_frames.empty()) // stopping and drained
+			break;
+
+		QueuedFrame frame = buffer.popFront();
+		m_totalQueued--;
+		m_inFlight++;
+		buffer.m_sending = true;
+
+		lock.unlock();
+		m_spaceAvailable.notify_all();
+
+		// Blocks while the destination queue is full, frames for other destinations are sent by their own flushers
+		m_sendFunction(buffer.m_destination, frame.m_frame.data(), frame.m_frame.size());
+
+		lock.lock();
+		m_inFlight--;
+		buffer.m_sending = false;
+		buffer.m_statistics.m_sent++;
+
+		if (buffer.m_frames.empty())
+			m_drained.notify_all();
+	}
+}
@@ -0,0 +1,281 @@
+#include "DataMailboxRPC.hpp"
+
+#include "Kernel.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+RPCMessage::RPCMessage()
+	:	ExtendedDataMailboxMessage(MessageDataType::RPCMessage),
+	m_kind(REQUEST), m_correlationId(0), m_payload("")
+{
+
+}
+
+RPCMessage::RPCMessage(enuRPCKind kind, uint32_t correlationId, DataMailboxMessage* payload)
+	:	ExtendedDataMailboxMessage(MessageDataType::RPCMessage),
+	m_kind(kind), m_correlationId(correlationId), m_payload("")
+{
+	if (payload == nullptr)
+		return;
+
+	payload->Serialize();
+
+	m_payload = std::string(payload->m_serialized, payload->m_sizeOfSerializedData);
+
+	payload->deleteSerializedData();
+}
+
+void RPCMessage::Serialize()
+{
+	size_t kindOffset = sizeof(MessageDataType);
+	size_t correlationIdOffset = kindOffset + sizeof(m_kind);
+	size_t payloadOffset = correlationIdOffset + sizeof(m_correlationId);
+
+	size_t sizeOfSerializedData = payloadOffset + m_payload.length();
+
+	deleteAndReallocateSerializedData(sizeOfSerializedData);
+
+	memcpy(m_serialized, &m_dataType, sizeof(MessageDataType));
+	memcpy(m_serialized + kindOffset, &m_kind, sizeof(m_kind));
+	memcpy(m_serialized + correlationIdOffset, &m_correlationId, sizeof(m_correlationId));
+	memcpy(m_serialized + payloadOffset, m_payload.c_str(), m_payload.length());
+}
+
+bool RPCMessage::describeFrame(GatherFrame& frame)
+{
+	return frame.appendHeader(&m_dataType, sizeof(MessageDataType))
+		&& frame.appendHeader(&m_kind, sizeof(m_kind))
+		&& frame.appendHeader(&m_correlationId, sizeof(m_correlationId))
+		&& frame.appendPart(m_payload.data(), m_payload.length());
+}
+
+void RPCMessage::Deserialize()
+{
+	checkSerializedData();
+
+	size_t kindOffset = sizeof(MessageDataType);
+	size_t correlationIdOffset = kindOffset + sizeof(m_kind);
+	size_t payloadOffset = correlationIdOffset + sizeof(m_correlationId);
+
+	if (m_sizeOfSerializedData < payloadOffset)
+	{
+		Kernel::Warning("RPCMessage too short: " + std::to_string(m_sizeOfSerializedData) + " bytes");
+		m_payload = "";
+		return;
+	}
+
+	memcpy(&m_kind, m_serialized + kindOffset, sizeof(m_kind));
+	memcpy(&m_correlationId, m_serialized + correlationIdOffset, sizeof(m_correlationId));
+
+	m_payload = std::string(m_serialized + payloadOffset, m_sizeOfSerializedData - payloadOffset);
+}
+
+std::string RPCMessage::getInfo()
+{
+	return std::string("RPCMessage - Kind: ") + (m_kind == REQUEST ? "REQUEST" : "REPLY")
+		+ " CorrelationId: " + std::to_string(m_correlationId)
+		+ " Payload size: " + std::to_string(m_payload.length());
+}
+
+size_t RPCMessage::formatInfo(char* buffer, size_t size)
+{
+	int length = snprintf(buffer, size, "RPCMessage - Kind: %s CorrelationId: %u Payload size: %u",
+		m_kind == REQUEST ? "REQUEST" : "REPLY", (unsigned int)m_correlationId, (unsigned int)m_payload.length());
+
+	if (length < 0 || size == 0)
+		return 0;
+
+	return std::min((size_t)length, size - 1);
+}
+
+BasicDataMailboxMessage RPCMessage::getPayload()
+{
+	if (m_payload.empty())
+		return BasicDataMailboxMessage(MessageDataType::NONE, m_source);
+
+	char* pData = new char[m_payload.length()];
+	memcpy(pData, m_payload.c_str(), m_payload.length());
+
+	BasicDataMailboxMessage payload;
+	payload.setSerializedData(pData, m_payload.length());
+	payload.setSource(m_source);
+	payload.decodeMessageDataType();
+
+	return payload;
+}
+
+
+
+DataMailboxRPC::DataMailboxRPC(DataMailbox& mailbox, ILogger* pLogger)
+	:	m_mailbox(mailbox), m_nextCorrelationId(1)
+{
+	if (pLogger == nullptr)
+		pLogger = NulLogger::getInstance();
+
+	m_pLogger = pLogger;
+}
+
+DataMailboxRPC::~DataMailboxRPC()
+{
+	if (!m_pending.empty())
+		*m_pLogger << "DataMailboxRPC destroyed with " + std::to_string(m_pending.size()) + " pending requests";
+}
+
+DataMailboxRPC::CorrelationId DataMailboxRPC::call(MailboxReference& destination, DataMailboxMessage* request, const struct timespec& timeout, ReplyCallback callback)
+{
+	CorrelationId correlationId = m_nextCorrelationId++;
+
+	if (m_nextCorrelationId == 0) // 0 is never used so it can mean "no request"
+		m_nextCorrelationId = 1;
+
+	RPCMessage envelope(RPCMessage::REQUEST, correlationId, request);
+
+	Clock::time_point deadline = m_mailbox.getTime() + DataMailboxTime::fromTimespec(timeout);
+
+	PendingCall& pending = m_pending[correlationId];
+	pending.m_callback = std::move(callback);
+	pending.m_destination = destination;
+	pending.m_deadline = m_deadlines.emplace(deadline, correlationId);
+
+	*m_pLogger << "RPC request " + std::to_string(correlationId) + " to - " + destination.getName();
+
+	m_mailbox.send(destination, &envelope);
+
+	return correlationId;
+}
+
+std::future<BasicDataMailboxMessage> DataMailboxRPC::call(MailboxReference& destination, DataMailboxMessage* request, const struct timespec& timeout)
+{
+	std::shared_ptr<std::promise<BasicDataMailboxMessage>> pPromise = std::make_shared<std::promise<BasicDataMailboxMessage>>();
+
+	call(destination, request, timeout, [pPromise](BasicDataMailboxMessage& reply)
+	{
+		pPromise->set_value(std::move(reply));
+	});
+
+	return pPromise->get_future();
+}
+
+bool DataMailboxRPC::cancel(CorrelationId correlationId)
+{
+	auto pending = m_pending.find(correlationId);
+
+	if (pending == m_pending.end())
+		return false;
+
+	m_deadlines.erase(pending->second.m_deadline);
+	m_pending.erase(pending);
+
+	return true;
+}
+
+void DataMailboxRPC::reply(RPCMessage& request, DataMailboxMessage* response)
+{
+	RPCMessage envelope(RPCMessage::REPLY, request.getCorrelationId(), response);
+
+	*m_pLogger << "RPC reply " + std::to_string(request.getCorrelationId()) + " to - " + request.getSource().getName();
+
+	m_mailbox.send(request.getSource(), &envelope);
+}
+
+void DataMailboxRPC::expireCalls(Clock::time_point now)
+{
+	while (!m_deadlines.empty() && m_deadlines.begin()->first <= now)
+	{
+		CorrelationId correlationId = m_deadlines.begin()->second;
+		m_deadlines.erase(m_deadlines.begin());
+
+		auto pending = m_pending.find(correlationId);
+		ReplyCallback callback = std::move(pending->second.m_callback);
+		BasicDataMailboxMessage timedOut(MessageDataType::TimedOut, pending->second.m_destination);
+		m_pending.erase(pending);
+
+		*m_pLogger << "RPC request " + std::to_string(correlationId) + " timed out";
+
+		// Erased before the call so the callback can issue new requests
+		callback(timedOut);
+	}
+}
+
+void DataMailboxRPC::dispatchReply(RPCMessage& reply)
+{
+	auto pending = m_pending.find(reply.getCorrelationId());
+
+	if (pending == m_pending.end())
+	{
+		*m_pLogger << "RPC reply " + std::to_string(reply.getCorrelationId()) + " has no pending request - dropped";
+		return;
+	}
+
+	ReplyCallback callback = std::move(pending->second.m_callback);
+	m_deadlines.erase(pending->second.m_deadline);
+	m_pending.erase(pending);
+
+	BasicDataMailboxMessage payload = reply.getPayload();
+	callback(payload);
+}
+
+BasicDataMailboxMessage DataMailboxRPC::receiveUntil(Clock::time_point deadline)
+{
+	Clock::time_point now = m_mailbox.getTime();
+
+	if (deadline <= now)
+		return BasicDataMailboxMessage(MessageDataType::TimedOut, MailboxReference{});
+
+	return m_mailbox.receive(DataMailboxTime::toTimespec(deadline - now));
+}
+
+BasicDataMailboxMessage DataMailboxRPC::receive(enuReceiveOptions options)
+{
+	const bool nonblocking = options % enuReceiveOptions::NONBLOCKING;
+	const bool timed = options % enuReceiveOptions::TIMED;
+
+	Clock::time_point receiveDeadline = Clock::time_point::max();
+
+	if (timed)
+		receiveDeadline = m_mailbox.getTime() + DataMailboxTime::fromTimespec(m_mailbox.getTimeout_settings());
+
+	while (true)
+	{
+		expireCalls(m_mailbox.getTime());
+
+		BasicDataMailboxMessage message;
+
+		if (nonblocking)
+		{
+			message = m_mailbox.receive(enuReceiveOptions::NONBLOCKING);
+		}
+		else
+		{
+			Clock::time_point deadline = receiveDeadline;
+
+			if (!m_deadlines.empty() && m_deadlines.begin()->first < deadline)
+				deadline = m_deadlines.begin()->first;
+
+			if (deadline == Clock::time_point::max())
+				message = m_mailbox.receive(enuReceiveOptions::NORMAL);
+			else
+				message = receiveUntil(deadline);
+		}
+
+		if (message.getDataType() == MessageDataType::RPCMessage
+			&& message.getRawDataSize() > (int)sizeof(MessageDataType)
+			&& message.getRawDataPointer()[sizeof(MessageDataType)] == RPCMessage::REPLY)
+		{
+			RPCMessage reply;
+			reply.Unpack(message);
+			dispatchReply(reply);
+			continue;
+		}
+
+		// Woke up to expire a request, not because the caller's timeout passed. Expired timers go to the caller.
+		if (message.getDataType() == MessageDataType::TimedOut && message.getTimerId() == 0 && m_mailbox.getTime() < receiveDeadline)
+			continue;
+
+		return message;
+	}
+}
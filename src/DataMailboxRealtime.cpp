@@ -0,0 +1,162 @@
+#include "DataMailboxRealtime.hpp"
+
+#include <algorithm>
+#include <alloca.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+	RealtimeSettingResult applied(const std::string& detail)
+	{
+		RealtimeSettingResult result;
+		result.m_status = enuRealtimeStatus::APPLIED;
+		result.m_detail = detail;
+		return result;
+	}
+
+	RealtimeSettingResult failed(int error)
+	{
+		RealtimeSettingResult result;
+		result.m_status = enuRealtimeStatus::FAILED;
+		result.m_detail = strerror(error);
+		return result;
+	}
+
+	std::string describe(const char* name, const RealtimeSettingResult& result)
+	{
+		std::string text = std::string(name) + ": ";
+
+		switch (result.m_status)
+		{
+		case enuRealtimeStatus::NOT_REQUESTED:
+			return text + "off";
+		case enuRealtimeStatus::APPLIED:
+			return text + result.m_detail;
+		default:
+			return text + "FAILED (" + result.m_detail + ")";
+		}
+	}
+
+	RealtimeSettingResult setAffinity(const std::vector<int>& cpus)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+
+		std::string detail = "CPUs ";
+
+		for (int cpu : cpus)
+		{
+			if (cpu < 0 || cpu >= CPU_SETSIZE)
+				return failed(EINVAL);
+
+			CPU_SET(cpu, &set);
+			detail += (detail.length() > 5 ? "," : "") + std::to_string(cpu);
+		}
+
+		int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+		return error == 0 ? applied(detail) : failed(error);
+	}
+
+	RealtimeSettingResult setScheduling(int priority)
+	{
+		struct sched_param parameters;
+		memset(&parameters, 0, sizeof(parameters));
+		parameters.sched_priority = priority;
+
+		int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+
+		return error == 0 ? applied("SCHED_FIFO " + std::to_string(priority)) : failed(error);
+	}
+
+	/// Touches `size` bytes below the current stack frame, at most half of the thread's stack
+	size_t prefaultStack(size_t size)
+	{
+		pthread_attr_t attributes;
+		size_t stackSize = 0;
+
+		if (pthread_getattr_np(pthread_self(), &attributes) == 0)
+		{
+			pthread_attr_getstacksize(&attributes, &stackSize);
+			pthread_attr_destroy(&attributes);
+		}
+
+		size = std::min(size, stackSize / 2);
+
+		if (size == 0)
+			return 0;
+
+		volatile char* pStack = static_cast<volatile char*>(alloca(size));
+
+		for (size_t i = 0; i < size; i += sysconf(_SC_PAGESIZE))
+			pStack[i] = 0;
+
+		return size;
+	}
+
+	void prefaultHeap(size_t size)
+	{
+		// Freed memory stays in the heap, and large blocks come from it too instead of separate mappings
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+
+		char* pHeap = static_cast<char*>(malloc(size));
+
+		if (pHeap == nullptr)
+			return;
+
+		for (size_t i = 0; i < size; i += sysconf(_SC_PAGESIZE))
+			pHeap[i] = 0;
+
+		free(pHeap);
+	}
+}
+
+bool RealtimeReport::isComplete() const
+{
+	return m_affinity.m_status != enuRealtimeStatus::FAILED && m_scheduling.m_status != enuRealtimeStatus::FAILED
+		&& m_memoryLock.m_status != enuRealtimeStatus::FAILED && m_prefault.m_status != enuRealtimeStatus::FAILED;
+}
+
+std::string RealtimeReport::toString() const
+{
+	return describe("affinity", m_affinity) + " | " + describe("scheduling", m_scheduling) + " | "
+		+ describe("memory lock", m_memoryLock) + " | " + describe("prefault", m_prefault);
+}
+
+RealtimeReport DataMailboxRealtime::applyToCurrentThread(const RealtimeSettings& settings)
+{
+	RealtimeReport report;
+
+	if (!settings.m_cpus.empty())
+		report.m_affinity = setAffinity(settings.m_cpus);
+
+	if (settings.m_priority > 0)
+		report.m_scheduling = setScheduling(settings.m_priority);
+
+	if (settings.m_lockMemory)
+	{
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+			report.m_memoryLock = applied("all current and future memory");
+		else
+			report.m_memoryLock = failed(errno);
+	}
+
+	if (settings.m_prefaultStack > 0 || settings.m_prefaultHeap > 0)
+	{
+		size_t stack = prefaultStack(settings.m_prefaultStack);
+		prefaultHeap(settings.m_prefaultHeap);
+
+		report.m_prefault = applied(std::to_string(stack / 1024) + " KiB stack, " + std::to_string(settings.m_prefaultHeap / 1024) + " KiB heap");
+	}
+
+	return report;
+}
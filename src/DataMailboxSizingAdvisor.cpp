@@ -0,0 +1,167 @@
+#include "DataMailboxSizingAdvisor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+/// Linux keeps at most this many priority tree nodes per queue (MQ_PRIO_MAX)
+static const long KERNEL_PRIORITY_LEVELS = 32768;
+
+/// struct msg_msg and struct posix_msg_tree_node of Linux
+static const size_t KERNEL_MESSAGE_SIZE = 6 * sizeof(void*);
+static const size_t KERNEL_PRIORITY_NODE_SIZE = 6 * sizeof(void*);
+
+/// Smallest index `i` such that buckets 0..i hold at least `fraction` of `total`
+static size_t getPercentileIndex(const std::vector<unsigned long long>& buckets, unsigned long long total, double fraction)
+{
+	unsigned long long target = (unsigned long long)std::ceil(total * fraction);
+	unsigned long long sum = 0;
+
+	for (size_t i = 0; i < buckets.size(); i++)
+	{
+		sum += buckets[i];
+
+		if (sum >= target)
+			return i;
+	}
+
+	return buckets.empty() ? 0 : buckets.size() - 1;
+}
+
+DataMailboxSizingAdvisor::DataMailboxSizingAdvisor(const SizingOptions& options)
+	:	m_options(options), m_frameCount(0), m_largestFrame(0), m_depthSampleCount(0), m_framesUntilSample(0)
+{
+	m_options.m_depthSampleInterval = std::max(1u, m_options.m_depthSampleInterval);
+}
+
+void DataMailboxSizingAdvisor::recordFrame(size_t size)
+{
+	size_t bucket = size / MSGSIZE_GRANULARITY;
+
+	if (bucket >= m_frameSizes.size())
+		m_frameSizes.resize(bucket + 1);
+
+	m_frameSizes[bucket]++;
+	m_frameCount++;
+	m_largestFrame = std::max(m_largestFrame, size);
+}
+
+bool DataMailboxSizingAdvisor::isDepthSampleDue()
+{
+	if (m_framesUntilSample > 0)
+	{
+		m_framesUntilSample--;
+		return false;
+	}
+
+	m_framesUntilSample = m_options.m_depthSampleInterval - 1;
+
+	return true;
+}
+
+void DataMailboxSizingAdvisor::recordDepth(long depth)
+{
+	size_t index = (size_t)std::max(0L, depth);
+
+	if (index >= m_depths.size())
+		m_depths.resize(index + 1);
+
+	m_depths[index]++;
+	m_depthSampleCount++;
+}
+
+SizingRecommendation DataMailboxSizingAdvisor::recommend(const mq_attr& current) const
+{
+	SizingRecommendation recommendation;
+
+	recommendation.m_current = current;
+	recommendation.m_recommended = current;
+	recommendation.m_frames = m_frameCount;
+	recommendation.m_largestFrame = m_largestFrame;
+	recommendation.m_depthSamples = m_depthSampleCount;
+	recommendation.m_currentBytes = estimateKernelMemory(current);
+	recommendation.m_recommendedBytes = recommendation.m_currentBytes;
+
+	if (m_frameCount > 0)
+		recommendation.m_frameP99 = std::min(m_largestFrame, (getPercentileIndex(m_frameSizes, m_frameCount, 0.99) + 1) * MSGSIZE_GRANULARITY - 1);
+
+	if (m_depthSampleCount > 0)
+	{
+		recommendation.m_depthP50 = (long)getPercentileIndex(m_depths, m_depthSampleCount, 0.50);
+		recommendation.m_depthP99 = (long)getPercentileIndex(m_depths, m_depthSampleCount, 0.99);
+		recommendation.m_largestDepth = (long)m_depths.size() - 1;
+	}
+
+	if (m_frameCount < m_options.m_minimumFrames)
+		return recommendation;
+
+	recommendation.m_valid = true;
+
+	size_t msgsize = (size_t)std::ceil((m_largestFrame + m_options.m_frameOverhead) * (1 + m_options.m_sizeHeadroom));
+	recommendation.m_recommended.mq_msgsize = (long)(std::max<size_t>(1, (msgsize + MSGSIZE_GRANULARITY - 1) / MSGSIZE_GRANULARITY) * MSGSIZE_GRANULARITY);
+
+	// Transports without a depth limit (mq_maxmsg 0) keep it
+	if (current.mq_maxmsg > 0 && m_depthSampleCount > 0)
+	{
+		unsigned long long full = 0;
+
+		for (size_t depth = (size_t)current.mq_maxmsg; depth < m_depths.size(); depth++)
+			full += m_depths[depth];
+
+		recommendation.m_observedBlocking = (double)full / m_depthSampleCount;
+
+		if (recommendation.m_observedBlocking > m_options.m_blockingProbability)
+		{
+			recommendation.m_saturated = true;
+			recommendation.m_recommended.mq_maxmsg = current.mq_maxmsg * 2;
+		}
+		else
+		{
+			// Smallest depth reached (or exceeded) by no more than the allowed fraction of samples
+			unsigned long long allowed = (unsigned long long)(m_options.m_blockingProbability * m_depthSampleCount);
+			unsigned long long atOrAbove = 0;
+			size_t maxmsg = m_depths.size();
+
+			while (maxmsg > 1 && atOrAbove + m_depths[maxmsg - 1] <= allowed)
+				atOrAbove += m_depths[--maxmsg];
+
+			recommendation.m_recommended.mq_maxmsg = (long)maxmsg;
+		}
+	}
+
+	recommendation.m_recommendedBytes = estimateKernelMemory(recommendation.m_recommended);
+
+	return recommendation;
+}
+
+size_t DataMailboxSizingAdvisor::estimateKernelMemory(const mq_attr& attributes)
+{
+	size_t maxmsg = (size_t)std::max(0L, attributes.mq_maxmsg);
+	size_t msgsize = (size_t)std::max(0L, attributes.mq_msgsize);
+
+	return maxmsg * (KERNEL_MESSAGE_SIZE + msgsize) + (size_t)std::min<long>((long)maxmsg, KERNEL_PRIORITY_LEVELS) * KERNEL_PRIORITY_NODE_SIZE;
+}
+
+std::string SizingRecommendation::toString() const
+{
+	char text[512];
+
+	int length = snprintf(text, sizeof(text), "frames %llu (largest %zu B, p99 %zu B) | depth p50 %ld p99 %ld max %ld of %ld, full %.2f%%%s | ",
+		m_frames, m_largestFrame, m_frameP99, m_depthP50, m_depthP99, m_largestDepth, m_current.mq_maxmsg, 100 * m_observedBlocking,
+		m_saturated ? " (saturated)" : "");
+
+	if (!m_valid)
+	{
+		snprintf(text + length, sizeof(text) - length, "too few frames for a recommendation");
+		return text;
+	}
+
+	long saved = (long)m_currentBytes - (long)m_recommendedBytes;
+
+	snprintf(text + length, sizeof(text) - length, "maxmsg %ld msgsize %ld (%zu KiB) -> maxmsg %ld msgsize %ld (%zu KiB), %s %ld KiB",
+		m_current.mq_maxmsg, m_current.mq_msgsize, m_currentBytes / 1024, m_recommended.mq_maxmsg, m_recommended.mq_msgsize,
+		m_recommendedBytes / 1024, saved >= 0 ? "saves" : "costs", std::labs(saved) / 1024);
+
+	return text;
+}
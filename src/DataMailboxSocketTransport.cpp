@@ -0,0 +1,460 @@
+#include "DataMailboxSocketTransport.hpp"
+#include "DataMailboxTime.hpp"
+
+#include "Kernel.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const char* const DataMailboxSocketTransport::DEFAULT_DIRECTORY = "/tmp/datamailbox";
+const size_t DataMailboxSocketTransport::DEFAULT_MAX_FRAME_SIZE;
+const size_t DataMailboxSocketTransport::BATCH_SIZE;
+
+/// Returns false if `path` does not fit into sockaddr_un
+static bool makeAddress(const std::string& path, struct sockaddr_un& address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+
+	if (path.length() >= sizeof(address.sun_path))
+		return false;
+
+	memcpy(address.sun_path, path.c_str(), path.length());
+
+	return true;
+}
+
+std::string DataMailboxSocketTransport::getSocketPath(const std::string& directory, const std::string& name)
+{
+	return directory + "/" + name + ".sock";
+}
+
+DataMailboxSocketTransport::DataMailboxSocketTransport(const std::string& name, const std::string& directory, size_t maxFrameSize)
+	:	m_name(name), m_directory(directory), m_path(getSocketPath(directory, name)), m_maxFrameSize(maxFrameSize),
+	m_listenFd(-1), m_timeout{ 1, 0 }, m_receiveBuffer(BATCH_SIZE * maxFrameSize)
+{
+	mkdir(m_directory.c_str(), 0777); // usually exists already
+
+	struct sockaddr_un address;
+	if (!makeAddress(m_path, address))
+		Kernel::Fatal_Error("Socket path too long: " + m_path);
+
+	m_listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (m_listenFd < 0)
+		Kernel::Fatal_Error("Cannot create socket: " + std::string(strerror(errno)));
+
+	int result = bind(m_listenFd, (struct sockaddr*)&address, sizeof(address));
+
+	if (result != 0 && errno == EADDRINUSE)
+	{
+		// Left by a crashed process, unless somebody still accepts connections on it
+		int probeFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+		bool inUse = probeFd >= 0 && connect(probeFd, (struct sockaddr*)&address, sizeof(address)) == 0;
+
+		if (probeFd >= 0)
+			close(probeFd);
+
+		if (inUse)
+			Kernel::Fatal_Error("Mailbox name already in use: " + m_path);
+
+		unlink(m_path.c_str());
+
+		result = bind(m_listenFd, (struct sockaddr*)&address, sizeof(address));
+	}
+
+	if (result != 0)
+		Kernel::Fatal_Error("Cannot bind socket " + m_path + ": " + strerror(errno));
+
+	if (listen(m_listenFd, SOMAXCONN) != 0)
+		Kernel::Fatal_Error("Cannot listen on socket " + m_path + ": " + strerror(errno));
+}
+
+DataMailboxSocketTransport::~DataMailboxSocketTransport()
+{
+	close(m_listenFd);
+	unlink(m_path.c_str());
+
+	for (InboundConnection& connection : m_connections)
+		close(connection.m_fd);
+
+	for (TransportFrame& frame : m_received)
+		delete[] frame.m_pData;
+}
+
+void DataMailboxSocketTransport::send(MailboxReference& destination, const char* data, size_t size)
+{
+	TransportBuffer frame{ data, size };
+	sendAs(m_name, destination, &frame, 1);
+}
+
+void DataMailboxSocketTransport::sendBatch(MailboxReference& destination, const TransportBuffer* frames, size_t count)
+{
+	sendAs(m_name, destination, frames, count);
+}
+
+void DataMailboxSocketTransport::sendGather(MailboxReference& destination, const TransportBuffer* parts, size_t count)
+{
+	if (count > MAX_GATHER_PARTS)
+	{
+		DataMailboxTransport::sendGather(destination, parts, count);
+		return;
+	}
+
+	struct mmsghdr message;
+	struct iovec vectors[MAX_GATHER_PARTS];
+
+	// One SEQPACKET record from all the parts, the kernel gathers them
+	for (size_t i = 0; i < count; i++)
+	{
+		vectors[i].iov_base = const_cast<char*>(parts[i].m_pData);
+		vectors[i].iov_len = parts[i].m_size;
+	}
+
+	memset(&message, 0, sizeof(message));
+	message.msg_hdr.msg_iov = vectors;
+	message.msg_hdr.msg_iovlen = count;
+
+	sendMessages(m_name, destination.getName(), &message, 1);
+}
+
+void DataMailboxSocketTransport::sendAs(const std::string& source, MailboxReference& destination, const TransportBuffer* frames, size_t count)
+{
+	const std::string destinationName = destination.getName();
+
+	struct mmsghdr messages[BATCH_SIZE];
+	struct iovec vectors[BATCH_SIZE];
+
+	for (size_t sent = 0; sent < count; )
+	{
+		size_t batch = std::min(count - sent, BATCH_SIZE);
+
+		for (size_t i = 0; i < batch; i++)
+		{
+			vectors[i].iov_base = const_cast<char*>(frames[sent + i].m_pData);
+			vectors[i].iov_len = frames[sent + i].m_size;
+
+			memset(&messages[i], 0, sizeof(messages[i]));
+			messages[i].msg_hdr.msg_iov = &vectors[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		if (!sendMessages(source, destinationName, messages, batch))
+			return;
+
+		sent += batch;
+	}
+}
+
+bool DataMailboxSocketTransport::sendMessages(const std::string& source, const std::string& destination, struct mmsghdr* messages, size_t count)
+{
+	size_t sent = 0;
+	bool reconnected = false;
+
+	while (sent < count)
+	{
+		OutboundConnectionPtr connection;
+
+		// Senders share the connection, SEQPACKET keeps every message whole. The copy keeps it open while sending unlocked.
+		{
+			std::shared_lock<std::shared_timed_mutex> lock(m_outboundMutex);
+			connection = findOutboundConnection(source, destination);
+		}
+
+		if (!connection)
+		{
+			std::lock_guard<std::shared_timed_mutex> lock(m_outboundMutex);
+
+			if (!findOutboundConnection(source, destination) && !connectOutbound(source, destination))
+			{
+				Kernel::Warning("Cannot connect to mailbox: " + getSocketPath(m_directory, destination));
+				return false;
+			}
+
+			continue;
+		}
+
+		int result = sendmmsg(connection->m_fd, messages + sent, count - sent, MSG_NOSIGNAL);
+		int error = errno;
+
+		if (result >= 0)
+		{
+			sent += result;
+			continue;
+		}
+
+		if (error == EINTR)
+			continue;
+
+		{
+			std::lock_guard<std::shared_timed_mutex> lock(m_outboundMutex);
+
+			// Another sender may have replaced the broken connection already. It is closed when its last sender releases it.
+			if (findOutboundConnection(source, destination) == connection)
+				m_outbound[source].erase(destination);
+		}
+
+		// The receiver restarted since the connection was made - connect to the new one, once
+		if (reconnected || (error != EPIPE && error != ECONNRESET && error != ENOTCONN))
+		{
+			Kernel::Warning("Cannot send to mailbox " + destination + ": " + strerror(error));
+			return false;
+		}
+
+		reconnected = true;
+	}
+
+	return true;
+}
+
+DataMailboxSocketTransport::OutboundConnection::~OutboundConnection()
+{
+	close(m_fd);
+}
+
+DataMailboxSocketTransport::OutboundConnectionPtr DataMailboxSocketTransport::findOutboundConnection(const std::string& source, const std::string& destination) const
+{
+	auto connections = m_outbound.find(source);
+	if (connections == m_outbound.end())
+		return nullptr;
+
+	auto connection = connections->second.find(destination);
+	if (connection == connections->second.end())
+		return nullptr;
+
+	return connection->second;
+}
+
+bool DataMailboxSocketTransport::connectOutbound(const std::string& source, const std::string& destination)
+{
+	int fd = connectTo(source, destination);
+
+	if (fd < 0)
+		return false;
+
+	m_outbound[source][destination] = std::make_shared<OutboundConnection>(fd);
+
+	return true;
+}
+
+int DataMailboxSocketTransport::connectTo(const std::string& source, const std::string& destination)
+{
+	struct sockaddr_un address;
+	if (!makeAddress(getSocketPath(m_directory, destination), address))
+		return -1;
+
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0
+		|| ::send(fd, source.c_str(), source.length(), MSG_NOSIGNAL) != (ssize_t)source.length())
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+TransportFrame DataMailboxSocketTransport::receive(enuReceiveOptions options)
+{
+	static const struct timespec noWait{ 0, 0 };
+
+	if (m_received.empty())
+	{
+		if (options % enuReceiveOptions::NONBLOCKING)
+			fetch(&noWait);
+		else if (options % enuReceiveOptions::TIMED)
+			fetch(&m_timeout);
+		else
+			fetch(nullptr);
+	}
+
+	return takeReceived((options % enuReceiveOptions::NONBLOCKING) ? enuMessageType::EMPTY : enuMessageType::TIMED_OUT);
+}
+
+TransportFrame DataMailboxSocketTransport::receiveFor(const struct timespec& timeout)
+{
+	if (m_received.empty())
+		fetch(&timeout);
+
+	return takeReceived(enuMessageType::TIMED_OUT);
+}
+
+TransportFrame DataMailboxSocketTransport::takeReceived(enuMessageType emptyType)
+{
+	if (m_received.empty())
+	{
+		TransportFrame frame;
+		frame.m_type = emptyType;
+		return frame;
+	}
+
+	TransportFrame frame = std::move(m_received.front());
+	m_received.pop_front();
+
+	return frame;
+}
+
+void DataMailboxSocketTransport::fetch(const struct timespec* pTimeout)
+{
+	DataMailboxTime::Clock::time_point deadline;
+
+	if (pTimeout != nullptr)
+		deadline = DataMailboxTime::Clock::now() + DataMailboxTime::fromTimespec(*pTimeout);
+
+	while (m_received.empty())
+	{
+		m_pollFds.clear();
+		m_pollFds.push_back(pollfd{ m_listenFd, POLLIN, 0 });
+
+		for (InboundConnection& connection : m_connections)
+			m_pollFds.push_back(pollfd{ connection.m_fd, POLLIN, 0 });
+
+		struct timespec remaining;
+
+		if (pTimeout != nullptr)
+		{
+			DataMailboxTime::Clock::time_point now = DataMailboxTime::Clock::now();
+			remaining = DataMailboxTime::toTimespec(now < deadline ? deadline - now : DataMailboxTime::Clock::duration::zero());
+		}
+
+		int ready = ppoll(m_pollFds.data(), m_pollFds.size(), pTimeout != nullptr ? &remaining : nullptr, nullptr);
+
+		if (ready < 0 && errno != EINTR)
+		{
+			Kernel::Warning(m_name + " - poll failed: " + strerror(errno));
+			return;
+		}
+
+		if (ready > 0)
+		{
+			// Backwards, so closed connections can be erased
+			for (size_t i = m_connections.size(); i-- > 0; )
+			{
+				if (m_pollFds[i + 1].revents == 0)
+					continue;
+
+				if (!readConnection(m_connections[i]))
+				{
+					close(m_connections[i].m_fd);
+					m_connections.erase(m_connections.begin() + i);
+				}
+			}
+
+			if (m_pollFds[0].revents & POLLIN)
+				acceptConnections();
+		}
+
+		if (pTimeout != nullptr && DataMailboxTime::Clock::now() >= deadline)
+			return;
+	}
+}
+
+void DataMailboxSocketTransport::acceptConnections()
+{
+	while (true)
+	{
+		int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+
+		if (fd < 0)
+			return;
+
+		InboundConnection connection{ fd, std::string() };
+
+		// A new sender usually has its introduction and first frames waiting already
+		if (!readConnection(connection))
+		{
+			close(fd);
+			continue;
+		}
+
+		m_connections.push_back(std::move(connection));
+	}
+}
+
+bool DataMailboxSocketTransport::readConnection(InboundConnection& connection)
+{
+	struct mmsghdr messages[BATCH_SIZE];
+	struct iovec vectors[BATCH_SIZE];
+
+	for (size_t i = 0; i < BATCH_SIZE; i++)
+	{
+		vectors[i].iov_base = &m_receiveBuffer[i * m_maxFrameSize];
+		vectors[i].iov_len = m_maxFrameSize;
+
+		memset(&messages[i], 0, sizeof(messages[i]));
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int count = recvmmsg(connection.m_fd, messages, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+
+	if (count < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+	for (int i = 0; i < count; i++)
+	{
+		size_t size = messages[i].msg_len;
+		const char* pData = &m_receiveBuffer[i * m_maxFrameSize];
+
+		// Frames are never empty, so an empty message is the end of the connection
+		if (size == 0)
+			return false;
+
+		if (messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+		{
+			Kernel::Warning(m_name + " - dropped frame larger than " + std::to_string(m_maxFrameSize) + " bytes from - " + connection.m_source);
+			continue;
+		}
+
+		if (connection.m_source.empty())
+		{
+			connection.m_source.assign(pData, size);
+			continue;
+		}
+
+		TransportFrame frame;
+		frame.m_type = enuMessageType::DATA;
+		frame.m_pData = new char[size];
+		frame.m_size = size;
+		frame.m_source = connection.m_source;
+
+		memcpy(frame.m_pData, pData, size);
+
+		m_received.push_back(std::move(frame));
+	}
+
+	return true;
+}
+
+mq_attr DataMailboxSocketTransport::getAttributes()
+{
+	static const struct timespec noWait{ 0, 0 };
+
+	if (m_received.empty())
+		fetch(&noWait);
+
+	mq_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+
+	attributes.mq_msgsize = m_maxFrameSize;
+	attributes.mq_curmsgs = m_received.size();
+
+	return attributes;
+}
+
+void DataMailboxSocketTransport::setAttributes(const mq_attr& attributes)
+{
+	if (attributes.mq_msgsize <= 0)
+		return;
+
+	m_maxFrameSize = attributes.mq_msgsize;
+	m_receiveBuffer.resize(BATCH_SIZE * m_maxFrameSize);
+}
@@ -0,0 +1,239 @@
+#include "DataMailboxTimerWheel.hpp"
+
+#include <algorithm>
+
+const uint32_t DataMailboxTimerWheel::NIL;
+
+DataMailboxTimerWheel::DataMailboxTimerWheel(std::chrono::nanoseconds resolution, DataMailboxTime::Clock::time_point start)
+	:	m_resolution(resolution), m_start(start),
+	m_currentTick(0), m_activeCount(0),
+	m_freeList(NIL)
+{
+	if (m_resolution.count() <= 0)
+		m_resolution = std::chrono::milliseconds(1);
+
+	m_slots.fill(NIL);
+	m_levelCounts.fill(0);
+}
+
+uint64_t DataMailboxTimerWheel::toTick(DataMailboxTime::Clock::time_point time) const
+{
+	if (time <= m_start)
+		return 0;
+
+	return (time - m_start) / m_resolution;
+}
+
+DataMailboxTime::Clock::time_point DataMailboxTimerWheel::toTime(uint64_t tick) const
+{
+	return m_start + std::chrono::duration_cast<DataMailboxTime::Clock::duration>(m_resolution * tick);
+}
+
+DataMailboxTimerWheel::TimerId DataMailboxTimerWheel::schedule(std::chrono::nanoseconds delay, DataMailboxTime::Clock::time_point now)
+{
+	// The tick moves only while timers are active, after an idle period it is behind `now`
+	if (m_activeCount == 0)
+		m_currentTick = std::max(m_currentTick, toTick(now));
+
+	uint32_t nodeIndex = m_freeList;
+
+	if (nodeIndex != NIL)
+	{
+		m_freeList = m_nodes[nodeIndex].m_next;
+	}
+	else
+	{
+		nodeIndex = m_nodes.size();
+		m_nodes.push_back(TimerNode{ NIL, NIL, 1, NIL, 0 });
+	}
+
+	// Round up so the timer never fires before its deadline
+	uint64_t expiryTick = toTick(now + delay);
+	if (toTime(expiryTick) < now + delay)
+		expiryTick++;
+
+	if (expiryTick <= m_currentTick)
+		expiryTick = m_currentTick + 1;
+
+	const uint64_t maxDelayTicks = (uint64_t(1) << (LEVEL_BITS * LEVELS)) - 1;
+	if (expiryTick - m_currentTick > maxDelayTicks)
+		expiryTick = m_currentTick + maxDelayTicks;
+
+	m_nodes[nodeIndex].m_expiryTick = expiryTick;
+	place(nodeIndex);
+	m_activeCount++;
+
+	return (uint64_t(m_nodes[nodeIndex].m_generation) << 32) | nodeIndex;
+}
+
+bool DataMailboxTimerWheel::cancel(TimerId timerId)
+{
+	uint32_t nodeIndex = (uint32_t)(timerId & 0xFFFFFFFF);
+	uint32_t generation = (uint32_t)(timerId >> 32);
+
+	if (nodeIndex >= m_nodes.size())
+		return false;
+
+	TimerNode& node = m_nodes[nodeIndex];
+
+	if (node.m_generation != generation || node.m_slot == NIL)
+		return false;
+
+	unlink(nodeIndex);
+	release(nodeIndex);
+	m_activeCount--;
+
+	return true;
+}
+
+void DataMailboxTimerWheel::place(uint32_t nodeIndex)
+{
+	TimerNode& node = m_nodes[nodeIndex];
+
+	uint64_t ticksLeft = node.m_expiryTick - m_currentTick;
+
+	unsigned int level = 0;
+	while (level < LEVELS - 1 && ticksLeft >= (uint64_t(1) << (LEVEL_BITS * (level + 1))))
+		level++;
+
+	unsigned int slot = (node.m_expiryTick >> (LEVEL_BITS * level)) & (SLOTS - 1);
+
+	node.m_slot = level * SLOTS + slot;
+	node.m_prev = NIL;
+	node.m_next = m_slots[node.m_slot];
+
+	if (node.m_next != NIL)
+		m_nodes[node.m_next].m_prev = nodeIndex;
+
+	m_slots[node.m_slot] = nodeIndex;
+	m_levelCounts[level]++;
+}
+
+void DataMailboxTimerWheel::unlink(uint32_t nodeIndex)
+{
+	TimerNode& node = m_nodes[nodeIndex];
+
+	if (node.m_prev != NIL)
+		m_nodes[node.m_prev].m_next = node.m_next;
+	else
+		m_slots[node.m_slot] = node.m_next;
+
+	if (node.m_next != NIL)
+		m_nodes[node.m_next].m_prev = node.m_prev;
+
+	m_levelCounts[node.m_slot / SLOTS]--;
+	node.m_slot = NIL;
+}
+
+void DataMailboxTimerWheel::release(uint32_t nodeIndex)
+{
+	TimerNode& node = m_nodes[nodeIndex];
+
+	node.m_generation++;
+	if (node.m_generation == 0) // keeps ids non-zero
+		node.m_generation = 1;
+
+	node.m_next = m_freeList;
+	m_freeList = nodeIndex;
+}
+
+void DataMailboxTimerWheel::cascade(unsigned int level, unsigned int slot)
+{
+	uint32_t nodeIndex = m_slots[level * SLOTS + slot];
+
+	m_slots[level * SLOTS + slot] = NIL;
+
+	while (nodeIndex != NIL)
+	{
+		uint32_t next = m_nodes[nodeIndex].m_next;
+
+		m_levelCounts[level]--;
+		place(nodeIndex);
+
+		nodeIndex = next;
+	}
+}
+
+void DataMailboxTimerWheel::processTick(std::vector<TimerId>& expired)
+{
+	// Cascade from the highest wrapped level down so timers can move more than one level at once
+	unsigned int wrappedLevels = 0;
+	while (wrappedLevels < LEVELS - 1 && ((m_currentTick >> (LEVEL_BITS * (wrappedLevels + 1))) << (LEVEL_BITS * (wrappedLevels + 1))) == m_currentTick)
+		wrappedLevels++;
+
+	for (unsigned int level = wrappedLevels; level > 0; level--)
+		cascade(level, (m_currentTick >> (LEVEL_BITS * level)) & (SLOTS - 1));
+
+	uint32_t nodeIndex = m_slots[m_currentTick & (SLOTS - 1)];
+
+	while (nodeIndex != NIL)
+	{
+		uint32_t next = m_nodes[nodeIndex].m_next;
+
+		expired.push_back((uint64_t(m_nodes[nodeIndex].m_generation) << 32) | nodeIndex);
+
+		unlink(nodeIndex);
+		release(nodeIndex);
+		m_activeCount--;
+
+		nodeIndex = next;
+	}
+}
+
+void DataMailboxTimerWheel::advance(DataMailboxTime::Clock::time_point now, std::vector<TimerId>& expired)
+{
+	uint64_t targetTick = toTick(now);
+
+	while (m_currentTick < targetTick)
+	{
+		if (m_activeCount == 0)
+		{
+			m_currentTick = targetTick;
+			break;
+		}
+
+		if (m_levelCounts[0] == 0)
+		{
+			// Nothing can expire before the next level 0 wrap, skip to it
+			uint64_t nextWrap = (m_currentTick | (SLOTS - 1)) + 1;
+
+			if (nextWrap > targetTick)
+			{
+				m_currentTick = targetTick;
+				break;
+			}
+
+			m_currentTick = nextWrap;
+		}
+		else
+		{
+			m_currentTick++;
+		}
+
+		processTick(expired);
+	}
+}
+
+void DataMailboxTimerWheel::reserve(size_t timers)
+{
+	m_nodes.reserve(timers);
+}
+
+DataMailboxTime::Clock::time_point DataMailboxTimerWheel::getNextWakeup() const
+{
+	if (m_activeCount == 0)
+		return DataMailboxTime::Clock::time_point::max();
+
+	uint64_t nextWrap = (m_currentTick | (SLOTS - 1)) + 1;
+
+	if (m_levelCounts[0] != 0)
+	{
+		for (uint64_t tick = m_currentTick + 1; tick < nextWrap; tick++)
+		{
+			if (m_slots[tick & (SLOTS - 1)] != NIL)
+				return toTime(tick);
+		}
+	}
+
+	return toTime(nextWrap);
+}
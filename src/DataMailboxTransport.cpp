@@ -0,0 +1,143 @@
+#include "DataMailboxTransport.hpp"
+
+#include "Kernel.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+
+void DataMailboxTransport::sendBatch(MailboxReference& destination, const TransportBuffer* frames, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		send(destination, frames[i].m_pData, frames[i].m_size);
+}
+
+void DataMailboxTransport::sendGather(MailboxReference& destination, const TransportBuffer* parts, size_t count)
+{
+	// Per thread, as send() may be called from several threads
+	thread_local std::vector<char> frame;
+
+	frame.clear();
+
+	for (size_t i = 0; i < count; i++)
+		frame.insert(frame.end(), parts[i].m_pData, parts[i].m_pData + parts[i].m_size);
+
+	send(destination, frame.data(), frame.size());
+}
+
+TransportFrame DataMailboxTransport::receiveFor(const struct timespec& timeout)
+{
+	struct timespec settings = getTimeout_settings();
+
+	setTimeout_settings(timeout);
+	TransportFrame frame = receive(enuReceiveOptions::TIMED);
+	setTimeout_settings(settings);
+
+	return frame;
+}
+
+DataMailboxMqTransport::DataMailboxMqTransport(const std::string& name, ILogger* pLogger, const mq_attr& mailboxAttributes)
+	:	m_mailbox(name, pLogger, mailboxAttributes), m_name(name)
+{
+
+}
+
+void DataMailboxMqTransport::send(MailboxReference& destination, const char* data, size_t size)
+{
+	sendFrame(destination, data, size);
+}
+
+void DataMailboxMqTransport::sendConnectionless(MailboxReference& destination, const char* data, size_t size)
+{
+	sendFrame(destination, data, size);
+}
+
+void DataMailboxMqTransport::sendFrame(MailboxReference& destination, const char* data, size_t size)
+{
+	// Per thread, as send() may be called from several threads
+	thread_local std::vector<char> frame;
+
+	MessageHeader header{};
+	header.m_type = enuMessageType::DATA;
+	header.m_payloadSize = size;
+
+	// Layout SimplifiedMailbox receives: header, source name with its terminator, payload
+	frame.resize(sizeof(header) + m_name.length() + 1 + size);
+	memcpy(frame.data(), &header, sizeof(header));
+	memcpy(frame.data() + sizeof(header), m_name.c_str(), m_name.length() + 1);
+	memcpy(frame.data() + sizeof(header) + m_name.length() + 1, data, size);
+
+	const std::string destinationName = destination.getName();
+
+	mqd_t queue = mq_open(("/" + destinationName).c_str(), O_WRONLY | O_CLOEXEC);
+	if (queue == (mqd_t)-1)
+	{
+		Kernel::Warning("Cannot open mailbox " + destinationName + ": " + strerror(errno));
+		return;
+	}
+
+	int result;
+	do
+	{
+		result = mq_send(queue, frame.data(), frame.size(), 0);
+	} while (result != 0 && errno == EINTR);
+
+	if (result != 0)
+		Kernel::Warning("Cannot send to mailbox " + destinationName + ": " + strerror(errno));
+
+	mq_close(queue);
+}
+
+TransportFrame DataMailboxMqTransport::receive(enuReceiveOptions options)
+{
+	SimpleMailboxMessage rawMessage = m_mailbox.receive(options);
+
+	TransportFrame frame;
+	frame.m_type = rawMessage.m_header.m_type;
+
+	if (frame.m_type != enuMessageType::TIMED_OUT && frame.m_type != enuMessageType::EMPTY)
+	{
+		frame.m_pData = rawMessage.m_pData;
+		frame.m_size = rawMessage.m_header.m_payloadSize;
+		frame.m_source = std::move(rawMessage.m_sourceName);
+	}
+
+	return frame;
+}
+
+size_t DataMailboxMqTransport::getFrameOverhead(const TransportFrame& frame) const
+{
+	return sizeof(SimpleMailboxMessage::m_header) + frame.m_source.length() + 1;
+}
+
+void DataMailboxMqTransport::setTimeout_settings(struct timespec timeout)
+{
+	m_mailbox.setTimeout_settings(timeout);
+}
+
+struct timespec DataMailboxMqTransport::getTimeout_settings()
+{
+	return m_mailbox.getTimeout_settings();
+}
+
+void DataMailboxMqTransport::setRTO_s(time_t RTOs)
+{
+	m_mailbox.setRTO_s(RTOs);
+}
+
+void DataMailboxMqTransport::setRTO_ns(long RTOns)
+{
+	m_mailbox.setRTO_ns(RTOns);
+}
+
+mq_attr DataMailboxMqTransport::getAttributes()
+{
+	return m_mailbox.getMQAttributes();
+}
+
+void DataMailboxMqTransport::setAttributes(const mq_attr& attributes)
+{
+	m_mailbox.setMQAttributes(attributes);
+}
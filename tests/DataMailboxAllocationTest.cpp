@@ -0,0 +1,217 @@
+/*****************************************************************//**
+ * \file   DataMailboxAllocationTest.cpp
+ * \brief  Checks that the steady-state DataMailbox send and receive paths do not allocate.
+ *
+ * Counts every operator new of the process. After a warm-up round, sending the built-in messages, \n
+ * receiving a frame, TimedOut and EmptyQueue, and delivering expired timers must not allocate at all. \n
+ * The mailbox runs on a transport which discards sent frames, so only DataMailbox is measured - \n
+ * the buffers of the real transports (e.g. the receive buffer of SimplifiedMailbox) are outside this library. \n
+ * The frame a transport hands over is allocated by the transport (TransportFrame::m_pData), so it is not counted. \n
+ * Returns 0 if nothing allocated.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#include "DataMailbox.hpp"
+#include "DataMailboxTransport.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+
+static std::atomic<unsigned long long> g_allocations{ 0 };
+
+/// Set while the transport allocates a received frame, which is not counted
+static thread_local bool t_transportAllocation = false;
+
+void* operator new(size_t size)
+{
+	if (!t_transportAllocation)
+		g_allocations++;
+
+	void* pMemory = malloc(size != 0 ? size : 1);
+	if (pMemory == nullptr)
+		throw std::bad_alloc();
+
+	return pMemory;
+}
+
+// Not inlined, GCC would take free() of memory from operator new for a mismatched deallocation
+__attribute__((noinline)) void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	operator delete(pMemory);
+}
+
+/// Discards sent frames and never waits. Receives nothing, or a copy of the frame set by `setReceivedFrame()`.
+class DiscardingTransport : public DataMailboxTransport
+{
+public:
+	DiscardingTransport(const std::string& name)
+		:	m_name(name), m_timeout{ 0, 0 }, m_sentBytes(0), m_pReceivedFrame(nullptr), m_receivedFrameSize(0)
+	{
+
+	}
+
+	virtual const std::string& getName() const { return m_name; }
+
+	virtual void send(MailboxReference&, const char*, size_t size) { m_sentBytes += size; }
+
+	/// The received frame if set, otherwise EMPTY for enuReceiveOptions::NONBLOCKING and TIMED_OUT for the other options
+	virtual TransportFrame receive(enuReceiveOptions options)
+	{
+		TransportFrame frame;
+
+		if (m_pReceivedFrame == nullptr)
+		{
+			frame.m_type = (options % enuReceiveOptions::NONBLOCKING) ? enuMessageType::EMPTY : enuMessageType::TIMED_OUT;
+			return frame;
+		}
+
+		t_transportAllocation = true;
+		frame.m_pData = new char[m_receivedFrameSize];
+		t_transportAllocation = false;
+
+		memcpy(frame.m_pData, m_pReceivedFrame, m_receivedFrameSize);
+		frame.m_size = m_receivedFrameSize;
+		frame.m_type = enuMessageType::DATA;
+		frame.m_source = "Source";
+
+		return frame;
+	}
+
+	/// Every following receive returns a copy of `frame`, nullptr - nothing is received
+	void setReceivedFrame(const char* frame, size_t size)
+	{
+		m_pReceivedFrame = frame;
+		m_receivedFrameSize = size;
+	}
+
+	virtual void setTimeout_settings(struct timespec timeout) { m_timeout = timeout; }
+	virtual struct timespec getTimeout_settings() { return m_timeout; }
+
+	virtual mq_attr getAttributes() { return MailboxReference::messageAttributes; }
+	virtual void setAttributes(const mq_attr&) {}
+
+	size_t getSentBytes() const { return m_sentBytes; }
+
+private:
+	std::string m_name;
+	struct timespec m_timeout;
+	size_t m_sentBytes;
+
+	const char* m_pReceivedFrame;
+	size_t m_receivedFrameSize;
+};
+
+/// Rounds counted after the warm-up round
+static const int ROUNDS = 1000;
+
+/// Runs `round` once to warm up, then ROUNDS times counting allocations. Returns true if there were none.
+static bool expectNoAllocations(const char* name, const std::function<void(unsigned long long& allocations)>& round)
+{
+	unsigned long long allocations = 0;
+	round(allocations);
+
+	allocations = 0;
+	for (int i = 0; i < ROUNDS; i++)
+		round(allocations);
+
+	printf("%-40s %llu allocations in %d rounds\n", name, allocations, ROUNDS);
+
+	return allocations == 0;
+}
+
+/// Adds allocations made by `call` to `allocations`
+template <typename Function>
+static void count(unsigned long long& allocations, Function call)
+{
+	unsigned long long before = g_allocations;
+	call();
+	allocations += g_allocations - before;
+}
+
+int main()
+{
+	// Short names, so MailboxReference copies of them fit the small string buffer
+	DiscardingTransport* pTransport = new DiscardingTransport("AllocTest");
+	DataMailbox mailbox{ std::unique_ptr<DataMailboxTransport>(pTransport) };
+	MailboxReference destination("Sink");
+
+	StringMessage text("status: running");
+	WatchdogMessage kick(WatchdogMessage::SlotName::make("slot"), WatchdogMessage::KICK);
+	RFIDMessage rfid("04A1B2C3D4E5F6");
+	KeypadMessage_wPassword password("1234");
+
+	bool success = true;
+
+	success &= expectNoAllocations("send", [&](unsigned long long& allocations)
+	{
+		count(allocations, [&]()
+		{
+			mailbox.send(destination, &text);
+			mailbox.send(destination, &kick);
+			mailbox.send(destination, &rfid);
+			mailbox.send(destination, &password);
+		});
+	});
+
+	success &= expectNoAllocations("receive TIMED on empty queue", [&](unsigned long long& allocations)
+	{
+		count(allocations, [&]() { mailbox.receive(enuReceiveOptions::TIMED); });
+	});
+
+	success &= expectNoAllocations("receive NONBLOCKING on empty queue", [&](unsigned long long& allocations)
+	{
+		count(allocations, [&]() { mailbox.receive(enuReceiveOptions::NONBLOCKING); });
+	});
+
+	// Type byte and text of a StringMessage, as it arrives without checksum
+	static const char RECEIVED_FRAME[] = { (char)MessageDataType::StringMessage, 'd', 'o', 'o', 'r', ' ', 'o', 'p', 'e', 'n' };
+	bool received = true;
+
+	pTransport->setReceivedFrame(RECEIVED_FRAME, sizeof(RECEIVED_FRAME));
+
+	success &= expectNoAllocations("receive frame", [&](unsigned long long& allocations)
+	{
+		count(allocations, [&]()
+		{
+			received &= mailbox.receive(enuReceiveOptions::NORMAL).getDataType() == MessageDataType::StringMessage;
+		});
+	});
+
+	pTransport->setReceivedFrame(nullptr, 0);
+
+	if (!received)
+	{
+		printf("frame was not received\n");
+		success = false;
+	}
+
+	success &= expectNoAllocations("schedule and receive timer", [&](unsigned long long& allocations)
+	{
+		count(allocations, [&]()
+		{
+			mailbox.scheduleTimer(timespec{ 0, 1000 });
+			mailbox.receive(enuReceiveOptions::NORMAL);
+		});
+	});
+
+	if (pTransport->getSentBytes() == 0)
+	{
+		printf("nothing was sent\n");
+		success = false;
+	}
+
+	printf(success ? "PASSED\n" : "FAILED\n");
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+/*****************************************************************//**
+ * \file   DataMailboxMemoryTransportTest.cpp
+ * \brief  Protocol and throughput scenarios on DataMailboxMemoryTransport, checked against the virtual clock.
+ *
+ * Every scenario runs on its own DataMailboxMemoryNetwork and checks the exact virtual time its timeouts, \n
+ * timers and delivery delays end at, so the same run gives the same results on any machine. \n
+ * Timeouts of several virtual seconds must not take real time - the wall time of every scenario is printed. \n
+ * Returns 0 if every scenario passed.
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#include "DataMailbox.hpp"
+#include "DataMailboxMemoryTransport.hpp"
+#include "DataMailboxRPC.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+
+typedef std::unique_ptr<DataMailboxTransport> TransportPtr;
+
+/// Watchdog messages sent by the throughput scenarios
+static const int WATCHDOG_MESSAGES = 5000;
+
+/// Failed checks of the running scenario
+static int g_failures = 0;
+
+static void check(bool condition, const char* description)
+{
+	if (!condition)
+	{
+		printf("    failed: %s\n", description);
+		g_failures++;
+	}
+}
+
+/// Runs `scenario` and prints its result and wall time. Returns true if all its checks passed.
+static bool runScenario(const char* name, const std::function<void()>& scenario)
+{
+	g_failures = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	scenario();
+	auto wallTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+	printf("%-40s %s in %lld ms\n", name, g_failures == 0 ? "passed" : "FAILED", (long long)wallTime.count());
+
+	return g_failures == 0;
+}
+
+static mq_attr queueAttributes(long maxMessages)
+{
+	mq_attr attributes = MailboxReference::messageAttributes;
+	attributes.mq_maxmsg = maxMessages;
+
+	return attributes;
+}
+
+int main()
+{
+	bool success = true;
+
+	success &= runScenario("RTO timeout", []()
+	{
+		DataMailboxMemoryNetwork network;
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network)) };
+
+		client.setRTO_s(5);
+		check(client.receive(enuReceiveOptions::TIMED).getDataType() == MessageDataType::TimedOut, "TIMED receive times out");
+		check(network.getTime() == std::chrono::seconds(5), "RTO ends at 5 s");
+
+		check(client.receive(timespec{ 2, 0 }).getDataType() == MessageDataType::TimedOut, "receive with a timeout times out");
+		check(network.getTime() == std::chrono::seconds(7), "timeout ends at 7 s");
+	});
+
+	success &= runScenario("timer", []()
+	{
+		DataMailboxMemoryNetwork network;
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network)) };
+
+		network.advance(std::chrono::seconds(1));
+
+		DataMailboxTimerWheel::TimerId timerId = client.scheduleTimer(timespec{ 30, 0 });
+		BasicDataMailboxMessage message = client.receive(enuReceiveOptions::NORMAL);
+
+		check(message.getDataType() == MessageDataType::TimedOut && message.getTimerId() == timerId, "timer is returned with its id");
+		check(network.getTime() >= std::chrono::seconds(31) && network.getTime() < std::chrono::seconds(32), "timer expires 30 s after it was scheduled");
+	});
+
+	success &= runScenario("RPC expiry", []()
+	{
+		DataMailboxMemoryNetwork network;
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network)) };
+		DataMailbox server{ TransportPtr(new DataMailboxMemoryTransport("server", network)) };
+		DataMailboxRPC rpc(client);
+		MailboxReference toServer("server");
+
+		StringMessage request("ping");
+		bool timedOut = false;
+
+		rpc.call(toServer, &request, timespec{ 2, 0 }, [&](BasicDataMailboxMessage& reply)
+		{
+			timedOut = reply.getDataType() == MessageDataType::TimedOut;
+		});
+
+		// The server never answers
+		client.setRTO_s(10);
+		BasicDataMailboxMessage message = rpc.receive(enuReceiveOptions::TIMED);
+
+		check(timedOut, "callback gets TimedOut");
+		check(rpc.getPendingCount() == 0, "expired request is forgotten");
+		check(message.getDataType() == MessageDataType::TimedOut, "receive still times out after the request expired");
+		check(network.getTime() == std::chrono::seconds(10), "receive ends at the RTO");
+	});
+
+	success &= runScenario("RPC round trips", []()
+	{
+		DataMailboxMemoryNetwork network;
+		network.setDeliveryDelay(std::chrono::milliseconds(1));
+
+		// Room for the replies and the message after them
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network, queueAttributes(WATCHDOG_MESSAGES + 1))) };
+		DataMailbox server{ TransportPtr(new DataMailboxMemoryTransport("server", network, queueAttributes(WATCHDOG_MESSAGES))) };
+		DataMailboxRPC clientRPC(client);
+		DataMailboxRPC serverRPC(server);
+		MailboxReference toServer("server");
+
+		WatchdogMessage kick(WatchdogMessage::SlotName::make("slot"), WatchdogMessage::KICK);
+		StringMessage response("ok");
+		int replies = 0;
+
+		for (int i = 0; i < WATCHDOG_MESSAGES; i++)
+		{
+			clientRPC.call(toServer, &kick, timespec{ 1, 0 }, [&](BasicDataMailboxMessage& reply)
+			{
+				if (reply.getDataType() == MessageDataType::StringMessage)
+					replies++;
+			});
+		}
+
+		for (int i = 0; i < WATCHDOG_MESSAGES; i++)
+		{
+			BasicDataMailboxMessage message = serverRPC.receive(enuReceiveOptions::NORMAL);
+			if (message.getDataType() != MessageDataType::RPCMessage)
+				break;
+
+			RPCMessage request;
+			request.Unpack(message);
+			serverRPC.reply(request, &response);
+		}
+
+		// receive() dispatches replies until it gets another message, the server ends with one
+		StringMessage done("done");
+		MailboxReference toClient("client");
+		server.send(toClient, &done);
+
+		client.setRTO_s(1);
+		BasicDataMailboxMessage message = clientRPC.receive(enuReceiveOptions::TIMED);
+
+		check(message.getDataType() == MessageDataType::StringMessage, "message after the replies is returned");
+		check(replies == WATCHDOG_MESSAGES && clientRPC.getPendingCount() == 0, "every request gets its reply");
+		check(network.getTime() == std::chrono::milliseconds(2), "replies arrive after two delivery delays");
+	});
+
+	success &= runScenario("delivery delay", []()
+	{
+		DataMailboxMemoryNetwork network;
+		network.setDeliveryDelay("server", std::chrono::milliseconds(3));
+
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network)) };
+		DataMailbox server{ TransportPtr(new DataMailboxMemoryTransport("server", network)) };
+		MailboxReference toServer("server");
+
+		StringMessage text("hello world");
+		client.send(toServer, &text);
+
+		check(server.receive(enuReceiveOptions::NONBLOCKING).getDataType() == MessageDataType::EmptyQueue, "frame in flight is not deliverable");
+
+		server.setRTO_ns(1000000);
+		check(server.receive(enuReceiveOptions::TIMED).getDataType() == MessageDataType::TimedOut, "1 ms receive times out before the delivery");
+
+		BasicDataMailboxMessage message = server.receive(enuReceiveOptions::NORMAL);
+		check(message.getDataType() == MessageDataType::StringMessage && message.getSource().getName() == "client", "frame is delivered from its source");
+		check(network.getTime() == std::chrono::milliseconds(3), "frame is delivered at 3 ms");
+	});
+
+	success &= runScenario("watchdog throughput", []()
+	{
+		DataMailboxMemoryNetwork network;
+		network.setDeliveryDelay(std::chrono::microseconds(10));
+
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network, queueAttributes(WATCHDOG_MESSAGES))) };
+		DataMailbox watchdog{ TransportPtr(new DataMailboxMemoryTransport("watchdog", network, queueAttributes(WATCHDOG_MESSAGES))) };
+		MailboxReference toWatchdog("watchdog");
+
+		WatchdogMessage kick(WatchdogMessage::SlotName::make("slot"), WatchdogMessage::KICK);
+		for (int i = 0; i < WATCHDOG_MESSAGES; i++)
+			client.send(toWatchdog, &kick);
+
+		int received = 0;
+		watchdog.setRTO_s(1);
+		while (watchdog.receive(enuReceiveOptions::TIMED).getDataType() == MessageDataType::WatchdogMessage)
+			received++;
+
+		check(received == WATCHDOG_MESSAGES, "every watchdog message is received");
+		check(network.getStatistics().m_dropped == 0, "nothing is dropped");
+		check(network.getTime() == std::chrono::seconds(1) + std::chrono::microseconds(10), "last receive times out 1 s after the delivery");
+	});
+
+	success &= runScenario("full queue without blocking", []()
+	{
+		DataMailboxMemoryNetwork network;
+		network.setBlockWhenFull(false);
+
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network)) };
+		DataMailbox server{ TransportPtr(new DataMailboxMemoryTransport("server", network, queueAttributes(2))) };
+		MailboxReference toServer("server");
+
+		StringMessage text("hello world");
+		for (int i = 0; i < 5; i++)
+			client.send(toServer, &text);
+
+		MemoryNetworkStatistics statistics = network.getStatistics();
+		check(statistics.m_sent == 2 && statistics.m_dropped == 3, "frames beyond mq_maxmsg are dropped");
+		check(statistics.m_blocked == 0, "no send blocks");
+	});
+
+	success &= runScenario("full queue blocking", []()
+	{
+		DataMailboxMemoryNetwork network;
+
+		const long maxMessages = 2;
+		DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport("client", network)) };
+		DataMailbox server{ TransportPtr(new DataMailboxMemoryTransport("server", network, queueAttributes(maxMessages))) };
+		MailboxReference toServer("server");
+
+		const int messages = 100;
+		int received = 0;
+
+		// Full before anything is received, so the next send has to wait
+		StringMessage text("hello world");
+		for (int i = 0; i < maxMessages; i++)
+			client.send(toServer, &text);
+
+		std::thread sender([&]()
+		{
+			for (int i = maxMessages; i < messages; i++)
+				client.send(toServer, &text);
+		});
+
+		// Receives only once the sender waits for room
+		while (network.getStatistics().m_blocked == 0)
+			std::this_thread::yield();
+
+		while (received < messages)
+		{
+			if (server.receive(enuReceiveOptions::NORMAL).getDataType() == MessageDataType::StringMessage)
+				received++;
+		}
+
+		sender.join();
+
+		MemoryNetworkStatistics statistics = network.getStatistics();
+		check(received == messages, "every frame is received");
+		check(statistics.m_dropped == 0, "nothing is dropped");
+		check(statistics.m_blocked > 0, "sends to the full queue block");
+	});
+
+	printf(success ? "PASSED\n" : "FAILED\n");
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,648 @@
+/*****************************************************************//**
+ * \file   DataMailboxBenchmark.cpp
+ * \brief  Micro benchmarks of DataMailbox building blocks.
+ *
+ * Usage:
+ *		DataMailboxBenchmark <benchmark> [options]
+ *
+ *		crc [--seconds <s>]                        CRC32C throughput of the selected and the portable implementation
+ *		journal [--seconds <s>] [--directory <d>]   Durable receive throughput at several group commit sizes
+ *		trace [--seconds <s>]                      Cost of tracing sends and receives, synchronous vs DataMailboxAsyncLogger
+ *		send [--seconds <s>]                       Send throughput of threads sharing one DataMailbox, per transport
+ *		jitter [--seconds <s>] [--cpu <n>] [--priority <p>] [--load <n>]
+ *		                                           Receive latency percentiles without and with RealtimeSettings,
+ *		                                           one message per millisecond while <n> threads (default all CPUs) spin
+ *		memory [--seconds <s>]                     WatchdogMessage round trips over mq vs DataMailboxMemoryTransport
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#include "DataMailbox.hpp"
+#include "DataMailboxAsyncLogger.hpp"
+#include "DataMailboxCRC32C.hpp"
+#include "DataMailboxJournal.hpp"
+#include "DataMailboxMemoryTransport.hpp"
+#include "DataMailboxSocketTransport.hpp"
+#include "DataMailboxTime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef DataMailboxTime::Clock Clock;
+
+struct BenchmarkOptions
+{
+	double m_seconds = 0.5;
+
+	/// Where files are written. Use a directory on the target storage, tmpfs makes every sync free.
+	std::string m_directory = ".";
+
+	/// CPU of the receiving thread in the jitter benchmark, -1 leaves affinity unchanged
+	int m_cpu = -1;
+
+	/// SCHED_FIFO priority of the receiving thread in the jitter benchmark
+	int m_priority = 80;
+
+	/// Busy threads competing with the jitter benchmark
+	unsigned int m_loadThreads = std::thread::hardware_concurrency();
+};
+
+/// Runs `function` repeatedly for about `seconds`, returns number of runs per second
+template <typename Function>
+static double measureRate(double seconds, Function function)
+{
+	unsigned long long runs = 0;
+	unsigned long long batch = 1;
+
+	Clock::time_point start = Clock::now();
+	double elapsed = 0.0;
+
+	while (elapsed < seconds)
+	{
+		for (unsigned long long i = 0; i < batch; i++)
+			function();
+
+		runs += batch;
+		batch *= 2;
+
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	return runs / elapsed;
+}
+
+static int benchmarkCRC(const BenchmarkOptions& options)
+{
+	static const size_t sizes[] = { 16, 64, 256, 1024, 8192, 65536, 1024 * 1024 };
+
+	std::vector<unsigned char> data(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (unsigned char)(i * 131 + 7);
+
+	printf("Selected implementation: %s\n", DataMailboxCRC32C::getImplementationName());
+	printf("%10s | %12s %12s | %12s %12s\n", "size [B]", "selected", "GB/s", "portable", "GB/s");
+
+	volatile uint32_t sink = 0; // keeps the checksums from being optimized out
+
+	for (size_t size : sizes)
+	{
+		double selectedRate = measureRate(options.m_seconds, [&]() { sink = DataMailboxCRC32C::compute(data.data(), size); });
+		double portableRate = measureRate(options.m_seconds, [&]() { sink = DataMailboxCRC32C::extendPortable(0, data.data(), size); });
+
+		printf("%10zu | %10.0f/s %12.2f | %10.0f/s %12.2f\n", size,
+			selectedRate, selectedRate * size / 1e9,
+			portableRate, portableRate * size / 1e9);
+	}
+
+	(void)sink;
+
+	return 0;
+}
+
+/// Appends 64 byte frames, acknowledges each right away and commits every `groupCommitSize` records
+static double measureJournal(const BenchmarkOptions& options, size_t groupCommitSize, double& commitRate)
+{
+	DataMailboxJournal journal(options.m_directory, "DataMailboxBenchmark_journal");
+
+	const std::string source = "DataMailboxBenchmark_sender";
+	char frame[64] = { (char)MessageDataType::RFIDMessage };
+
+	unsigned long long records = 0;
+
+	Clock::time_point start = Clock::now();
+	double elapsed = 0.0;
+
+	while (elapsed < options.m_seconds)
+	{
+		DataMailboxJournal::Sequence sequence = journal.append(source, frame, sizeof(frame));
+		records++;
+
+		if (groupCommitSize > 0 && journal.getUncommittedCount() >= groupCommitSize)
+			journal.commit();
+
+		journal.acknowledge(sequence);
+
+		if (records % 64 == 0)
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	commitRate = journal.getCommitCount() / elapsed;
+
+	return records / elapsed;
+}
+
+/// Producer thread sends RFIDMessages as fast as the queue takes them, durable receiver acknowledges each one
+static double measureDurableMailbox(const BenchmarkOptions& options, size_t groupCommitSize)
+{
+	DataMailbox receiver("DataMailboxBenchmark_receiver");
+	receiver.enableDurability(options.m_directory, groupCommitSize);
+	receiver.setRTO_ns(10 * 1000 * 1000);
+
+	std::atomic<bool> stop(false);
+	std::atomic<bool> producerDone(false);
+
+	std::thread producer([&]()
+	{
+		DataMailbox sender("DataMailboxBenchmark_sender");
+		MailboxReference destination("DataMailboxBenchmark_receiver");
+		RFIDMessage message(RFIDMessage::UUID::make("0123456789ABCDEF"));
+
+		while (!stop)
+			sender.send(destination, &message);
+
+		producerDone = true;
+	});
+
+	unsigned long long received = 0;
+
+	Clock::time_point start = Clock::now();
+	double elapsed = 0.0;
+
+	while (elapsed < options.m_seconds)
+	{
+		BasicDataMailboxMessage message = receiver.receive(enuReceiveOptions::TIMED);
+
+		if (receiver.acknowledge(message))
+			received++;
+
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	stop = true;
+
+	// The producer may be blocked on a full queue. Everything is acknowledged, so the journal is deleted.
+	while (true)
+	{
+		bool drained = producerDone;
+
+		BasicDataMailboxMessage message = receiver.receive(drained ? enuReceiveOptions::NONBLOCKING : enuReceiveOptions::TIMED);
+
+		if (message.getDataType() == MessageDataType::EmptyQueue)
+			break;
+
+		receiver.acknowledge(message);
+	}
+
+	producer.join();
+
+	return received / elapsed;
+}
+
+static int benchmarkJournal(const BenchmarkOptions& options)
+{
+	static const size_t groupCommitSizes[] = { 0, 1, 8, 32, 128 };
+
+	printf("Directory: %s, message queue depth: %ld (limits the group size of the mailbox)\n", options.m_directory.c_str(), (long)MailboxReference::messageAttributes.mq_maxmsg);
+	printf("%12s | %14s %12s | %14s\n", "group commit", "journal rec/s", "syncs/s", "mailbox msg/s");
+
+	for (size_t groupCommitSize : groupCommitSizes)
+	{
+		double commitRate = 0.0;
+		double journalRate = measureJournal(options, groupCommitSize, commitRate);
+		double mailboxRate = measureDurableMailbox(options, groupCommitSize);
+
+		printf("%12s | %14.0f %12.0f | %14.0f\n", groupCommitSize == 0 ? "never sync" : std::to_string(groupCommitSize).c_str(),
+			journalRate, commitRate, mailboxRate);
+	}
+
+	return 0;
+}
+
+/// Logger whose output costs nothing, so only formatting is measured
+class CountingLogger : public ILogger
+{
+public:
+	virtual void operator<<(const std::string& message) { m_lines++; m_bytes += message.length(); }
+
+	unsigned long long m_lines = 0;
+	unsigned long long m_bytes = 0;
+};
+
+/// Nanoseconds per DataMailboxAsyncLogger::trace(), in bursts the writer thread drains in between
+static double measureTraceRecord(const BenchmarkOptions& options, DataMailboxAsyncLogger& logger)
+{
+	static const size_t BURST = DataMailboxAsyncLogger::DEFAULT_RING_CAPACITY / 2;
+
+	uint16_t mailboxId = logger.registerName("DataMailboxBenchmark_trace");
+	const std::string peer = "DataMailboxBenchmark_peer";
+
+	Clock::duration busy = Clock::duration::zero();
+	unsigned long long records = 0;
+
+	while (std::chrono::duration<double>(busy).count() < options.m_seconds)
+	{
+		Clock::time_point start = Clock::now();
+
+		for (size_t i = 0; i < BURST; i++)
+			logger.trace(mailboxId, enuTraceEvent::SENT, MessageDataType::StringMessage, i, peer);
+
+		busy += Clock::now() - start;
+		records += BURST;
+
+		logger.flush();
+	}
+
+	return std::chrono::duration<double, std::nano>(busy).count() / records;
+}
+
+/// Nanoseconds per message sent by a mailbox to itself and received back
+static double measureLoopback(const BenchmarkOptions& options, ILogger* pLogger)
+{
+	DataMailbox mailbox("DataMailboxBenchmark_trace", pLogger);
+	MailboxReference destination("DataMailboxBenchmark_trace");
+	StringMessage message("card 0123456789ABCDEF at reader 3");
+
+	double rate = measureRate(options.m_seconds, [&]()
+	{
+		mailbox.send(destination, &message);
+		mailbox.receive(enuReceiveOptions::NORMAL);
+	});
+
+	return 1e9 / rate;
+}
+
+static int benchmarkTrace(const BenchmarkOptions& options)
+{
+	CountingLogger target;
+
+	{
+		DataMailboxAsyncLogger logger(&target);
+		printf("DataMailboxAsyncLogger::trace(): %.1f ns per record\n\n", measureTraceRecord(options, logger));
+	}
+
+	CountingLogger synchronous;
+	double untraced = measureLoopback(options, NulLogger::getInstance());
+	double formatted = measureLoopback(options, &synchronous);
+
+	double asynchronous = 0.0;
+	unsigned long long dropped = 0;
+
+	{
+		DataMailboxAsyncLogger logger(&target);
+		asynchronous = measureLoopback(options, &logger);
+		dropped = logger.getDroppedCount();
+	}
+
+	printf("Send and receive of one StringMessage over the mailbox's own queue:\n");
+	printf("%24s | %10s %10s\n", "logger", "ns/msg", "+ns/msg");
+	printf("%24s | %10.0f %10s\n", "NulLogger", untraced, "-");
+	printf("%24s | %10.0f %10.0f\n", "synchronous (no output)", formatted, formatted - untraced);
+	printf("%24s | %10.0f %10.0f\n", "DataMailboxAsyncLogger", asynchronous, asynchronous - untraced);
+	printf("Records dropped: %llu\n", dropped);
+
+	return 0;
+}
+
+/// Messages per second sent by `threads` threads through one shared mailbox, drained by a receiver thread
+static double measureSharedSend(const BenchmarkOptions& options, bool socket, size_t threads)
+{
+	static const struct timespec STOP_CHECK = { 0, 10 * 1000 * 1000 };
+
+	std::unique_ptr<DataMailbox> pReceiver;
+	std::unique_ptr<DataMailbox> pSender;
+
+	if (socket)
+	{
+		pReceiver.reset(new DataMailbox(std::unique_ptr<DataMailboxTransport>(new DataMailboxSocketTransport("DataMailboxBenchmark_receiver"))));
+		pSender.reset(new DataMailbox(std::unique_ptr<DataMailboxTransport>(new DataMailboxSocketTransport("DataMailboxBenchmark_sender"))));
+	}
+	else
+	{
+		pReceiver.reset(new DataMailbox("DataMailboxBenchmark_receiver"));
+		pSender.reset(new DataMailbox("DataMailboxBenchmark_sender"));
+	}
+
+	std::atomic<bool> stop(false);
+	std::atomic<bool> sendersDone(false);
+	std::atomic<unsigned long long> sent(0);
+
+	// Senders may be blocked on a full queue when stopped, so the receiver drains until they are done
+	std::thread receiver([&]()
+	{
+		while (!sendersDone)
+			pReceiver->receive(STOP_CHECK);
+
+		while (pReceiver->receive(enuReceiveOptions::NONBLOCKING).getDataType() != MessageDataType::EmptyQueue)
+			;
+	});
+
+	std::vector<std::thread> senders;
+
+	Clock::time_point start = Clock::now();
+
+	for (size_t i = 0; i < threads; i++)
+	{
+		senders.emplace_back([&]()
+		{
+			MailboxReference destination("DataMailboxBenchmark_receiver");
+			RFIDMessage message(RFIDMessage::UUID::make("0123456789ABCDEF"));
+			unsigned long long count = 0;
+
+			while (!stop)
+			{
+				pSender->send(destination, &message);
+				count++;
+			}
+
+			sent += count;
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::duration<double>(options.m_seconds));
+	stop = true;
+
+	for (std::thread& sender : senders)
+		sender.join();
+
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	sendersDone = true;
+	receiver.join();
+
+	return sent / elapsed;
+}
+
+static int benchmarkSend(const BenchmarkOptions& options)
+{
+	static const size_t threadCounts[] = { 1, 2, 4, 8 };
+
+	printf("Threads sending RFIDMessages through one DataMailbox, %u CPUs\n", std::thread::hardware_concurrency());
+	printf("%8s | %14s %14s\n", "threads", "mq msg/s", "socket msg/s");
+
+	for (size_t threads : threadCounts)
+		printf("%8zu | %14.0f %14.0f\n", threads, measureSharedSend(options, false, threads), measureSharedSend(options, true, threads));
+
+	return 0;
+}
+
+static const char* const ROUND_TRIP_CLIENT = "DataMailboxBenchmark_client";
+static const char* const ROUND_TRIP_WATCHDOG = "DataMailboxBenchmark_watchdog";
+
+/// WatchdogMessage round trips per second between mailboxes ROUND_TRIP_CLIENT and ROUND_TRIP_WATCHDOG, in one thread
+static double measureRoundTrip(const BenchmarkOptions& options, DataMailbox& client, DataMailbox& watchdog)
+{
+	MailboxReference toWatchdog(ROUND_TRIP_WATCHDOG);
+	MailboxReference toClient(ROUND_TRIP_CLIENT);
+	WatchdogMessage kick(WatchdogMessage::SlotName::make("slot"), WatchdogMessage::KICK);
+
+	return measureRate(options.m_seconds, [&]()
+	{
+		client.send(toWatchdog, &kick);
+		watchdog.receive(enuReceiveOptions::NORMAL);
+		watchdog.send(toClient, &kick);
+		client.receive(enuReceiveOptions::NORMAL);
+	});
+}
+
+static int benchmarkMemory(const BenchmarkOptions& options)
+{
+	typedef std::unique_ptr<DataMailboxTransport> TransportPtr;
+
+	double mqRate = 0.0;
+
+	{
+		DataMailbox client(ROUND_TRIP_CLIENT);
+		DataMailbox watchdog(ROUND_TRIP_WATCHDOG);
+		mqRate = measureRoundTrip(options, client, watchdog);
+	}
+
+	DataMailboxMemoryNetwork network;
+	DataMailbox client{ TransportPtr(new DataMailboxMemoryTransport(ROUND_TRIP_CLIENT, network)) };
+	DataMailbox watchdog{ TransportPtr(new DataMailboxMemoryTransport(ROUND_TRIP_WATCHDOG, network)) };
+	double memoryRate = measureRoundTrip(options, client, watchdog);
+
+	printf("WatchdogMessage round trips between two mailboxes in one thread:\n");
+	printf("%10s | %14s\n", "transport", "round trips/s");
+	printf("%10s | %14.0f\n", "mq", mqRate);
+	printf("%10s | %14.0f\n", "memory", memoryRate);
+
+	// A timeout only moves the virtual clock
+	client.setRTO_s(5);
+	Clock::time_point start = Clock::now();
+	client.receive(enuReceiveOptions::TIMED);
+
+	printf("\nTIMED receive with RTO of 5 s on the memory transport: %.0f us\n", std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+
+	return 0;
+}
+
+/// Hex digits of a send time carried as RFIDMessage UUID
+static const size_t SEND_TIME_DIGITS = 16;
+
+/// UUID carrying the send time, so every receive is measured against the send of the same message
+static RFIDMessage::UUID encodeSendTime(Clock::time_point sendTime)
+{
+	char uuid[SEND_TIME_DIGITS + 1];
+	snprintf(uuid, sizeof(uuid), "%016llx", (unsigned long long)sendTime.time_since_epoch().count());
+
+	return RFIDMessage::UUID(uuid, SEND_TIME_DIGITS);
+}
+
+static Clock::time_point decodeSendTime(const RFIDMessage& message)
+{
+	char uuid[SEND_TIME_DIGITS + 1] = {};
+	memcpy(uuid, message.getUUIDString().data(), std::min(message.getUUIDString().length(), SEND_TIME_DIGITS));
+
+	return Clock::time_point(Clock::duration((Clock::rep)strtoull(uuid, nullptr, 16)));
+}
+
+/// Microseconds from send to the return of receive(), sorted
+static std::vector<double> measureLatencies(const BenchmarkOptions& options, const RealtimeSettings* pSettings, RealtimeReport& report)
+{
+	static const struct timespec STOP_CHECK = { 0, 10 * 1000 * 1000 };
+	static const std::chrono::microseconds SEND_PERIOD(1000);
+
+	DataMailbox receiverMailbox("DataMailboxBenchmark_receiver");
+	DataMailbox senderMailbox("DataMailboxBenchmark_sender");
+
+	std::atomic<bool> stop(false);
+	std::atomic<bool> ready(false);
+
+	std::vector<double> latencies;
+	latencies.reserve((size_t)(options.m_seconds * 1000) + 16);
+
+	std::thread receiver([&]()
+	{
+		if (pSettings != nullptr)
+			report = receiverMailbox.applyRealtimeSettings(*pSettings);
+
+		ready = true;
+
+		while (!stop)
+		{
+			BasicDataMailboxMessage message = receiverMailbox.receive(STOP_CHECK);
+			Clock::time_point received = Clock::now();
+
+			if (message.getDataType() == MessageDataType::RFIDMessage)
+			{
+				RFIDMessage timed;
+				timed.Unpack(message);
+
+				latencies.push_back(std::chrono::duration<double, std::micro>(received - decodeSendTime(timed)).count());
+			}
+		}
+	});
+
+	std::vector<std::thread> load;
+
+	for (unsigned int i = 0; i < options.m_loadThreads; i++)
+	{
+		load.emplace_back([&]()
+		{
+			volatile unsigned long long spin = 0;
+
+			while (!stop)
+				spin++;
+		});
+	}
+
+	while (!ready)
+		std::this_thread::yield();
+
+	MailboxReference destination("DataMailboxBenchmark_receiver");
+
+	Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.m_seconds));
+	Clock::time_point next = Clock::now();
+
+	while (Clock::now() < end)
+	{
+		next += SEND_PERIOD;
+		std::this_thread::sleep_until(next);
+
+		RFIDMessage message(encodeSendTime(Clock::now()));
+		senderMailbox.send(destination, &message);
+	}
+
+	// Lets the last message arrive
+	std::this_thread::sleep_for(SEND_PERIOD);
+	stop = true;
+
+	receiver.join();
+
+	for (std::thread& thread : load)
+		thread.join();
+
+	std::sort(latencies.begin(), latencies.end());
+
+	return latencies;
+}
+
+static double getPercentile(const std::vector<double>& sorted, double percentile)
+{
+	if (sorted.empty())
+		return 0;
+
+	return sorted[std::min(sorted.size() - 1, (size_t)(percentile / 100 * sorted.size()))];
+}
+
+static int benchmarkJitter(const BenchmarkOptions& options)
+{
+	RealtimeSettings settings;
+
+	if (options.m_cpu >= 0)
+		settings.m_cpus.push_back(options.m_cpu);
+
+	settings.m_priority = options.m_priority;
+	settings.m_lockMemory = true;
+	settings.m_prefaultStack = 256 * 1024;
+	settings.m_prefaultHeap = 8 * 1024 * 1024;
+	settings.m_timerCapacity = 1024;
+
+	RealtimeReport defaultReport;
+	RealtimeReport realtimeReport;
+
+	// Memory locking stays on for the rest of the process, so the default run goes first
+	std::vector<double> defaults = measureLatencies(options, nullptr, defaultReport);
+	std::vector<double> realtime = measureLatencies(options, &settings, realtimeReport);
+
+	printf("Receive latency of RFIDMessages sent every 1 ms, %u load threads, %u CPUs\n", options.m_loadThreads, std::thread::hardware_concurrency());
+	printf("Realtime settings: %s\n", realtimeReport.toString().c_str());
+	printf("%10s | %8s %8s %8s %8s %8s\n", "settings", "samples", "p50 us", "p99 us", "p99.9 us", "max us");
+
+	const std::pair<const char*, const std::vector<double>*> runs[] = { { "default", &defaults }, { "realtime", &realtime } };
+
+	for (const auto& run : runs)
+	{
+		const std::vector<double>& latencies = *run.second;
+
+		printf("%10s | %8zu %8.1f %8.1f %8.1f %8.1f\n", run.first, latencies.size(), getPercentile(latencies, 50), getPercentile(latencies, 99),
+			getPercentile(latencies, 99.9), latencies.empty() ? 0 : latencies.back());
+	}
+
+	return 0;
+}
+
+struct Benchmark
+{
+	const char* m_name;
+	int (*m_run)(const BenchmarkOptions& options);
+};
+
+static const Benchmark benchmarks[] =
+{
+	{ "crc", benchmarkCRC },
+	{ "journal", benchmarkJournal },
+	{ "trace", benchmarkTrace },
+	{ "send", benchmarkSend },
+	{ "jitter", benchmarkJitter },
+	{ "memory", benchmarkMemory }
+};
+
+static void printUsage()
+{
+	printf("Usage: DataMailboxBenchmark <benchmark> [--seconds <s>] [--directory <d>] [--cpu <n>] [--priority <p>] [--load <n>]\n");
+	printf("Benchmarks:");
+
+	for (const Benchmark& benchmark : benchmarks)
+		printf(" %s", benchmark.m_name);
+
+	printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printUsage();
+		return 1;
+	}
+
+	BenchmarkOptions options;
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string option = argv[i];
+
+		if (option == "--seconds" && i + 1 < argc)
+			options.m_seconds = atof(argv[++i]);
+		else if (option == "--directory" && i + 1 < argc)
+			options.m_directory = argv[++i];
+		else if (option == "--cpu" && i + 1 < argc)
+			options.m_cpu = atoi(argv[++i]);
+		else if (option == "--priority" && i + 1 < argc)
+			options.m_priority = atoi(argv[++i]);
+		else if (option == "--load" && i + 1 < argc)
+			options.m_loadThreads = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (strcmp(benchmark.m_name, argv[1]) == 0)
+			return benchmark.m_run(options);
+	}
+
+	printUsage();
+	return 1;
+}
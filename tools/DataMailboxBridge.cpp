@@ -0,0 +1,222 @@
+/*****************************************************************//**
+ * \file   DataMailboxBridge.cpp
+ * \brief  Forwards DataMailbox frames between the POSIX queue and the Unix socket transport.
+ *
+ * For every name on the socket side the bridge creates the POSIX queue of that name, so mq mailboxes \n
+ * send to it as if it was local, and forwards what arrives to its socket. For every name on the mq side \n
+ * it listens on the socket of that name and forwards to its queue. \n
+ * Sources are kept: frames forwarded to a socket are sent as the original source, frames forwarded \n
+ * to a queue are sent through the queue of the source if the source is bridged too (so replies come back), \n
+ * otherwise through the queue named by --name.
+ *
+ * Frames are forwarded unchanged (checksums included) and are not parsed.
+ *
+ * Usage:
+ *		DataMailboxBridge [options]
+ *
+ *		--socket <list>        names of mailboxes using the socket transport, e.g. reader,door
+ *		--mq <list>            names of mailboxes using POSIX queues
+ *		--directory <d>        socket directory (default DataMailboxSocketTransport::DEFAULT_DIRECTORY)
+ *		--name <name>          queue and socket of the bridge itself (default DataMailboxBridge)
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#include "DataMailboxSocketTransport.hpp"
+#include "DataMailboxTransport.hpp"
+
+#include "Kernel.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// How often the forwarding threads check for a stop request
+static const long STOP_CHECK_NS = 200 * 1000 * 1000;
+
+static std::atomic<bool> g_stop(false);
+
+struct BridgeOptions
+{
+	std::vector<std::string> m_socketNames;
+	std::vector<std::string> m_mqNames;
+	std::string m_directory = DataMailboxSocketTransport::DEFAULT_DIRECTORY;
+	std::string m_name = "DataMailboxBridge";
+};
+
+/// POSIX queue created for a mailbox on the socket side. Receives run in its own thread.
+struct MqProxy
+{
+	std::unique_ptr<DataMailboxMqTransport> m_pTransport;
+	std::atomic<unsigned long long> m_forwarded{ 0 };
+};
+
+/// Socket created for a mailbox on the mq side
+struct SocketProxy
+{
+	std::unique_ptr<DataMailboxSocketTransport> m_pTransport;
+	std::atomic<unsigned long long> m_forwarded{ 0 };
+};
+
+static std::vector<std::string> parseList(const char* text)
+{
+	std::vector<std::string> values;
+	std::stringstream stream(text);
+	std::string item;
+
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+			values.push_back(item);
+	}
+
+	return values;
+}
+
+static bool parseOptions(int argc, char* argv[], BridgeOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+
+		if (i + 1 >= argc)
+			return false;
+
+		const char* value = argv[++i];
+
+		if (option == "--socket")
+			options.m_socketNames = parseList(value);
+		else if (option == "--mq")
+			options.m_mqNames = parseList(value);
+		else if (option == "--directory")
+			options.m_directory = value;
+		else if (option == "--name")
+			options.m_name = value;
+		else
+			return false;
+	}
+
+	return !options.m_socketNames.empty() || !options.m_mqNames.empty();
+}
+
+static void onSignal(int)
+{
+	g_stop = true;
+}
+
+/// Queue -> socket. The frame is sent as its original source, so the socket side sees no difference.
+static void forwardToSocket(const std::string& name, MqProxy& proxy, DataMailboxSocketTransport& forwarder)
+{
+	MailboxReference destination(name);
+
+	proxy.m_pTransport->setTimeout_settings(timespec{ 0, STOP_CHECK_NS });
+
+	while (!g_stop)
+	{
+		TransportFrame frame = proxy.m_pTransport->receive(enuReceiveOptions::TIMED);
+
+		if (frame.m_type != enuMessageType::DATA)
+			continue;
+
+		TransportBuffer buffer{ frame.m_pData, frame.m_size };
+		forwarder.sendAs(frame.m_source, destination, &buffer, 1);
+
+		delete[] frame.m_pData;
+		proxy.m_forwarded++;
+	}
+}
+
+/// Socket -> queue, through the queue of the source if it is bridged
+static void forwardToMq(const std::string& name, SocketProxy& proxy, std::map<std::string, std::unique_ptr<MqProxy>>& mqProxies, MqProxy& fallback)
+{
+	MailboxReference destination(name);
+	std::set<std::string> unbridgedSources;
+
+	proxy.m_pTransport->setTimeout_settings(timespec{ 0, STOP_CHECK_NS });
+
+	while (!g_stop)
+	{
+		TransportFrame frame = proxy.m_pTransport->receive(enuReceiveOptions::TIMED);
+
+		if (frame.m_type != enuMessageType::DATA)
+			continue;
+
+		auto source = mqProxies.find(frame.m_source);
+		MqProxy* pSender = &fallback;
+
+		if (source != mqProxies.end())
+			pSender = source->second.get();
+		else if (unbridgedSources.insert(frame.m_source).second)
+			Kernel::Warning("Source " + frame.m_source + " is not bridged, " + name + " sees frames from " + fallback.m_pTransport->getName());
+
+		pSender->m_pTransport->send(destination, frame.m_pData, frame.m_size);
+
+		delete[] frame.m_pData;
+		proxy.m_forwarded++;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	BridgeOptions options;
+
+	if (!parseOptions(argc, argv, options))
+	{
+		printf("Usage: DataMailboxBridge [--socket <list>] [--mq <list>] [--directory <d>] [--name <name>]\n");
+		return 1;
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	// The bridge's own socket sends on behalf of the mq side, its own queue is the fallback sender
+	DataMailboxSocketTransport forwarder(options.m_name, options.m_directory);
+
+	MqProxy fallback;
+	fallback.m_pTransport.reset(new DataMailboxMqTransport(options.m_name, NulLogger::getInstance()));
+
+	std::map<std::string, std::unique_ptr<MqProxy>> mqProxies;
+	std::map<std::string, std::unique_ptr<SocketProxy>> socketProxies;
+
+	for (const std::string& name : options.m_socketNames)
+	{
+		mqProxies[name].reset(new MqProxy());
+		mqProxies[name]->m_pTransport.reset(new DataMailboxMqTransport(name, NulLogger::getInstance()));
+	}
+
+	for (const std::string& name : options.m_mqNames)
+	{
+		socketProxies[name].reset(new SocketProxy());
+		socketProxies[name]->m_pTransport.reset(new DataMailboxSocketTransport(name, options.m_directory));
+	}
+
+	// Maps are complete before the threads start, they are only read from now on
+	std::vector<std::thread> threads;
+
+	for (auto& proxy : mqProxies)
+		threads.emplace_back(forwardToSocket, proxy.first, std::ref(*proxy.second), std::ref(forwarder));
+
+	for (auto& proxy : socketProxies)
+		threads.emplace_back(forwardToMq, proxy.first, std::ref(*proxy.second), std::ref(mqProxies), std::ref(fallback));
+
+	printf("Bridging %zu socket and %zu mq mailboxes through %s\n", mqProxies.size(), socketProxies.size(), options.m_directory.c_str());
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (auto& proxy : mqProxies)
+		printf("%s: %llu frames mq -> socket\n", proxy.first.c_str(), proxy.second->m_forwarded.load());
+
+	for (auto& proxy : socketProxies)
+		printf("%s: %llu frames socket -> mq\n", proxy.first.c_str(), proxy.second->m_forwarded.load());
+
+	return 0;
+}
@@ -0,0 +1,588 @@
+/*****************************************************************//**
+ * \file   DataMailboxLoadGenerator.cpp
+ * \brief  Multi-process DataMailbox load generator and scaling benchmark.
+ *
+ * Forks N producer and M consumer processes for every combination of the swept parameters \n
+ * and reports throughput, latency percentiles and timeout/empty-queue rates.
+ *
+ * Usage:
+ *		DataMailboxLoadGenerator [options]
+ *
+ *		--producers <list>     numbers of producer processes, e.g. 1,2,4 (default 1)
+ *		--consumers <list>     numbers of consumer processes (default 1)
+ *		--modes <list>         receive modes: normal,timed,nonblocking (default normal)
+ *		--maxmsg <list>        mq_maxmsg of consumer queues (default MailboxReference::messageAttributes)
+ *		--msgsize <list>       mq_msgsize of consumer queues (default MailboxReference::messageAttributes)
+ *		--mix <list>           message type weights separated by ';', e.g. "string:1;string:70,rfid:20,watchdog:10" (default string:1)
+ *		--messages <n>         messages sent by each producer (default 10000)
+ *		--payload <bytes>      size of StringMessage payload (default 64)
+ *		--rto-us <us>          RTO of consumers in timed mode (default 1000)
+ *		--advise <p>           consumers print the mq_attr recommended for blocking probability <p> (default off)
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#include "DataMailbox.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Marks the last message of a producer
+static const char END_MARKER[] = "LOADGEN_END";
+
+/// Latency samples kept per consumer (reservoir sampled beyond this)
+static const size_t MAX_SAMPLES = 100000;
+
+/// Length of the hex timestamp every generated message ends with
+static const size_t TIMESTAMP_LENGTH = 16;
+
+struct LoadOptions
+{
+	std::vector<int> m_producers = { 1 };
+	std::vector<int> m_consumers = { 1 };
+	std::vector<std::string> m_modes = { "normal" };
+	std::vector<long> m_maxmsg = { MailboxReference::messageAttributes.mq_maxmsg };
+	std::vector<long> m_msgsize = { MailboxReference::messageAttributes.mq_msgsize };
+
+	/// Message type weights, e.g. string:70,rfid:20,watchdog:10
+	std::vector<std::string> m_mixes = { "string:1" };
+
+	long m_messages = 10000;
+	size_t m_payload = 64;
+	long m_rto_us = 1000;
+
+	/// Target blocking probability of the sizing advisor, 0 - advisor off
+	double m_advise = 0;
+};
+
+/// Counters a consumer reports to the parent through a pipe, followed by m_sampleCount doubles
+struct ConsumerReport
+{
+	unsigned long long m_received;
+	unsigned long long m_timeouts;
+	unsigned long long m_empty;
+	unsigned long long m_receiveCalls;
+	unsigned long long m_sampleCount;
+};
+
+static uint64_t monotonicNanoseconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now); // same clock in all processes
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static std::string encodeTimestamp(uint64_t timestamp)
+{
+	char text[TIMESTAMP_LENGTH + 1];
+	snprintf(text, sizeof(text), "%016llx", (unsigned long long)timestamp);
+	return std::string(text, TIMESTAMP_LENGTH);
+}
+
+/// Every generated message has its string field last, so the frame ends with the timestamp
+static bool decodeTimestamp(BasicDataMailboxMessage& message, uint64_t& timestamp)
+{
+	if (message.getRawDataSize() < (int)TIMESTAMP_LENGTH)
+		return false;
+
+	std::string text(message.getRawDataPointer() + message.getRawDataSize() - TIMESTAMP_LENGTH, TIMESTAMP_LENGTH);
+	timestamp = strtoull(text.c_str(), nullptr, 16);
+
+	return true;
+}
+
+template <typename T>
+static std::vector<T> parseList(const char* text, T (*convert)(const std::string&), char separator = ',')
+{
+	std::vector<T> values;
+	std::stringstream stream(text);
+	std::string item;
+
+	while (std::getline(stream, item, separator))
+		values.push_back(convert(item));
+
+	return values;
+}
+
+static int toInt(const std::string& text) { return atoi(text.c_str()); }
+static long toLong(const std::string& text) { return atol(text.c_str()); }
+static std::string toString(const std::string& text) { return text; }
+
+static std::pair<MessageDataType, int> toMixEntry(const std::string& text)
+{
+	size_t colon = text.find(':');
+	std::string type = text.substr(0, colon);
+	int weight = colon == std::string::npos ? 1 : atoi(text.c_str() + colon + 1);
+
+	if (type == "rfid")
+		return { MessageDataType::RFIDMessage, weight };
+	if (type == "watchdog")
+		return { MessageDataType::WatchdogMessage, weight };
+	if (type == "password")
+		return { MessageDataType::KeypadMessage_wPassword, weight };
+
+	return { MessageDataType::StringMessage, weight };
+}
+
+static bool parseOptions(int argc, char* argv[], LoadOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+
+		if (i + 1 >= argc)
+			return false;
+
+		const char* value = argv[++i];
+
+		if (option == "--producers")
+			options.m_producers = parseList(value, toInt);
+		else if (option == "--consumers")
+			options.m_consumers = parseList(value, toInt);
+		else if (option == "--modes")
+			options.m_modes = parseList(value, toString);
+		else if (option == "--maxmsg")
+			options.m_maxmsg = parseList(value, toLong);
+		else if (option == "--msgsize")
+			options.m_msgsize = parseList(value, toLong);
+		else if (option == "--mix")
+			options.m_mixes = parseList(value, toString, ';');
+		else if (option == "--messages")
+			options.m_messages = atol(value);
+		else if (option == "--payload")
+			options.m_payload = atol(value);
+		else if (option == "--rto-us")
+			options.m_rto_us = atol(value);
+		else if (option == "--advise")
+			options.m_advise = atof(value);
+		else
+			return false;
+	}
+
+	// Producers spread their messages over the consumers, so every scenario needs at least one of each
+	for (int producers : options.m_producers)
+		if (producers < 1)
+			return false;
+
+	for (int consumers : options.m_consumers)
+		if (consumers < 1)
+			return false;
+
+	return !options.m_mixes.empty();
+}
+
+/// Name of the queue of consumer `index` of the load generator process `parent`
+static std::string consumerName(int index, pid_t parent = getppid())
+{
+	return "LoadGen_c" + std::to_string(index) + "_" + std::to_string(parent);
+}
+
+static void runProducer(int index, int consumers, const std::string& mixSpec, const LoadOptions& options, int startPipe)
+{
+	std::vector<std::pair<MessageDataType, int>> mix = parseList(mixSpec.c_str(), toMixEntry);
+
+	DataMailbox mailbox("LoadGen_p" + std::to_string(index) + "_" + std::to_string(getppid()));
+
+	std::vector<MailboxReference> destinations;
+	for (int i = 0; i < consumers; i++)
+		destinations.push_back(MailboxReference(consumerName(i)));
+
+	int totalWeight = 0;
+	for (auto& entry : mix)
+		totalWeight += entry.second;
+
+	std::mt19937 random(index);
+	std::string padding(options.m_payload > TIMESTAMP_LENGTH ? options.m_payload - TIMESTAMP_LENGTH : 0, 'x');
+
+	char start;
+	if (read(startPipe, &start, 1) < 0) // returns 0 when the parent closes the pipe
+		_exit(1);
+
+	for (long i = 0; i < options.m_messages; i++)
+	{
+		MailboxReference& destination = destinations[i % consumers];
+
+		int pick = random() % std::max(totalWeight, 1);
+		MessageDataType dataType = mix.empty() ? MessageDataType::StringMessage : mix.front().first;
+
+		for (auto& entry : mix)
+		{
+			if (pick < entry.second)
+			{
+				dataType = entry.first;
+				break;
+			}
+
+			pick -= entry.second;
+		}
+
+		std::string timestamp = encodeTimestamp(monotonicNanoseconds());
+
+		if (dataType == MessageDataType::RFIDMessage)
+		{
+			RFIDMessage message(timestamp);
+			mailbox.send(destination, &message);
+		}
+		else if (dataType == MessageDataType::WatchdogMessage)
+		{
+			WatchdogMessage message(timestamp, WatchdogMessage::KICK);
+			mailbox.send(destination, &message);
+		}
+		else if (dataType == MessageDataType::KeypadMessage_wPassword)
+		{
+			KeypadMessage_wPassword message(timestamp);
+			mailbox.send(destination, &message);
+		}
+		else
+		{
+			StringMessage message(padding + timestamp);
+			mailbox.send(destination, &message);
+		}
+	}
+
+	for (MailboxReference& destination : destinations)
+	{
+		StringMessage end(END_MARKER);
+		mailbox.send(destination, &end);
+	}
+}
+
+static void runConsumer(int index, int producers, const std::string& mode, const mq_attr& attributes, const LoadOptions& options, int readyPipe, int reportPipe)
+{
+	DataMailbox mailbox(consumerName(index), NulLogger::getInstance(), attributes);
+	mailbox.setRTO_ns(options.m_rto_us * 1000);
+
+	if (options.m_advise > 0)
+	{
+		SizingOptions sizing;
+		sizing.m_blockingProbability = options.m_advise;
+		mailbox.enableSizingAdvisor(sizing);
+	}
+
+	enuReceiveOptions receiveOptions = enuReceiveOptions::NORMAL;
+	if (mode == "timed")
+		receiveOptions = enuReceiveOptions::TIMED;
+	else if (mode == "nonblocking")
+		receiveOptions = enuReceiveOptions::NONBLOCKING;
+
+	// Closed once written, so the parent reads EOF instead of waiting when the other consumers are gone
+	if (write(readyPipe, &index, sizeof(index)) != sizeof(index))
+		_exit(1);
+
+	close(readyPipe);
+
+	ConsumerReport report = {};
+	std::vector<double> samples;
+	std::mt19937 random(index);
+	int endsReceived = 0;
+
+	while (endsReceived < producers)
+	{
+		BasicDataMailboxMessage message = mailbox.receive(receiveOptions);
+		uint64_t now = monotonicNanoseconds();
+
+		report.m_receiveCalls++;
+
+		if (message.getDataType() == MessageDataType::TimedOut)
+		{
+			report.m_timeouts++;
+			continue;
+		}
+
+		if (message.getDataType() == MessageDataType::EmptyQueue)
+		{
+			report.m_empty++;
+			continue;
+		}
+
+		if (message.getDataType() == MessageDataType::StringMessage
+			&& message.getRawDataSize() == (int)(sizeof(MessageDataType) + strlen(END_MARKER))
+			&& memcmp(message.getRawDataPointer() + sizeof(MessageDataType), END_MARKER, strlen(END_MARKER)) == 0)
+		{
+			endsReceived++;
+			continue;
+		}
+
+		report.m_received++;
+
+		uint64_t sent;
+		if (!decodeTimestamp(message, sent))
+			continue;
+
+		double latency_us = (now - sent) / 1000.0;
+
+		if (samples.size() < MAX_SAMPLES)
+			samples.push_back(latency_us);
+		else if (random() % report.m_received < MAX_SAMPLES)
+			samples[random() % MAX_SAMPLES] = latency_us;
+	}
+
+	report.m_sampleCount = samples.size();
+
+	if (options.m_advise > 0)
+	{
+		printf("  %s: %s\n", consumerName(index).c_str(), mailbox.getSizingRecommendation().toString().c_str());
+		fflush(stdout);
+	}
+
+	if (write(reportPipe, &report, sizeof(report)) != sizeof(report))
+		_exit(1);
+
+	const char* pSamples = reinterpret_cast<const char*>(samples.data());
+	size_t left = samples.size() * sizeof(double);
+
+	while (left > 0)
+	{
+		ssize_t written = write(reportPipe, pSamples, left);
+		if (written <= 0)
+			_exit(1);
+
+		pSamples += written;
+		left -= written;
+	}
+}
+
+static bool readAll(int fd, void* pBuffer, size_t size)
+{
+	char* pData = static_cast<char*>(pBuffer);
+
+	while (size > 0)
+	{
+		ssize_t count = read(fd, pData, size);
+		if (count <= 0)
+			return false;
+
+		pData += count;
+		size -= count;
+	}
+
+	return true;
+}
+
+/// Sends the end markers of every producer to the consumers which started, so they exit and remove their queues
+static void stopConsumers(const std::vector<int>& readyConsumers, int producers)
+{
+	DataMailbox mailbox("LoadGen_stop_" + std::to_string(getpid()), NulLogger::getInstance());
+	StringMessage end(END_MARKER);
+
+	for (int index : readyConsumers)
+	{
+		MailboxReference destination(consumerName(index, getpid()));
+
+		for (int i = 0; i < producers; i++)
+			mailbox.send(destination, &end);
+	}
+}
+
+/// Waits for every child and reports the ones which did not exit with status 0. Returns false if there were any.
+static bool reapChildren(const std::vector<std::pair<pid_t, std::string>>& children)
+{
+	bool success = true;
+
+	for (auto& child : children)
+	{
+		int status = 0;
+
+		if (waitpid(child.first, &status, 0) != child.first)
+		{
+			perror("waitpid");
+			success = false;
+			continue;
+		}
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			continue;
+
+		success = false;
+
+		if (WIFSIGNALED(status))
+			fprintf(stderr, "%s (pid %d) was killed by signal %d\n", child.second.c_str(), (int)child.first, WTERMSIG(status));
+		else
+			fprintf(stderr, "%s (pid %d) exited with status %d\n", child.second.c_str(), (int)child.first, WEXITSTATUS(status));
+	}
+
+	return success;
+}
+
+static double percentile(std::vector<double>& samples, double fraction)
+{
+	if (samples.empty())
+		return 0.0;
+
+	size_t index = std::min(samples.size() - 1, (size_t)(fraction * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+
+	return samples[index];
+}
+
+static void runScenario(int producers, int consumers, const std::string& mode, long maxmsg, long msgsize, const std::string& mix, const LoadOptions& options)
+{
+	mq_attr attributes = MailboxReference::messageAttributes;
+	attributes.mq_maxmsg = maxmsg;
+	attributes.mq_msgsize = msgsize;
+
+	int readyPipe[2], startPipe[2];
+	std::vector<int> reportPipes;
+	std::vector<std::pair<pid_t, std::string>> children;
+
+	if (pipe(readyPipe) != 0 || pipe(startPipe) != 0)
+	{
+		perror("pipe");
+		return;
+	}
+
+	// Children inherit unwritten output and would print it again
+	fflush(stdout);
+
+	for (int i = 0; i < consumers; i++)
+	{
+		int reportPipe[2];
+		if (pipe(reportPipe) != 0)
+		{
+			perror("pipe");
+			return;
+		}
+
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			// The start pipe reaches EOF only when every write end is closed
+			close(startPipe[0]);
+			close(startPipe[1]);
+			close(readyPipe[0]);
+			close(reportPipe[0]);
+			runConsumer(i, producers, mode, attributes, options, readyPipe[1], reportPipe[1]);
+			_exit(0);
+		}
+
+		close(reportPipe[1]);
+		reportPipes.push_back(reportPipe[0]);
+		children.push_back({ pid, "consumer " + std::to_string(i) });
+	}
+
+	// Only the consumers hold the write end now, so the pipe ends if they exit before they are ready
+	close(readyPipe[1]);
+
+	// Producers may only send once every consumer queue exists
+	std::vector<int> readyConsumers;
+	int readyIndex;
+
+	while ((int)readyConsumers.size() < consumers && readAll(readyPipe[0], &readyIndex, sizeof(readyIndex)))
+		readyConsumers.push_back(readyIndex);
+
+	close(readyPipe[0]);
+
+	if ((int)readyConsumers.size() < consumers)
+	{
+		// E.g. mq_maxmsg or mq_msgsize above the limits in /proc/sys/fs/mqueue
+		printf("%4d %4d %-11s %6ld %7ld | %d of %d consumers failed to start | %s\n",
+			producers, consumers, mode.c_str(), maxmsg, msgsize, consumers - (int)readyConsumers.size(), consumers, mix.c_str());
+		fflush(stdout);
+
+		stopConsumers(readyConsumers, producers);
+
+		for (int reportPipe : reportPipes)
+			close(reportPipe);
+
+		close(startPipe[0]);
+		close(startPipe[1]);
+
+		reapChildren(children);
+		return;
+	}
+
+	for (int i = 0; i < producers; i++)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			close(startPipe[1]);
+			runProducer(i, consumers, mix, options, startPipe[0]);
+			_exit(0);
+		}
+
+		children.push_back({ pid, "producer " + std::to_string(i) });
+	}
+
+	uint64_t start = monotonicNanoseconds();
+	close(startPipe[1]); // releases all producers at once
+	close(startPipe[0]);
+
+	ConsumerReport total = {};
+	std::vector<double> samples;
+
+	for (int reportPipe : reportPipes)
+	{
+		ConsumerReport report;
+
+		if (readAll(reportPipe, &report, sizeof(report)))
+		{
+			size_t offset = samples.size();
+			samples.resize(offset + report.m_sampleCount);
+			readAll(reportPipe, samples.data() + offset, report.m_sampleCount * sizeof(double));
+
+			total.m_received += report.m_received;
+			total.m_timeouts += report.m_timeouts;
+			total.m_empty += report.m_empty;
+			total.m_receiveCalls += report.m_receiveCalls;
+		}
+
+		close(reportPipe);
+	}
+
+	double seconds = (monotonicNanoseconds() - start) / 1e9;
+
+	bool success = reapChildren(children);
+
+	double calls = total.m_receiveCalls > 0 ? (double)total.m_receiveCalls : 1.0;
+	double maximum = samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end());
+
+	printf("%4d %4d %-11s %6ld %7ld | %10.0f | %9.1f %9.1f %9.1f %9.1f | %6.2f%% %6.2f%% | %s\n",
+		producers, consumers, mode.c_str(), maxmsg, msgsize,
+		seconds > 0.0 ? total.m_received / seconds : 0.0,
+		percentile(samples, 0.50), percentile(samples, 0.99), percentile(samples, 0.999), maximum,
+		100.0 * total.m_timeouts / calls, 100.0 * total.m_empty / calls, mix.c_str());
+
+	if (!success)
+		printf("  results incomplete, a process failed\n");
+
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	LoadOptions options;
+
+	if (!parseOptions(argc, argv, options))
+	{
+		printf("Usage: DataMailboxLoadGenerator [--producers <list>] [--consumers <list>] [--modes normal,timed,nonblocking]\n"
+			"                                [--maxmsg <list>] [--msgsize <list>] [--mix \"string:1;string:70,rfid:20,watchdog:10\"]\n"
+			"                                [--messages <n>] [--payload <bytes>] [--rto-us <us>] [--advise <p>]\n");
+		return 1;
+	}
+
+	printf("Online CPUs: %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+	printf("prod cons mode        maxmsg msgsize |      msg/s |   p50[us]   p99[us] p99.9[us]   max[us] | timeout  empty | mix\n");
+
+	for (const std::string& mix : options.m_mixes)
+		for (long maxmsg : options.m_maxmsg)
+			for (long msgsize : options.m_msgsize)
+				for (const std::string& mode : options.m_modes)
+					for (int consumers : options.m_consumers)
+						for (int producers : options.m_producers)
+							runScenario(producers, consumers, mode, maxmsg, msgsize, mix, options);
+
+	return 0;
+}
@@ -0,0 +1,307 @@
+/*****************************************************************//**
+ * \file   DataMailboxReplay.cpp
+ * \brief  Replays captured DataMailbox traffic into real mailboxes for load testing.
+ *
+ * Usage:
+ *		DataMailboxReplay <capture directory> <captured mailbox name> [options]
+ *
+ *		--speed <factor>       1 = original timing (default), 2 = twice as fast, 0 = as fast as possible
+ *		--received             replay frames the captured mailbox received (default: frames it sent)
+ *		--type <code>          replay only frames of this MessageDataType code
+ *		--destination <name>   send every frame to this mailbox instead of the captured destination
+ *		--sink                 create the destination mailbox here and measure receiver latency (needs --destination)
+ *		--maxmsg <n>           mq_maxmsg of the sink mailbox
+ *		--msgsize <n>          mq_msgsize of the sink mailbox
+ *		--name <name>          name of the replaying mailbox (default DataMailboxReplay)
+ *
+ * \author KASO
+ * \date   October 2026
+ *********************************************************************/
+
+#include "DataMailbox.hpp"
+#include "DataMailboxCapture.hpp"
+#include "DataMailboxTime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// Sends a captured frame unchanged
+class CapturedFrameMessage : public ExtendedDataMailboxMessage
+{
+public:
+	CapturedFrameMessage(const char* frame, size_t size)
+		:	ExtendedDataMailboxMessage(size > 0 ? (MessageDataType)frame[0] : MessageDataType::NONE),
+		m_frame(frame), m_size(size)
+	{
+
+	}
+
+	virtual void Serialize()
+	{
+		deleteAndReallocateSerializedData(m_size);
+		memcpy(m_serialized, m_frame, m_size);
+	}
+
+	virtual void Deserialize() {}
+
+	virtual std::string getInfo()
+	{
+		return "CapturedFrameMessage - size: " + std::to_string(m_size);
+	}
+
+private:
+	const char* m_frame;
+	size_t m_size;
+};
+
+struct ReplayOptions
+{
+	std::string m_directory;
+	std::string m_captureName;
+	std::string m_mailboxName = "DataMailboxReplay";
+	std::string m_destination;
+
+	double m_speed = 1.0;
+	bool m_received = false;
+	bool m_sink = false;
+
+	CaptureFilter m_filter;
+	mq_attr m_sinkAttributes = MailboxReference::messageAttributes;
+};
+
+static void printUsage()
+{
+	printf("Usage: DataMailboxReplay <capture directory> <captured mailbox name> [--speed <factor>] [--received] [--type <code>]\n"
+		"                         [--destination <name>] [--sink] [--maxmsg <n>] [--msgsize <n>] [--name <name>]\n");
+}
+
+static bool parseOptions(int argc, char* argv[], ReplayOptions& options)
+{
+	if (argc < 3)
+		return false;
+
+	options.m_directory = argv[1];
+	options.m_captureName = argv[2];
+
+	for (int i = 3; i < argc; i++)
+	{
+		std::string option = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (option == "--speed" && hasValue)
+			options.m_speed = atof(argv[++i]);
+		else if (option == "--received")
+			options.m_received = true;
+		else if (option == "--type" && hasValue)
+		{
+			options.m_filter.m_anyDataType = false;
+			options.m_filter.m_dataType = (MessageDataType)atoi(argv[++i]);
+		}
+		else if (option == "--destination" && hasValue)
+			options.m_destination = argv[++i];
+		else if (option == "--sink")
+			options.m_sink = true;
+		else if (option == "--maxmsg" && hasValue)
+			options.m_sinkAttributes.mq_maxmsg = atol(argv[++i]);
+		else if (option == "--msgsize" && hasValue)
+			options.m_sinkAttributes.mq_msgsize = atol(argv[++i]);
+		else if (option == "--name" && hasValue)
+			options.m_mailboxName = argv[++i];
+		else
+			return false;
+	}
+
+	options.m_filter.m_sent = !options.m_received;
+	options.m_filter.m_received = options.m_received;
+
+	return !(options.m_sink && options.m_destination.empty());
+}
+
+/// Frame as the receiving mailbox returns it: without FRAME_CHECKSUM_FLAG and the checksum trailer
+static std::string getReceivedFrame(const char* frame, size_t size)
+{
+	if (size <= sizeof(uint32_t) || ((unsigned char)frame[0] & FRAME_CHECKSUM_FLAG) == 0)
+		return std::string(frame, size);
+
+	std::string received(frame, size - sizeof(uint32_t));
+	received[0] = (char)((unsigned char)received[0] & ~FRAME_CHECKSUM_FLAG);
+
+	return received;
+}
+
+static double percentile(std::vector<double>& samples, double fraction)
+{
+	if (samples.empty())
+		return 0.0;
+
+	size_t index = std::min(samples.size() - 1, (size_t)(fraction * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+
+	return samples[index];
+}
+
+static void printLatency(const char* title, std::vector<double>& samples_us)
+{
+	if (samples_us.empty())
+		return;
+
+	double maximum = *std::max_element(samples_us.begin(), samples_us.end());
+
+	printf("%s [us]: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", title,
+		percentile(samples_us, 0.50), percentile(samples_us, 0.90), percentile(samples_us, 0.99), maximum);
+}
+
+int main(int argc, char* argv[])
+{
+	ReplayOptions options;
+
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return 1;
+	}
+
+	typedef DataMailboxTime::Clock Clock;
+
+	// Sink: received frames are matched to sent ones by content, so dropped or foreign frames do not shift
+	// the latencies of later ones. Identical frames are matched in the order they were sent.
+	std::unique_ptr<DataMailbox> pSink;
+	std::thread sinkThread;
+	std::mutex sentTimesMutex;
+	std::unordered_map<std::string, std::deque<Clock::time_point>> sentTimes;
+	std::vector<double> receiverLatency_us;
+	std::atomic<bool> replayDone(false);
+	std::atomic<unsigned long long> sinkReceived(0);
+	std::atomic<unsigned long long> sinkForeign(0);
+
+	if (options.m_sink)
+	{
+		pSink.reset(new DataMailbox(options.m_destination, NulLogger::getInstance(), options.m_sinkAttributes));
+		pSink->setRTO_ns(100 * 1000 * 1000);
+
+		sinkThread = std::thread([&]()
+		{
+			while (true)
+			{
+				BasicDataMailboxMessage message = pSink->receive(enuReceiveOptions::TIMED);
+				Clock::time_point now = Clock::now();
+
+				if (message.getDataType() == MessageDataType::TimedOut)
+				{
+					if (replayDone) // quiet for a whole RTO after the last frame was sent
+						break;
+
+					continue;
+				}
+
+				std::lock_guard<std::mutex> lock(sentTimesMutex);
+
+				auto sent = sentTimes.find(std::string(message.getRawDataPointer(), message.getRawDataSize()));
+				if (sent == sentTimes.end()) // not sent by this replay
+				{
+					sinkForeign++;
+					continue;
+				}
+
+				receiverLatency_us.push_back(std::chrono::duration<double, std::micro>(now - sent->second.front()).count());
+				sinkReceived++;
+
+				sent->second.pop_front();
+				if (sent->second.empty())
+					sentTimes.erase(sent);
+			}
+		});
+	}
+
+	DataMailbox mailbox(options.m_mailboxName);
+	std::unordered_map<std::string, MailboxReference> destinations;
+
+	std::vector<double> sendLatency_us;
+	unsigned long long frames = 0;
+	unsigned long long bytes = 0;
+
+	bool first = true;
+	uint64_t firstTimestamp_ns = 0;
+	Clock::time_point start = Clock::now();
+
+	DataMailboxCaptureReader reader(options.m_directory, options.m_captureName);
+
+	reader.forEach(options.m_filter, [&](const CaptureRecord& record)
+	{
+		if (first)
+		{
+			first = false;
+			firstTimestamp_ns = record.m_timestamp_ns;
+			start = Clock::now();
+		}
+
+		if (options.m_speed > 0.0)
+		{
+			// Records of several writers are not in timestamp order, ones older than the first are sent at once
+			int64_t sinceFirst_ns = (int64_t)(record.m_timestamp_ns - firstTimestamp_ns);
+			double offset_ns = std::max<int64_t>(sinceFirst_ns, 0) / options.m_speed;
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds((long long)offset_ns));
+		}
+
+		std::string destinationName = options.m_destination.empty() ? record.getDestination() : options.m_destination;
+
+		auto destination = destinations.find(destinationName);
+		if (destination == destinations.end())
+			destination = destinations.emplace(destinationName, MailboxReference(destinationName)).first;
+
+		CapturedFrameMessage message(record.m_pFrame, record.m_frameSize);
+
+		Clock::time_point sendStart = Clock::now();
+
+		if (options.m_sink)
+		{
+			std::lock_guard<std::mutex> lock(sentTimesMutex);
+			sentTimes[getReceivedFrame(record.m_pFrame, record.m_frameSize)].push_back(sendStart);
+		}
+
+		mailbox.send(destination->second, &message);
+
+		sendLatency_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sendStart).count());
+
+		frames++;
+		bytes += record.m_frameSize;
+
+		return true;
+	});
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	if (options.m_sink)
+	{
+		replayDone = true;
+		sinkThread.join();
+	}
+
+	printf("Replayed %llu frames, %llu bytes in %.3f s\n", frames, bytes, seconds);
+
+	if (seconds > 0.0)
+		printf("Throughput: %.0f frames/s, %.3f MB/s\n", frames / seconds, bytes / seconds / 1e6);
+
+	printLatency("Send (blocked in send)", sendLatency_us);
+
+	if (options.m_sink)
+	{
+		unsigned long long lost = 0;
+		for (const auto& sent : sentTimes)
+			lost += sent.second.size();
+
+		printf("Sink received %llu frames, %llu not received, %llu not sent by this replay\n",
+			(unsigned long long)sinkReceived, lost, (unsigned long long)sinkForeign);
+		printLatency("Receiver latency", receiverLatency_us);
+	}
+
+	return 0;
+}